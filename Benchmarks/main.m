@@ -0,0 +1,614 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+/*
+ *  cbpbench: a standalone benchmark suite for CBPFoundation.
+ *
+ *  Every benchmark runs a fixed number of operations per sample and reports the distribution of nanoseconds per
+ *  operation across samples as JSON. Pass --baseline with a file written by an earlier run to compare against it; any
+ *  benchmark whose median got slower by more than --threshold percent is reported and the tool exits with status 1.
+ *  Invalid options, an unreadable baseline or an unwritable output file exit with status 2.
+ *
+ *  usage: cbpbench [--samples N] [--filter SUBSTRING] [--output FILE] [--baseline FILE] [--threshold PERCENT]
+ */
+
+@import Foundation;
+#import "CBPFoundation.h"
+#import <time.h>
+
+typedef void (^CBPBenchmarkBlock)(NSUInteger operations);
+
+typedef struct CBPBenchmarkOptions
+{
+    NSUInteger samples;
+    double threshold;
+    __unsafe_unretained NSString *filter;
+    __unsafe_unretained NSString *outputPath;
+    __unsafe_unretained NSString *baselinePath;
+} CBPBenchmarkOptions;
+
+static uint64_t CBPBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * NSEC_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+static double CBPBenchmarkPercentile(NSArray *sortedSamples, double percentile)
+{
+    NSUInteger index = (NSUInteger)ceil(percentile / 100 * [sortedSamples count]);
+
+    return [sortedSamples[MIN(MAX(index, (NSUInteger)1), [sortedSamples count]) - 1] doubleValue];
+}
+
+#pragma mark - Harness
+
+@interface CBPBenchmarkSuite : NSObject
+
+- (instancetype)initWithOptions:(CBPBenchmarkOptions)options;
+
+/**
+ *  Runs @p block once to warm up, then once per sample, timing each run of @p operations operations.
+ */
+- (void)benchmark:(NSString *)name operations:(NSUInteger)operations block:(CBPBenchmarkBlock)block;
+
+@property (readonly) NSArray *results;
+
+@end
+
+@implementation CBPBenchmarkSuite
+{
+    CBPBenchmarkOptions _options;
+    NSMutableArray *_results;
+}
+
+- (instancetype)initWithOptions:(CBPBenchmarkOptions)options
+{
+    self = [super init];
+
+    if (self)
+    {
+        _options = options;
+        _results = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+- (NSArray *)results
+{
+    return [_results sortedArrayUsingComparator:^NSComparisonResult(NSDictionary *left, NSDictionary *right) {
+        return [left[@"name"] compare:right[@"name"]];
+    }];
+}
+
+- (void)benchmark:(NSString *)name operations:(NSUInteger)operations block:(CBPBenchmarkBlock)block
+{
+    if (_options.filter && [name rangeOfString:_options.filter].location == NSNotFound)
+    {
+        return;
+    }
+
+    @autoreleasepool
+    {
+        block(operations);
+    }
+
+    NSMutableArray *samples = [NSMutableArray arrayWithCapacity:_options.samples];
+    double total = 0;
+
+    for (NSUInteger sample = 0; sample < _options.samples; sample++)
+    {
+        @autoreleasepool
+        {
+            uint64_t start = CBPBenchmarkNow();
+            block(operations);
+            double nanosecondsPerOperation = (double)(CBPBenchmarkNow() - start) / operations;
+
+            [samples addObject:@(nanosecondsPerOperation)];
+            total += nanosecondsPerOperation;
+        }
+    }
+
+    NSArray *sortedSamples = [samples sortedArrayUsingSelector:@selector(compare:)];
+
+    NSDictionary *result = @{
+        @"name": name,
+        @"unit": @"ns/op",
+        @"operations": @(operations),
+        @"samples": @([sortedSamples count]),
+        @"min": [sortedSamples firstObject],
+        @"p50": @(CBPBenchmarkPercentile(sortedSamples, 50)),
+        @"p90": @(CBPBenchmarkPercentile(sortedSamples, 90)),
+        @"p99": @(CBPBenchmarkPercentile(sortedSamples, 99)),
+        @"max": [sortedSamples lastObject],
+        @"mean": @(total / [sortedSamples count]),
+    };
+
+    [_results addObject:result];
+
+    fprintf(stderr, "%-40s p50 %12.1f ns/op   p99 %12.1f ns/op\n", [name UTF8String], [result[@"p50"] doubleValue], [result[@"p99"] doubleValue]);
+}
+
+@end
+
+#pragma mark - Output
+
+/*
+ *  Written by hand rather than with NSJSONSerialization so the key order, and therefore the file, is stable.
+ */
+static NSString *CBPBenchmarkJSON(NSArray *results)
+{
+    NSArray *keys = @[@"name", @"unit", @"operations", @"samples", @"min", @"p50", @"p90", @"p99", @"max", @"mean"];
+    NSMutableString *json = [NSMutableString stringWithString:@"{\n  \"version\": 1,\n  \"benchmarks\": [\n"];
+
+    [results enumerateObjectsUsingBlock:^(NSDictionary *result, NSUInteger index, BOOL *stop) {
+
+        NSMutableArray *fields = [NSMutableArray array];
+
+        for (NSString *key in keys)
+        {
+            id value = result[key];
+
+            if ([value isKindOfClass:[NSString class]])
+            {
+                [fields addObject:[NSString stringWithFormat:@"\"%@\": \"%@\"", key, value]];
+            }
+            else if ([key isEqualToString:@"operations"] || [key isEqualToString:@"samples"])
+            {
+                [fields addObject:[NSString stringWithFormat:@"\"%@\": %lu", key, (unsigned long)[value unsignedIntegerValue]]];
+            }
+            else
+            {
+                [fields addObject:[NSString stringWithFormat:@"\"%@\": %.1f", key, [value doubleValue]]];
+            }
+        }
+
+        [json appendFormat:@"    { %@ }%@\n", [fields componentsJoinedByString:@", "], index + 1 < [results count] ? @"," : @""];
+    }];
+
+    [json appendString:@"  ]\n}\n"];
+
+    return json;
+}
+
+/*
+ *  Compares medians against a baseline and reports every benchmark that slowed down by more than the threshold.
+ *
+ *  @return The number of regressions.
+ */
+static NSUInteger CBPBenchmarkCompare(NSArray *results, NSString *baselinePath, double threshold)
+{
+    NSData *data = [NSData dataWithContentsOfFile:baselinePath];
+    NSDictionary *baseline = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+
+    if (![baseline isKindOfClass:[NSDictionary class]])
+    {
+        fprintf(stderr, "cbpbench: could not read baseline %s\n", [baselinePath UTF8String]);
+        exit(2);
+    }
+
+    NSMutableDictionary *baselineMedians = [NSMutableDictionary dictionary];
+
+    for (NSDictionary *result in baseline[@"benchmarks"])
+    {
+        baselineMedians[result[@"name"]] = result[@"p50"];
+    }
+
+    NSUInteger regressions = 0;
+
+    for (NSDictionary *result in results)
+    {
+        NSNumber *baselineMedian = baselineMedians[result[@"name"]];
+
+        if (!baselineMedian)
+        {
+            fprintf(stderr, "%-40s new\n", [result[@"name"] UTF8String]);
+            continue;
+        }
+
+        double change = ([result[@"p50"] doubleValue] / MAX([baselineMedian doubleValue], 0.1) - 1) * 100;
+        BOOL regressed = change > threshold;
+
+        regressions += regressed;
+        fprintf(stderr, "%-40s %+7.1f%%%s\n", [result[@"name"] UTF8String], change, regressed ? "  REGRESSION" : "");
+    }
+
+    return regressions;
+}
+
+#pragma mark - Benchmarks
+
+static void CBPBenchmarkDerefs(CBPBenchmarkSuite *suite)
+{
+    CBPPromise *realized = [[CBPPromise alloc] init];
+    [realized deliver:@1];
+
+    [suite benchmark:@"deref.realized" operations:1000000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [realized deref];
+        }
+
+    }];
+
+    [suite benchmark:@"deref.blocking_handoff" operations:10000 block:^(NSUInteger operations) {
+
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            CBPPromise *promise = [[CBPPromise alloc] init];
+
+            dispatch_async(queue, ^{
+                [promise deliver:@(i)];
+            });
+
+            [promise deref];
+        }
+
+    }];
+
+    [suite benchmark:@"promise.create_deliver" operations:100000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [[[CBPPromise alloc] init] deliver:@(i)];
+        }
+
+    }];
+
+    [suite benchmark:@"promise.create_deliver_timeout" operations:100000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [[[CBPPromise alloc] initWithTimeout:60] deliver:@(i)];
+        }
+
+    }];
+}
+
+static void CBPBenchmarkCallbacks(CBPBenchmarkSuite *suite)
+{
+    NSDictionary *deliveries = @{
+        @"queue": @(CBPDerefCallbackDeliveryQueue),
+        @"inline": @(CBPDerefCallbackDeliveryInline),
+        @"batched": @(CBPDerefCallbackDeliveryBatched),
+    };
+
+    dispatch_queue_t queue = dispatch_queue_create("cbpbench.callbacks", DISPATCH_QUEUE_SERIAL);
+
+    for (NSString *mode in deliveries)
+    {
+        CBPDerefCallbackDelivery callbackDelivery = [deliveries[mode] unsignedIntegerValue];
+
+        [suite benchmark:[NSString stringWithFormat:@"callback.%@_latency", mode] operations:10000 block:^(NSUInteger operations) {
+
+            dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+
+            for (NSUInteger i = 0; i < operations; i++)
+            {
+                CBPPromise *promise = [[CBPPromise alloc] init];
+                promise.callbackDelivery = callbackDelivery;
+                promise.callbackQueue = queue;
+                promise.successBlock = ^(id value) {
+                    dispatch_semaphore_signal(semaphore);
+                };
+
+                [promise deliver:@(i)];
+                dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+            }
+
+        }];
+
+        [suite benchmark:[NSString stringWithFormat:@"callback.%@_throughput", mode] operations:100000 block:^(NSUInteger operations) {
+
+            dispatch_group_t group = dispatch_group_create();
+
+            dispatch_apply(4, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+
+                for (NSUInteger i = 0; i < operations / 4; i++)
+                {
+                    CBPPromise *promise = [[CBPPromise alloc] init];
+                    promise.callbackDelivery = callbackDelivery;
+                    promise.callbackQueue = queue;
+
+                    dispatch_group_enter(group);
+                    promise.successBlock = ^(id value) {
+                        dispatch_group_leave(group);
+                    };
+
+                    [promise deliver:@(i)];
+                }
+
+            });
+
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+        }];
+    }
+}
+
+static void CBPBenchmarkFutures(CBPBenchmarkSuite *suite)
+{
+    CBPFutureWorkBlock work = ^id(CBPFutureCanceledBlock isCanceled) {
+        return @1;
+    };
+
+    [suite benchmark:@"future.throughput" operations:10000 block:^(NSUInteger operations) {
+
+        NSMutableArray *futures = [NSMutableArray arrayWithCapacity:operations];
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [futures addObject:[[CBPFuture alloc] initWithExecutor:nil workBlock:work]];
+        }
+
+        for (CBPFuture *future in futures)
+        {
+            [future deref];
+        }
+
+    }];
+
+    [suite benchmark:@"future.fan_out_64" operations:100 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            CBPFuture *root = [[CBPFuture alloc] initWithExecutor:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+
+                NSMutableArray *children = [NSMutableArray arrayWithCapacity:64];
+
+                for (NSUInteger child = 0; child < 64; child++)
+                {
+                    [children addObject:[[CBPFuture alloc] initWithExecutor:nil workBlock:work]];
+                }
+
+                return [[CBPDeref whenAll:children] deref];
+
+            }];
+
+            [root deref];
+        }
+
+    }];
+}
+
+static void CBPBenchmarkThreads(CBPBenchmarkSuite *suite)
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    dispatch_block_t empty = ^{};
+
+    [suite benchmark:@"thread.hop_sync" operations:10000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [thread cbp_performBlockSync:empty];
+        }
+
+    }];
+
+    [suite benchmark:@"thread.hop_async" operations:100000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [thread cbp_performBlockAsync:empty];
+        }
+
+        [thread cbp_performBlockSync:empty];
+
+    }];
+
+    [thread cbp_stop];
+
+    [suite benchmark:@"task.start_stop_dedicated_thread" operations:100 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            CBPBackgroundTask *task = [[CBPBackgroundTask alloc] init];
+            task.startBlock = empty;
+            task.stopBlock = empty;
+            [task start];
+            [task stop];
+        }
+
+    }];
+
+    [suite benchmark:@"task.start_stop_pooled_thread" operations:10000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            CBPBackgroundTask *task = [[CBPBackgroundTask alloc] initWithThreadPool:[CBPRunLoopThreadPool sharedPool]];
+            task.startBlock = empty;
+            task.stopBlock = empty;
+            [task start];
+            [task stop];
+        }
+
+    }];
+}
+
+static void CBPBenchmarkCollections(CBPBenchmarkSuite *suite)
+{
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:100000];
+    NSMutableArray *strings = [NSMutableArray arrayWithCapacity:100000];
+
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        [numbers addObject:@(i)];
+        [strings addObject:[NSString stringWithFormat:@"%lu", (unsigned long)i]];
+    }
+
+    [suite benchmark:@"array.map_block" operations:100000 block:^(NSUInteger operations) {
+        [numbers arrayByMappingBlock:^id(NSNumber *number) {
+            return @([number unsignedIntegerValue] * 2);
+        }];
+    }];
+
+    [suite benchmark:@"array.concurrent_map_block" operations:100000 block:^(NSUInteger operations) {
+        [numbers concurrentArrayByMappingBlock:^id(NSNumber *number) {
+            return @([number unsignedIntegerValue] * 2);
+        }];
+    }];
+
+    [suite benchmark:@"array.filter_block" operations:100000 block:^(NSUInteger operations) {
+        [numbers filteredArrayUsingBlock:^BOOL(NSNumber *number) {
+            return [number unsignedIntegerValue] % 2 == 0;
+        }];
+    }];
+
+    [suite benchmark:@"array.map_selector" operations:100000 block:^(NSUInteger operations) {
+        [strings arrayByMappingSelector:@selector(uppercaseString)];
+    }];
+}
+
+static void CBPBenchmarkStrings(CBPBenchmarkSuite *suite)
+{
+    NSMutableString *haystack = [NSMutableString string];
+
+    while ([haystack length] < 4096 - 6)
+    {
+        [haystack appendString:@"Lorem ipsum dolor sit amet, consectetur adipiscing elit. "];
+    }
+
+    [haystack deleteCharactersInRange:NSMakeRange(4096 - 6, [haystack length] - (4096 - 6))];
+    [haystack appendString:@"needle"];
+
+    NSString *text = [haystack copy];
+
+    [suite benchmark:@"string.contains_4k" operations:10000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [text containsString:@"needle"];
+        }
+
+    }];
+
+    [suite benchmark:@"string.contains_case_insensitive_4k" operations:10000 block:^(NSUInteger operations) {
+
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [text containsString:@"NEEDLE" options:NSCaseInsensitiveSearch];
+        }
+
+    }];
+}
+
+#pragma mark -
+
+static void CBPBenchmarkUsage(void)
+{
+    fprintf(stderr, "usage: cbpbench [--samples N] [--filter SUBSTRING] [--output FILE] [--baseline FILE] [--threshold PERCENT]\n");
+    exit(2);
+}
+
+static CBPBenchmarkOptions CBPBenchmarkParseOptions(NSArray *arguments)
+{
+    CBPBenchmarkOptions options = { .samples = 20, .threshold = 10 };
+
+    for (NSUInteger i = 1; i < [arguments count]; i++)
+    {
+        NSString *argument = arguments[i];
+        NSString *value = i + 1 < [arguments count] ? arguments[i + 1] : nil;
+
+        if (!value)
+        {
+            CBPBenchmarkUsage();
+        }
+
+        if ([argument isEqualToString:@"--samples"])
+        {
+            options.samples = (NSUInteger)MAX([value integerValue], 1);
+        }
+        else if ([argument isEqualToString:@"--filter"])
+        {
+            options.filter = value;
+        }
+        else if ([argument isEqualToString:@"--output"])
+        {
+            options.outputPath = value;
+        }
+        else if ([argument isEqualToString:@"--baseline"])
+        {
+            options.baselinePath = value;
+        }
+        else if ([argument isEqualToString:@"--threshold"])
+        {
+            options.threshold = [value doubleValue];
+        }
+        else
+        {
+            fprintf(stderr, "cbpbench: unknown option %s\n", [argument UTF8String]);
+            CBPBenchmarkUsage();
+        }
+
+        i++;
+    }
+
+    return options;
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool
+    {
+        NSArray *arguments = [[NSProcessInfo processInfo] arguments];
+        CBPBenchmarkOptions options = CBPBenchmarkParseOptions(arguments);
+        CBPBenchmarkSuite *suite = [[CBPBenchmarkSuite alloc] initWithOptions:options];
+
+        CBPBenchmarkDerefs(suite);
+        CBPBenchmarkCallbacks(suite);
+        CBPBenchmarkFutures(suite);
+        CBPBenchmarkThreads(suite);
+        CBPBenchmarkCollections(suite);
+        CBPBenchmarkStrings(suite);
+
+        NSString *json = CBPBenchmarkJSON([suite results]);
+
+        if (options.outputPath)
+        {
+            NSError *error = nil;
+
+            if (![json writeToFile:options.outputPath atomically:YES encoding:NSUTF8StringEncoding error:&error])
+            {
+                fprintf(stderr, "cbpbench: could not write %s: %s\n", [options.outputPath UTF8String], [[error localizedDescription] UTF8String]);
+                return 2;
+            }
+        }
+        else
+        {
+            fputs([json UTF8String], stdout);
+        }
+
+        if (options.baselinePath && CBPBenchmarkCompare([suite results], options.baselinePath, options.threshold))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
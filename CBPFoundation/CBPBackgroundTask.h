@@ -24,13 +24,53 @@
 
 /**
  *  This is a subclass of CBPTask which creates a new thread to perform the start and stop callbacks on. The -start and -stop methods are thread safe.
+ *
+ *  Tasks initialized with a thread pool instead borrow the least loaded of the pool's threads each time they start and return it when they stop, so many tasks can run without a thread each.
  */
 
 @import Foundation;
 #import "CBPTask.h"
 
+@class CBPRunLoopThreadPool;
+@class CBPThreadConfiguration;
+
 @interface CBPBackgroundTask : CBPTask
 
+/**
+ *  Initializes a task that creates a new thread every time it starts.
+ *
+ *  @return An initialized task.
+ */
+- (instancetype)init;
+
+/**
+ *  Initializes a task that runs on a thread from @p threadPool.
+ *
+ *  @param threadPool The pool to take threads from, or nil to create a new thread every time the task starts.
+ *
+ *  @return An initialized task.
+ */
+- (instancetype)initWithThreadPool:(CBPRunLoopThreadPool *)threadPool;
+
+/**
+ *  Initializes a task that creates a new thread, configured by @p threadConfiguration, every time it starts.
+ *
+ *  @param threadConfiguration The configuration for the task's threads, or nil for the defaults.
+ *
+ *  @return An initialized task.
+ */
+- (instancetype)initWithThreadConfiguration:(CBPThreadConfiguration *)threadConfiguration;
+
+/**
+ *  The pool the task takes its threads from, or nil.
+ */
+@property (readonly) CBPRunLoopThreadPool *threadPool;
+
+/**
+ *  The configuration for the task's threads, or nil.
+ */
+@property (readonly, copy) CBPThreadConfiguration *threadConfiguration;
+
 /**
  *  The thread the task is running on, or nil when stopped.
  */
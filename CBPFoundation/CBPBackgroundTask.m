@@ -25,6 +25,8 @@
 #import "CBPBackgroundTask.h"
 #import "CBPTaskSubclass.h"
 #import "NSThread+CBPExtensions.h"
+#import "CBPRunLoopThreadPool.h"
+#import "CBPThreadConfiguration.h"
 
 @interface CBPBackgroundTask ()
 
@@ -32,11 +34,42 @@
 
 @end
 
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
 @implementation CBPBackgroundTask
 
+- (instancetype)init
+{
+    return [self initWithThreadPool:nil];
+}
+
+- (instancetype)initWithThreadPool:(CBPRunLoopThreadPool *)threadPool
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _threadPool = threadPool;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithThreadConfiguration:(CBPThreadConfiguration *)threadConfiguration
+{
+    self = [super init];
+    
+    if (self)
+    {
+        _threadConfiguration = [threadConfiguration copy];
+    }
+    
+    return self;
+}
+
 - (void)_startTask
 {
-    self.thread = [NSThread cbp_runningThread];
+    self.thread = self.threadPool ? [self.threadPool acquireThread] : [NSThread cbp_runningThreadWithConfiguration:self.threadConfiguration];
     
     [self.thread cbp_performBlockSync:^{
         
@@ -53,7 +86,15 @@
         
     }];
     
-    [self.thread cbp_stop];
+    if (self.threadPool)
+    {
+        [self.threadPool relinquishThread:self.thread];
+    }
+    else
+    {
+        [self.thread cbp_stop];
+    }
+    
     self.thread = nil;
 }
 
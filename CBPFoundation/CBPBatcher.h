@@ -0,0 +1,77 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+@class CBPExecutor;
+@class CBPPromise;
+
+/**
+ *  Loads a batch of keys at once.
+ *
+ *  @param keys The distinct keys in the batch, in the order they were first requested.
+ *
+ *  @return A dictionary of results keyed by the requested keys. The promise for each key is delivered with its result, or invalidated with it if the result is an NSError. Promises for keys missing from the dictionary, or for every key if it is nil, are invalidated with a nil error. If the block throws, every promise in the batch that has not been realized is invalidated with a nil error.
+ */
+typedef NSDictionary *(^CBPBatcherBlock)(NSArray *keys);
+
+/**
+ *  Coalesces individual requests into bulk calls. Each key submitted to a batcher immediately returns a promise; keys are collected until the batch holds @p maximumBatchSize keys or @p maximumDelay has passed since its first key, then the batch block is performed once for all of them on the batcher's executor.
+ */
+@interface CBPBatcher : NSObject
+
+/**
+ *  Initializes a batcher.
+ *
+ *  @param maximumBatchSize         The most keys to put in one batch. This value must be greater than 0 or an exception will be thrown.
+ *  @param maximumDelay             The longest a key waits for its batch to fill, accurate to the shared timer wheel's tick.
+ *  @param maximumConcurrentBatches The most batches to perform at once, or 0 for no limit. Batches that are ready beyond the limit wait, in order, for a running batch to finish.
+ *  @param executor                 The executor on which to perform the batch block. If nil, the default executor is used.
+ *  @param batchBlock               The block that loads a batch. This value must not be nil or an exception will be thrown.
+ *
+ *  @return An initialized batcher.
+ */
+- (instancetype)initWithMaximumBatchSize:(NSUInteger)maximumBatchSize maximumDelay:(NSTimeInterval)maximumDelay maximumConcurrentBatches:(NSUInteger)maximumConcurrentBatches executor:(CBPExecutor *)executor batchBlock:(CBPBatcherBlock)batchBlock;
+
+/**
+ *  Adds a key to the current batch. A key already waiting in the current batch is not added twice; its existing promise is returned instead.
+ *
+ *  @param key The key to load. It is copied.
+ *
+ *  @return A promise that will be realized when the key's batch has been loaded.
+ */
+- (CBPPromise *)promiseForKey:(id<NSCopying>)key;
+
+/**
+ *  Sends the current batch without waiting for it to fill or for its delay to pass.
+ */
+- (void)flush;
+
+@property (readonly) NSUInteger maximumBatchSize;
+
+@property (readonly) NSTimeInterval maximumDelay;
+
+@property (readonly) NSUInteger maximumConcurrentBatches;
+
+@end
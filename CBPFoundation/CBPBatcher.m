@@ -0,0 +1,310 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPBatcher.h"
+#import "CBPExecutor.h"
+#import "CBPPromise.h"
+#import "CBPTimerWheel.h"
+#import <pthread.h>
+
+@interface CBPBatcherBatch : NSObject
+
+@property (nonatomic, readonly) NSMutableArray *keys;
+
+@property (nonatomic, readonly) NSMutableDictionary *promises;
+
+@property (nonatomic) CBPTimerWheelTimeout timeout;
+
+@end
+
+@implementation CBPBatcherBatch
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self)
+    {
+        _keys = [NSMutableArray array];
+        _promises = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+@end
+
+#pragma mark -
+
+@interface CBPBatcher ()
+
+@property (copy) CBPBatcherBlock batchBlock;
+
+@property CBPExecutor *executor;
+
+@end
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPBatcher
+{
+    pthread_mutex_t _mutex;
+    CBPBatcherBatch *_currentBatch;
+    NSMutableArray *_readyBatches;
+    NSUInteger _runningBatchCount;
+}
+
+- (instancetype)initWithMaximumBatchSize:(NSUInteger)maximumBatchSize maximumDelay:(NSTimeInterval)maximumDelay maximumConcurrentBatches:(NSUInteger)maximumConcurrentBatches executor:(CBPExecutor *)executor batchBlock:(CBPBatcherBlock)batchBlock
+{
+    if (!maximumBatchSize)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"maximumBatchSize must be greater than 0. %s", __PRETTY_FUNCTION__];
+    }
+    else if (!batchBlock)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"batchBlock must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        _maximumBatchSize = maximumBatchSize;
+        _maximumDelay = maximumDelay;
+        _maximumConcurrentBatches = maximumConcurrentBatches;
+        self.executor = executor ? executor : [CBPExecutor defaultExecutor];
+        self.batchBlock = batchBlock;
+        pthread_mutex_init(&_mutex, NULL);
+        _readyBatches = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (CBPPromise *)promiseForKey:(id<NSCopying>)key
+{
+    pthread_mutex_lock(&_mutex);
+
+    CBPBatcherBatch *batch = _currentBatch;
+    CBPPromise *promise = batch.promises[key];
+
+    if (promise)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return promise;
+    }
+
+    BOOL scheduleTimeout = NO;
+
+    if (!batch)
+    {
+        batch = [[CBPBatcherBatch alloc] init];
+        _currentBatch = batch;
+        scheduleTimeout = YES;
+    }
+
+    id copiedKey = [(id)key copy];
+    promise = [[CBPPromise alloc] init];
+    [batch.keys addObject:copiedKey];
+    batch.promises[copiedKey] = promise;
+
+    BOOL full = [batch.keys count] >= _maximumBatchSize;
+
+    if (full)
+    {
+        [self _sealCurrentBatch];
+    }
+
+    NSArray *startingBatches = [self _dequeueStartingBatches];
+
+    pthread_mutex_unlock(&_mutex);
+
+    //-------------------------------------------------------------------
+    // The timeout is scheduled outside the lock; if the batch fills or is
+    // flushed first, whoever sealed it will find the handle once we store
+    // it, and the timeout block checks that its batch is still current.
+    // The block keeps the batcher alive, so a batcher released while a
+    // batch is filling still sends it; starting the batch cancels the
+    // timeout and releases the block.
+    //-------------------------------------------------------------------
+    if (scheduleTimeout && !full)
+    {
+        CBPTimerWheelTimeout timeout = [[CBPTimerWheel sharedTimerWheel] scheduleTimeout:_maximumDelay block:^{
+            [self _flushBatch:batch];
+        }];
+
+        pthread_mutex_lock(&_mutex);
+        BOOL sealed = _currentBatch != batch;
+
+        if (!sealed)
+        {
+            batch.timeout = timeout;
+        }
+
+        pthread_mutex_unlock(&_mutex);
+
+        if (sealed)
+        {
+            [[CBPTimerWheel sharedTimerWheel] cancelTimeout:timeout];
+        }
+    }
+
+    [self _startBatches:startingBatches];
+
+    return promise;
+}
+
+- (void)flush
+{
+    [self _flushBatch:nil];
+}
+
+#pragma mark -
+
+/**
+ *  Seals the current batch if it is @p batch, or whatever it is if @p batch is nil, and starts any batch that may run.
+ */
+- (void)_flushBatch:(CBPBatcherBatch *)batch
+{
+    pthread_mutex_lock(&_mutex);
+
+    if (_currentBatch && (!batch || _currentBatch == batch))
+    {
+        [self _sealCurrentBatch];
+    }
+
+    NSArray *startingBatches = [self _dequeueStartingBatches];
+
+    pthread_mutex_unlock(&_mutex);
+
+    [self _startBatches:startingBatches];
+}
+
+/**
+ *  Must be called with the lock held.
+ */
+- (void)_sealCurrentBatch
+{
+    [_readyBatches addObject:_currentBatch];
+    _currentBatch = nil;
+}
+
+/**
+ *  Must be called with the lock held.
+ *
+ *  @return The ready batches that fit under the concurrency limit, which the caller must start once it has released the lock.
+ */
+- (NSArray *)_dequeueStartingBatches
+{
+    NSUInteger count = [_readyBatches count];
+
+    if (_maximumConcurrentBatches)
+    {
+        count = MIN(count, _maximumConcurrentBatches - MIN(_runningBatchCount, _maximumConcurrentBatches));
+    }
+
+    if (!count)
+    {
+        return nil;
+    }
+
+    NSRange range = NSMakeRange(0, count);
+    NSArray *startingBatches = [_readyBatches subarrayWithRange:range];
+    [_readyBatches removeObjectsInRange:range];
+    _runningBatchCount += count;
+
+    return startingBatches;
+}
+
+- (void)_startBatches:(NSArray *)batches
+{
+    for (CBPBatcherBatch *batch in batches)
+    {
+        if (batch.timeout)
+        {
+            [[CBPTimerWheel sharedTimerWheel] cancelTimeout:batch.timeout];
+            batch.timeout = NULL;
+        }
+
+        [self.executor execute:^{
+            [self _performBatch:batch];
+        }];
+    }
+}
+
+- (void)_performBatch:(CBPBatcherBatch *)batch
+{
+    @try
+    {
+        @autoreleasepool
+        {
+            NSDictionary *results = self.batchBlock([batch.keys copy]);
+
+            for (id key in batch.keys)
+            {
+                CBPPromise *promise = batch.promises[key];
+                id result = results[key];
+
+                if (!result)
+                {
+                    [promise invalidateWithError:nil];
+                }
+                else if ([result isKindOfClass:[NSError class]])
+                {
+                    [promise invalidateWithError:result];
+                }
+                else
+                {
+                    [promise deliver:result];
+                }
+            }
+        }
+    }
+    @catch (id exception)
+    {
+        //-------------------------------------------------------------------
+        // A batch block that throws must not strand its promises or keep
+        // its concurrency slot; promises that were already realized ignore
+        // the invalidation.
+        //-------------------------------------------------------------------
+        for (id key in batch.keys)
+        {
+            [batch.promises[key] invalidateWithError:nil];
+        }
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _runningBatchCount--;
+    NSArray *startingBatches = [self _dequeueStartingBatches];
+    pthread_mutex_unlock(&_mutex);
+
+    [self _startBatches:startingBatches];
+}
+
+@end
@@ -0,0 +1,64 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+@class CBPDeref;
+
+/**
+ *  A flag that can be shared by a group of derefs, such as every future in a computation, so that the whole group can be cancelled at once.
+ *
+ *  Cancelling a token invalidates every deref registered with it, which wakes their waiters immediately and stops futures whose work hasn't started from ever running it. Tokens can be nested: cancelling a token also cancels every token created with it as a parent.
+ */
+@interface CBPCancellationToken : NSObject
+
+/**
+ *  Initializes a token that is cancelled along with @p parentToken.
+ *
+ *  @param parentToken The parent token. If nil, the token can only be cancelled directly.
+ *
+ *  @return An initialized token.
+ */
+- (instancetype)initWithParentToken:(CBPCancellationToken *)parentToken;
+
+/**
+ *  YES once the token has been cancelled. Reading this property is a single relaxed load, so it is cheap enough to check inside tight loops.
+ */
+@property (readonly, getter = isCancelled) BOOL cancelled;
+
+/**
+ *  Cancels the token, invalidating every registered deref with an NSUserCancelledError and cancelling every child token.
+ *
+ *  @return YES if this call cancelled the token; NO if it was already cancelled.
+ */
+- (BOOL)cancel;
+
+/**
+ *  Registers a deref to be invalidated when the token is cancelled. The token does not retain the deref. If the token has already been cancelled the deref is invalidated immediately.
+ *
+ *  @param deref The deref to register.
+ */
+- (void)registerDeref:(CBPDeref *)deref;
+
+@end
@@ -0,0 +1,143 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPCancellationToken.h"
+#import "CBPDeref.h"
+#import <stdatomic.h>
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPCancellationToken
+{
+    _Atomic(BOOL) _cancelled;
+    NSHashTable *_derefs;
+    NSHashTable *_childTokens;
+}
+
+- (instancetype)init
+{
+    return [self initWithParentToken:nil];
+}
+
+- (instancetype)initWithParentToken:(CBPCancellationToken *)parentToken
+{
+    self = [super init];
+
+    if (self)
+    {
+        atomic_init(&_cancelled, NO);
+        _derefs = [NSHashTable weakObjectsHashTable];
+        _childTokens = [NSHashTable weakObjectsHashTable];
+
+        [parentToken _registerChildToken:self];
+    }
+
+    return self;
+}
+
+- (BOOL)isCancelled
+{
+    return atomic_load_explicit(&_cancelled, memory_order_relaxed);
+}
+
+- (BOOL)cancel
+{
+    if (atomic_exchange(&_cancelled, YES))
+    {
+        return NO;
+    }
+
+    //-------------------------------------------------------------------
+    // Registration checks the flag under the same lock, so anything
+    // registered after this snapshot is invalidated by its registrant.
+    //-------------------------------------------------------------------
+    NSArray *derefs = nil;
+    NSArray *childTokens = nil;
+
+    @synchronized(self)
+    {
+        derefs = [_derefs allObjects];
+        childTokens = [_childTokens allObjects];
+        [_derefs removeAllObjects];
+        [_childTokens removeAllObjects];
+    }
+
+    NSError *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil];
+
+    for (CBPDeref *deref in derefs)
+    {
+        [deref invalidateWithError:error];
+    }
+
+    for (CBPCancellationToken *childToken in childTokens)
+    {
+        [childToken cancel];
+    }
+
+    return YES;
+}
+
+- (void)registerDeref:(CBPDeref *)deref
+{
+    BOOL cancelled = NO;
+
+    @synchronized(self)
+    {
+        cancelled = atomic_load(&_cancelled);
+
+        if (!cancelled)
+        {
+            [_derefs addObject:deref];
+        }
+    }
+
+    if (cancelled)
+    {
+        [deref invalidateWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil]];
+    }
+}
+
+#pragma mark -
+
+- (void)_registerChildToken:(CBPCancellationToken *)childToken
+{
+    BOOL cancelled = NO;
+
+    @synchronized(self)
+    {
+        cancelled = atomic_load(&_cancelled);
+
+        if (!cancelled)
+        {
+            [_childTokens addObject:childToken];
+        }
+    }
+
+    if (cancelled)
+    {
+        [childToken cancel];
+    }
+}
+
+@end
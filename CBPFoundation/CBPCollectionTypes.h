@@ -27,3 +27,7 @@
 typedef id (^CBPArrayMappingBlock)(id object);
 
 typedef BOOL (^CBPArrayFilteringBlock)(id object);
+
+typedef id (^CBPArrayReducingBlock)(id accumulator, id object);
+
+typedef id<NSCopying> (^CBPArrayGroupingBlock)(id object);
@@ -24,6 +24,8 @@
 
 @import Foundation;
 
+@class CBPDeref;
+
 typedef NS_ENUM(NSUInteger, CBPDerefState)
 {
     CBPDerefStateIncomplete,
@@ -31,10 +33,59 @@ typedef NS_ENUM(NSUInteger, CBPDerefState)
     CBPDerefStateInvalid
 };
 
+/**
+ *  How a deref performs its success and invalid blocks.
+ */
+typedef NS_ENUM(NSUInteger, CBPDerefCallbackDelivery)
+{
+    /**
+     *  Each callback is submitted to the callback queue on its own.
+     */
+    CBPDerefCallbackDeliveryQueue,
+
+    /**
+     *  The callback is performed on the thread that realized the deref, before @p -deliver: or @p -invalidateWithError: returns. The callback queue is ignored.
+     */
+    CBPDerefCallbackDeliveryInline,
+
+    /**
+     *  Callbacks bound for the same queue are collected and submitted to it as a single block. Callbacks that arrive while a batch is waiting to run join that batch.
+     */
+    CBPDerefCallbackDeliveryBatched
+};
+
 typedef void (^CBPDerefSuccessBlock)(id value);
 
 typedef void (^CBPDerefInvalidBlock)(NSError *error);
 
+/**
+ *  Called once a deref has been realized.
+ *
+ *  @param value The realized value, or @p CBPDerefInvalidValue if the deref was invalidated.
+ *  @param error The error the deref was invalidated with, or nil.
+ *
+ *  @return The value of the deref returned by @p -then:onQueue:.
+ */
+typedef id (^CBPDerefThenBlock)(id value, NSError *error);
+
+/**
+ *  Transforms the realized value of a deref.
+ *
+ *  @param value The realized value.
+ *
+ *  @return The value of the deref returned by @p -map:.
+ */
+typedef id (^CBPDerefMapBlock)(id value);
+
+/**
+ *  Transforms the realized value of a deref into another deref.
+ *
+ *  @param value The realized value.
+ *
+ *  @return A deref whose result will be forwarded to the deref returned by @p -flatMap:. If nil, that deref is realized with nil.
+ */
+typedef CBPDeref *(^CBPDerefFlatMapBlock)(id value);
+
 extern id const CBPDerefInvalidValue;
 
 @interface CBPDeref : NSObject
@@ -55,7 +106,7 @@ extern id const CBPDerefInvalidValue;
 @property (readonly, getter = isValid) BOOL valid;
 
 /**
- *  Waits indefinitely until the deref has been realized or invalidated.
+ *  Waits indefinitely until the deref has been realized or invalidated. Called from a CBPFiberScheduler fiber, the fiber is suspended instead of blocking its thread.
  *
  *  @return The realized value.
  */
@@ -80,6 +131,72 @@ extern id const CBPDerefInvalidValue;
  */
 - (BOOL)invalidateWithError:(NSError *)error;
 
+/**
+ *  The error the deref was invalidated with, or nil.
+ */
+@property (readonly) NSError *error;
+
+#pragma mark - Continuations
+
+/**
+ *  Performs a block once the deref has been realized, whether or not it is valid. Any number of continuations may be attached, before or after the deref is realized, without blocking a thread.
+ *
+ *  @param block The block to perform.
+ *  @param queue The queue on which to perform the block. If nil, a global concurrent queue will be used.
+ *
+ *  @return A new deref that will be realized with the value returned by @p block.
+ */
+- (CBPDeref *)then:(CBPDerefThenBlock)block onQueue:(dispatch_queue_t)queue;
+
+/**
+ *  Transforms the deref's value once it has been realized. If the deref is invalidated, the returned deref is invalidated with the same error and @p block is not performed.
+ *
+ *  @param block The block to perform on a global concurrent queue.
+ *
+ *  @return A new deref that will be realized with the value returned by @p block.
+ */
+- (CBPDeref *)map:(CBPDerefMapBlock)block;
+
+/**
+ *  Chains another deref once the deref has been realized. If either deref is invalidated, the returned deref is invalidated with the same error.
+ *
+ *  @param block The block to perform on a global concurrent queue.
+ *
+ *  @return A new deref that will be realized with the result of the deref returned by @p block.
+ */
+- (CBPDeref *)flatMap:(CBPDerefFlatMapBlock)block;
+
+#pragma mark - Combinators
+
+/**
+ *  Returns a deref that is realized once every deref in @p derefs has been realized. No thread waits; each input counts down a single atomic counter as it completes.
+ *
+ *  @param derefs The derefs to wait for.
+ *
+ *  @return A deref whose value is an array of the values of @p derefs, in the same order, with nil values replaced by @p NSNull. The deref is invalidated as soon as any input is invalidated.
+ */
++ (CBPDeref *)whenAll:(NSArray *)derefs;
+
+/**
+ *  Returns a deref that is realized by whichever deref in @p derefs is realized first, valid or not. Every other input is then invalidated.
+ *
+ *  @param derefs The derefs to race.
+ *
+ *  @return A deref with the value or error of the first input to be realized.
+ */
++ (CBPDeref *)whenAny:(NSArray *)derefs;
+
+/**
+ *  Returns a deref that is realized with the value of the first deref in @p derefs to complete successfully. Every other input is then invalidated.
+ *
+ *  @param derefs The derefs to race.
+ *
+ *  @return A deref with the value of the first input to complete. If every input is invalidated, the deref is invalidated with the error of the last one.
+ */
++ (CBPDeref *)firstSuccessful:(NSArray *)derefs;
+
+#pragma mark - Callbacks
+
 /**
  *  This block will be called when the deref's value has been realized.
  */
@@ -95,4 +212,16 @@ extern id const CBPDerefInvalidValue;
  */
 @property dispatch_queue_t callbackQueue;
 
+/**
+ *  How the success/invalid blocks are performed. Defaults to the value of @p +defaultCallbackDelivery when the deref is created.
+ */
+@property CBPDerefCallbackDelivery callbackDelivery;
+
+/**
+ *  The callback delivery of newly created derefs. Defaults to @p CBPDerefCallbackDeliveryQueue.
+ */
++ (CBPDerefCallbackDelivery)defaultCallbackDelivery;
+
++ (void)setDefaultCallbackDelivery:(CBPDerefCallbackDelivery)callbackDelivery;
+
 @end
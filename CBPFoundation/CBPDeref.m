@@ -24,30 +24,186 @@
 
 #import "CBPDeref.h"
 #import "CBPDerefSubclass.h"
+#import "CBPParkingLot.h"
+#import "CBPFiberRuntime.h"
+#import "CBPMetricsRecording.h"
+#import "CBPWorkStealingExecutor.h"
+#import <stdatomic.h>
+#import <pthread.h>
 
-typedef NS_ENUM(NSInteger, CBPPromiseLockState_t)
+/*
+ *  The state and the "someone is waiting" flag share a single word. The value is written while the word reads
+ *  CBPDerefStateWordAssigning and is published by the release store of the final state, so any reader that observes
+ *  Complete or Invalid with an acquire load may read the value without taking a lock.
+ */
+typedef NS_OPTIONS(uintptr_t, CBPDerefStateWord)
 {
-    CBPDerefLockStateWaiting,
-    CBPDerefLockStateRealized,
+    CBPDerefStateWordIncomplete = 0,
+    CBPDerefStateWordAssigning  = 1,
+    CBPDerefStateWordComplete   = 2,
+    CBPDerefStateWordInvalid    = 3,
+    CBPDerefStateWordMask       = 3,
+    CBPDerefStateWordWaiters    = 1 << 2,
 };
 
+NS_INLINE BOOL CBPDerefStateWordIsRealized(uintptr_t word)
+{
+    return (word & CBPDerefStateWordMask) >= CBPDerefStateWordComplete;
+}
+
+/*
+ *  How long a waiter on a pool worker parks before looking for more work to help with.
+ */
+static const NSTimeInterval CBPDerefHelpingParkInterval = 0.001;
+
+static BOOL CBPDerefSetWaitersBit(void *context)
+{
+    _Atomic(uintptr_t) *stateWord = context;
+
+    return !CBPDerefStateWordIsRealized(atomic_fetch_or_explicit(stateWord, CBPDerefStateWordWaiters, memory_order_acq_rel));
+}
+
+/*
+ *  Stored in the continuation list once the deref has been realized. Continuations added after that run immediately.
+ */
+static void *const CBPDerefContinuationsClosed = (void *)1;
+
+static dispatch_queue_t CBPDerefDefaultContinuationQueue(void)
+{
+    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+}
+
 id const CBPDerefInvalidValue = @"CBPDerefInvalidValue";
 
-@interface CBPDeref ()
+#pragma mark -
+
+/*
+ *  A node in a deref's lock-free list of continuations. Each node in the list is retained by the list itself, so @p next
+ *  doesn't need to be.
+ */
+@interface CBPDerefContinuation : NSObject
+
+@property (nonatomic, copy) CBPDerefContinuationBlock block;
+
+@property (nonatomic) dispatch_queue_t queue;
+
+@property (nonatomic, unsafe_unretained) CBPDerefContinuation *next;
 
-@property (nonatomic) NSConditionLock *lock;
+@end
+
+@implementation CBPDerefContinuation
 
-@property (nonatomic) id value;
+@end
 
-@property CBPDerefState state;
+#pragma mark -
+
+/*
+ *  Shared bookkeeping for the inputs of a combinator. Each value slot is written by exactly one input, and the final
+ *  acquire-release decrement makes every slot visible to the input that performs it.
+ */
+@interface CBPDerefAggregate : NSObject
 
-@property (getter = isRealized) BOOL realized;
+- (instancetype)initWithCount:(NSUInteger)count;
 
-@property (getter = isValid) BOOL valid;
+- (instancetype)initWithDerefs:(NSArray *)derefs;
+
+/**
+ *  Returns YES if the caller performed the final decrement.
+ */
+- (BOOL)countDown;
+
+- (void)setValue:(id)value atIndex:(NSUInteger)index;
+
+- (NSArray *)values;
+
+/**
+ *  Invalidates every input other than @p winner that is still alive.
+ */
+- (void)invalidateDerefsOtherThan:(NSUInteger)winner;
 
 @end
 
+#pragma mark - Batched callbacks
+
+#define CBPDerefCallbackBatchStripeCount 16
+
+static _Atomic(NSUInteger) CBPDerefDefaultCallbackDelivery = CBPDerefCallbackDeliveryQueue;
+
+static pthread_mutex_t CBPDerefCallbackBatchLocks[CBPDerefCallbackBatchStripeCount];
+
+static NSMutableDictionary *CBPDerefCallbackBatches[CBPDerefCallbackBatchStripeCount];
+
+/*
+ *  Callbacks waiting for a queue are kept in a table keyed by the queue, striped to keep completions bound for different
+ *  queues from contending. Only the callback that finds no batch pending submits a block to the queue; that block takes
+ *  the whole batch out of the table before running it, so anything that arrives while it runs starts the next batch.
+ *  The pending block retains the queue, so its address can't be reused while it has an entry.
+ */
+static void CBPDerefEnqueueBatchedCallback(dispatch_queue_t queue, dispatch_block_t block)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+
+        for (NSUInteger i = 0; i < CBPDerefCallbackBatchStripeCount; i++)
+        {
+            pthread_mutex_init(&CBPDerefCallbackBatchLocks[i], NULL);
+            CBPDerefCallbackBatches[i] = [NSMutableDictionary dictionary];
+        }
+
+    });
+
+    NSUInteger stripe = ((uintptr_t)(__bridge void *)queue >> 4) % CBPDerefCallbackBatchStripeCount;
+    NSValue *key = [NSValue valueWithPointer:(__bridge void *)queue];
+    BOOL submit = NO;
+
+    pthread_mutex_lock(&CBPDerefCallbackBatchLocks[stripe]);
+
+    NSMutableArray *batch = CBPDerefCallbackBatches[stripe][key];
+
+    if (!batch)
+    {
+        batch = [NSMutableArray array];
+        CBPDerefCallbackBatches[stripe][key] = batch;
+        submit = YES;
+    }
+
+    [batch addObject:[block copy]];
+
+    pthread_mutex_unlock(&CBPDerefCallbackBatchLocks[stripe]);
+
+    if (submit)
+    {
+        dispatch_async(queue, ^{
+
+            pthread_mutex_lock(&CBPDerefCallbackBatchLocks[stripe]);
+            NSArray *blocks = CBPDerefCallbackBatches[stripe][key];
+            [CBPDerefCallbackBatches[stripe] removeObjectForKey:key];
+            pthread_mutex_unlock(&CBPDerefCallbackBatchLocks[stripe]);
+
+            for (dispatch_block_t callback in blocks)
+            {
+                @autoreleasepool
+                {
+                    callback();
+                }
+            }
+
+        });
+    }
+}
+
+#pragma mark -
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
 @implementation CBPDeref
+{
+    _Atomic(uintptr_t) _stateWord;
+    _Atomic(void *) _continuations;
+    id _value;
+    NSError *_error;
+    BOOL _valueIsInline;
+}
 
 - (instancetype)init
 {
@@ -55,126 +211,715 @@ id const CBPDerefInvalidValue = @"CBPDerefInvalidValue";
 
     if (self)
     {
-        self.valid = YES;
-        self.state = CBPDerefStateIncomplete;
-        self.lock = [[NSConditionLock alloc] initWithCondition:CBPDerefLockStateWaiting];
+        atomic_init(&_stateWord, CBPDerefStateWordIncomplete);
+        atomic_init(&_continuations, NULL);
+        _callbackDelivery = [[self class] defaultCallbackDelivery];
+        CBPMetricsProbe(deref__create, self);
     }
 
     return self;
 }
 
+- (void)dealloc
+{
+    //-------------------------------------------------------------------
+    // Release any continuations of a deref that was never realized.
+    //-------------------------------------------------------------------
+    void *node = atomic_exchange_explicit(&_continuations, CBPDerefContinuationsClosed, memory_order_acquire);
+
+    while (node && node != CBPDerefContinuationsClosed)
+    {
+        CBPDerefContinuation *continuation = (__bridge_transfer CBPDerefContinuation *)node;
+        node = (__bridge void *)continuation.next;
+    }
+}
+
+- (CBPDerefState)state
+{
+    switch (atomic_load_explicit(&_stateWord, memory_order_acquire) & CBPDerefStateWordMask)
+    {
+        case CBPDerefStateWordComplete:
+            return CBPDerefStateComplete;
+        case CBPDerefStateWordInvalid:
+            return CBPDerefStateInvalid;
+        default:
+            return CBPDerefStateIncomplete;
+    }
+}
+
+- (BOOL)isRealized
+{
+    return CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire));
+}
+
+- (BOOL)isValid
+{
+    return (atomic_load_explicit(&_stateWord, memory_order_acquire) & CBPDerefStateWordMask) != CBPDerefStateWordInvalid;
+}
+
 - (id)deref
 {
-    if ([self.lock condition] != CBPDerefLockStateRealized)
+    if (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
     {
-        [self.lock lockWhenCondition:CBPDerefLockStateRealized];
-        [self.lock unlock];
+        [self _waitWithDeadline:NULL];
     }
 
-    return self.value;
+    return [self _realizedValue];
 }
 
 - (id)derefWithTimeoutInterval:(NSTimeInterval)timeoutInterval timeoutValue:(id)timeoutValue
 {
-    BOOL timedout = NO;
-
-    if ([self.lock condition] != CBPDerefLockStateRealized)
+    if (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
     {
-        if ([self.lock lockWhenCondition:CBPDerefLockStateRealized beforeDate:[NSDate dateWithTimeIntervalSinceNow:timeoutInterval]])
+        struct timespec deadline = CBPParkingLotDeadlineWithTimeoutInterval(timeoutInterval);
+
+        if (![self _waitWithDeadline:&deadline])
         {
-            [self.lock unlock];
+            return timeoutValue;
+        }
+    }
+
+    return [self _realizedValue];
+}
+
+- (BOOL)invalidateWithError:(NSError *)error
+{
+    return [self assignValue:CBPDerefInvalidValue error:error notify:YES newState:CBPDerefStateInvalid storeBlock:NULL criticalBlock:NULL];
+}
+
+- (NSError *)error
+{
+    return [self isRealized] ? _error : nil;
+}
+
++ (CBPDerefCallbackDelivery)defaultCallbackDelivery
+{
+    return atomic_load_explicit(&CBPDerefDefaultCallbackDelivery, memory_order_relaxed);
+}
+
++ (void)setDefaultCallbackDelivery:(CBPDerefCallbackDelivery)callbackDelivery
+{
+    atomic_store_explicit(&CBPDerefDefaultCallbackDelivery, callbackDelivery, memory_order_relaxed);
+}
+
+#pragma mark - Continuations
+
+- (CBPDeref *)then:(CBPDerefThenBlock)block onQueue:(dispatch_queue_t)queue
+{
+    CBPDeref *deref = [[CBPDeref alloc] init];
+
+    [self addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+        [deref assignValue:block(value, error)];
+
+    } queue:queue ? queue : CBPDerefDefaultContinuationQueue()];
+
+    return deref;
+}
+
+- (CBPDeref *)map:(CBPDerefMapBlock)block
+{
+    CBPDeref *deref = [[CBPDeref alloc] init];
+
+    [self addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+        if (state == CBPDerefStateComplete)
+        {
+            [deref assignValue:block(value)];
         }
         else
         {
-            timedout = YES;
+            [deref invalidateWithError:error];
         }
-    }
 
-    return timedout ? timeoutValue : self.value;
+    } queue:CBPDerefDefaultContinuationQueue()];
+
+    return deref;
 }
 
-- (BOOL)invalidateWithError:(NSError *)error
+- (CBPDeref *)flatMap:(CBPDerefFlatMapBlock)block
 {
-    return [self assignValue:CBPDerefInvalidValue error:error notify:YES newState:CBPDerefStateInvalid criticalBlock:NULL];
+    CBPDeref *deref = [[CBPDeref alloc] init];
+
+    [self addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+        if (state == CBPDerefStateComplete)
+        {
+            CBPDeref *nextDeref = block(value);
+
+            if (nextDeref)
+            {
+                [nextDeref addContinuation:^(CBPDerefState nextState, id nextValue, NSError *nextError) {
+
+                    [deref _realizeWithState:nextState value:nextValue error:nextError];
+
+                } queue:nil];
+            }
+            else
+            {
+                [deref assignValue:nil];
+            }
+        }
+        else
+        {
+            [deref invalidateWithError:error];
+        }
+
+    } queue:CBPDerefDefaultContinuationQueue()];
+
+    return deref;
 }
 
 #pragma mark - CBPDerefSubclass methods
 
 - (BOOL)assignValue:(id)value
 {
-    return [self assignValue:value error:nil notify:YES newState:CBPDerefStateComplete criticalBlock:NULL];
+    return [self assignValue:value error:nil notify:YES newState:CBPDerefStateComplete storeBlock:NULL criticalBlock:NULL];
+}
+
+- (BOOL)assignValueUsingBlock:(dispatch_block_t)storeBlock
+{
+    return [self assignValue:nil error:nil notify:YES newState:CBPDerefStateComplete storeBlock:storeBlock criticalBlock:NULL];
+}
+
+- (id)boxedValue
+{
+    return nil;
+}
+
+- (CBPDerefState)waitUntilRealized
+{
+    if (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
+    {
+        [self _waitWithDeadline:NULL];
+    }
+
+    return [self state];
+}
+
+- (CBPDerefState)waitUntilRealizedWithTimeoutInterval:(NSTimeInterval)timeoutInterval
+{
+    if (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
+    {
+        struct timespec deadline = CBPParkingLotDeadlineWithTimeoutInterval(timeoutInterval);
+        [self _waitWithDeadline:&deadline];
+    }
+
+    return [self state];
 }
 
 - (BOOL)valueHasBeenAssigned
 {
-    return [self.lock condition] == CBPDerefLockStateRealized;
+    return [self isRealized];
+}
+
+- (BOOL)performWorkWhileWaiting
+{
+    return NO;
+}
+
+#pragma mark - Combinators
+
++ (CBPDeref *)whenAll:(NSArray *)derefs
+{
+    CBPDeref *aggregateDeref = [[CBPDeref alloc] init];
+
+    if (![derefs count])
+    {
+        [aggregateDeref assignValue:@[]];
+        return aggregateDeref;
+    }
+
+    CBPDerefAggregate *aggregate = [[CBPDerefAggregate alloc] initWithCount:[derefs count]];
+
+    [derefs enumerateObjectsUsingBlock:^(CBPDeref *deref, NSUInteger idx, BOOL *stop) {
+
+        [deref addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+            if (state == CBPDerefStateComplete)
+            {
+                [aggregate setValue:value atIndex:idx];
+
+                if ([aggregate countDown])
+                {
+                    [aggregateDeref assignValue:[aggregate values]];
+                }
+            }
+            else
+            {
+                [aggregateDeref invalidateWithError:error];
+            }
+
+        } queue:nil];
+
+    }];
+
+    return aggregateDeref;
+}
+
++ (CBPDeref *)whenAny:(NSArray *)derefs
+{
+    return [self _raceDerefs:derefs requireSuccess:NO];
+}
+
++ (CBPDeref *)firstSuccessful:(NSArray *)derefs
+{
+    return [self _raceDerefs:derefs requireSuccess:YES];
+}
+
++ (CBPDeref *)_raceDerefs:(NSArray *)derefs requireSuccess:(BOOL)requireSuccess
+{
+    CBPDeref *aggregateDeref = [[CBPDeref alloc] init];
+
+    if (![derefs count])
+    {
+        [aggregateDeref invalidateWithError:nil];
+        return aggregateDeref;
+    }
+
+    //-------------------------------------------------------------------
+    // The aggregate only holds the inputs weakly, so an input that never
+    // completes doesn't keep the others alive through its continuation.
+    //-------------------------------------------------------------------
+    CBPDerefAggregate *aggregate = [[CBPDerefAggregate alloc] initWithDerefs:derefs];
+
+    [derefs enumerateObjectsUsingBlock:^(CBPDeref *deref, NSUInteger idx, BOOL *stop) {
+
+        [deref addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+            BOOL won = NO;
+
+            if (state == CBPDerefStateComplete || !requireSuccess)
+            {
+                won = [aggregateDeref _realizeWithState:state value:value error:error];
+            }
+
+            if ([aggregate countDown] && !won)
+            {
+                [aggregateDeref invalidateWithError:error];
+            }
+
+            if (won)
+            {
+                [aggregate invalidateDerefsOtherThan:idx];
+            }
+
+        } queue:nil];
+
+    }];
+
+    return aggregateDeref;
 }
 
 #pragma mark -
 
-- (BOOL)assignValue:(id)value error:(NSError *)error notify:(BOOL)notify newState:(CBPDerefState)newState criticalBlock:(dispatch_block_t)criticalBlock
+- (void)addContinuation:(CBPDerefContinuationBlock)block queue:(dispatch_queue_t)queue
 {
-    BOOL success = NO;
+    CBPDerefContinuation *continuation = [[CBPDerefContinuation alloc] init];
+    continuation.block = block;
+    continuation.queue = queue;
+
+    void *node = (__bridge_retained void *)continuation;
+    void *head = atomic_load_explicit(&_continuations, memory_order_acquire);
 
-    if ([self.lock tryLockWhenCondition:CBPDerefLockStateWaiting])
+    while (head != CBPDerefContinuationsClosed)
     {
-        success = YES;
+        continuation.next = (__bridge CBPDerefContinuation *)head;
 
-        @synchronized (self)
+        if (atomic_compare_exchange_weak_explicit(&_continuations, &head, node, memory_order_release, memory_order_acquire))
         {
-            self.state = newState;
-            self.value = value;
-            self.realized = YES;
-            [self.lock unlockWithCondition:CBPDerefLockStateRealized];
+            return;
+        }
+    }
+
+    (void)(__bridge_transfer CBPDerefContinuation *)node;
+
+    //-------------------------------------------------------------------
+    // The list is closed only after the state word has been published,
+    // so the value and error are safe to read here.
+    //-------------------------------------------------------------------
+    CBPDerefState state = [self state];
+    id value = [self _realizedValue];
+    NSError *error = _error;
+
+    if (queue)
+    {
+        dispatch_async(queue, ^{
+            block(state, value, error);
+        });
+    }
+    else
+    {
+        block(state, value, error);
+    }
+}
 
-            if (criticalBlock)
+#pragma mark -
+
+/**
+ *  Returns the value of a realized deref, boxing it if a subclass stored it inline.
+ */
+- (id)_realizedValue
+{
+    return _valueIsInline ? [self boxedValue] : _value;
+}
+
+- (BOOL)_realizeWithState:(CBPDerefState)state value:(id)value error:(NSError *)error
+{
+    if (state == CBPDerefStateComplete)
+    {
+        return [self assignValue:value];
+    }
+    else
+    {
+        return [self invalidateWithError:error];
+    }
+}
+
+/**
+ *  Performs every attached continuation in the order it was attached. Consecutive continuations that target the same queue are submitted to it as a single block.
+ */
+- (void)_performContinuationsWithState:(CBPDerefState)state value:(id)value error:(NSError *)error
+{
+    void *node = atomic_exchange_explicit(&_continuations, CBPDerefContinuationsClosed, memory_order_acq_rel);
+
+    if (!node)
+    {
+        return;
+    }
+
+    if (_valueIsInline)
+    {
+        value = [self boxedValue];
+    }
+
+    NSMutableArray *continuations = [NSMutableArray array];
+
+    while (node)
+    {
+        CBPDerefContinuation *continuation = (__bridge_transfer CBPDerefContinuation *)node;
+        node = (__bridge void *)continuation.next;
+        continuation.next = nil;
+        [continuations addObject:continuation];
+    }
+
+    NSUInteger index = [continuations count];
+
+    while (index > 0)
+    {
+        dispatch_queue_t queue = ((CBPDerefContinuation *)continuations[index - 1]).queue;
+        NSMutableArray *batch = [NSMutableArray array];
+
+        while (index > 0 && ((CBPDerefContinuation *)continuations[index - 1]).queue == queue)
+        {
+            [batch addObject:((CBPDerefContinuation *)continuations[--index]).block];
+        }
+
+        dispatch_block_t block = ^{
+
+            for (CBPDerefContinuationBlock continuationBlock in batch)
             {
-                criticalBlock();
+                continuationBlock(state, value, error);
             }
 
-            if (notify)
+        };
+
+        if (queue)
+        {
+            dispatch_async(queue, block);
+        }
+        else
+        {
+            block();
+        }
+    }
+}
+
+#pragma mark -
+
+/**
+ *  Blocks until the deref is realized or @p deadline passes. A NULL deadline waits forever.
+ *
+ *  @return YES if the deref was realized; otherwise, NO.
+ */
+- (BOOL)_waitWithDeadline:(const struct timespec *)deadline
+{
+    //-------------------------------------------------------------------
+    // An untimed waiter may do work instead of sleeping: its own value if
+    // that hasn't started yet and its executor allows it, or, on a pool
+    // worker, anything else queued on the pool, so nested derefs can't
+    // starve it. A timed waiter can't bound how long that work takes, so
+    // it only ever parks.
+    //-------------------------------------------------------------------
+    CBPWorkStealingExecutor *executor = deadline ? nil : [CBPWorkStealingExecutor currentExecutor];
+    uint64_t blockedTimestamp = CBPMetricsActive() ? CBPMetricsNow() : 0;
+
+    CBPMetricsProbe(deref__block, self);
+
+    //-------------------------------------------------------------------
+    // A fiber never holds its thread while it waits: it suspends, and a
+    // continuation puts it back on its thread's queue once the deref is
+    // realized. It doesn't help with pending work either; that work runs
+    // in an autorelease pool, and a nested deref suspending inside it
+    // would leave the pool open across the switch, on a small stack.
+    //-------------------------------------------------------------------
+    if (!deadline && CBPFiberIsRunning())
+    {
+        while (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
+        {
+            CBPFiberSuspend(^(dispatch_block_t resume) {
+
+                [self addContinuation:^(CBPDerefState state, id value, NSError *error) {
+                    resume();
+                } queue:nil];
+
+            });
+        }
+    }
+
+    //-------------------------------------------------------------------
+    // Waiters park on the deref's address in the shared parking lot. The
+    // waiters bit is set while the bucket is locked, so an assigner that
+    // sees it cannot unpark until we are actually parked.
+    //-------------------------------------------------------------------
+    while (!CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire)))
+    {
+        if (!deadline && [self performWorkWhileWaiting])
+        {
+            continue;
+        }
+
+        if (executor)
+        {
+            if (![executor performPendingBlock])
             {
-                dispatch_block_t block = NULL;
+                //-------------------------------------------------------------------
+                // New work doesn't unpark us, so only park briefly.
+                //-------------------------------------------------------------------
+                struct timespec helpingDeadline = CBPParkingLotDeadlineWithTimeoutInterval(CBPDerefHelpingParkInterval);
+                CBPParkingLotPark((__bridge const void *)self, CBPDerefSetWaitersBit, &_stateWord, &helpingDeadline);
+            }
+        }
+        else if (!CBPParkingLotPark((__bridge const void *)self, CBPDerefSetWaitersBit, &_stateWord, deadline) && deadline)
+        {
+            break;
+        }
+    }
 
-                if (newState == CBPDerefLockStateRealized)
-                {
-                    if (self.successBlock)
-                    {
-                        CBPDerefSuccessBlock successBlock = self.successBlock;
-
-                        block = ^{
-                            successBlock(value);
-                        };
-                    }
-                }
-                else if (newState == CBPDerefStateInvalid)
+    CBPMetricsProbe(deref__wake, self);
+
+    if (blockedTimestamp)
+    {
+        CBPMetricsRecord(CBPMetricDerefBlockTime, CBPMetricsNow() - blockedTimestamp);
+    }
+
+    return CBPDerefStateWordIsRealized(atomic_load_explicit(&_stateWord, memory_order_acquire));
+}
+
+- (BOOL)assignValue:(id)value error:(NSError *)error notify:(BOOL)notify newState:(CBPDerefState)newState storeBlock:(dispatch_block_t)storeBlock criticalBlock:(dispatch_block_t)criticalBlock
+{
+    //-------------------------------------------------------------------
+    // Claim the deref with a single CAS. Only the waiters bit may change
+    // underneath us, so the loop runs more than once only when a waiter
+    // arrives at the same moment.
+    //-------------------------------------------------------------------
+    uintptr_t word = atomic_load_explicit(&_stateWord, memory_order_relaxed);
+
+    do
+    {
+        if ((word & CBPDerefStateWordMask) != CBPDerefStateWordIncomplete)
+        {
+            return NO;
+        }
+    }
+    while (!atomic_compare_exchange_weak_explicit(&_stateWord, &word, CBPDerefStateWordAssigning | (word & CBPDerefStateWordWaiters), memory_order_acquire, memory_order_relaxed));
+
+    _value = value;
+    _error = error;
+
+    if (storeBlock)
+    {
+        storeBlock();
+        _valueIsInline = YES;
+    }
+
+    uintptr_t finalWord = newState == CBPDerefStateInvalid ? CBPDerefStateWordInvalid : CBPDerefStateWordComplete;
+    uintptr_t previousWord = atomic_exchange_explicit(&_stateWord, finalWord, memory_order_acq_rel);
+
+    if (previousWord & CBPDerefStateWordWaiters)
+    {
+        CBPParkingLotUnparkAll((__bridge const void *)self);
+    }
+
+    if (newState == CBPDerefStateInvalid)
+    {
+        CBPMetricsProbe(deref__invalidate, self);
+    }
+    else
+    {
+        CBPMetricsProbe(deref__realize, self);
+    }
+
+    if (criticalBlock)
+    {
+        criticalBlock();
+    }
+
+    [self _performContinuationsWithState:newState value:value error:error];
+
+    if (notify)
+    {
+        dispatch_block_t block = NULL;
+
+        if (newState == CBPDerefStateComplete)
+        {
+            if (self.successBlock)
+            {
+                CBPDerefSuccessBlock successBlock = self.successBlock;
+
+                if (_valueIsInline)
                 {
-                    self.valid = NO;
-                    
-                    if (self.invalidBlock)
-                    {
-                        CBPDerefInvalidBlock invalidBlock = self.invalidBlock;
-
-                        block = ^{
-                            invalidBlock(error);
-                        };
-                    }
+                    value = [self boxedValue];
                 }
 
-                if (block)
-                {
-                    dispatch_queue_t dispatchQueue = self.callbackQueue ? self.callbackQueue : dispatch_get_main_queue();
+                block = ^{
+                    successBlock(value);
+                };
+            }
+        }
+        else if (newState == CBPDerefStateInvalid)
+        {
+            if (self.invalidBlock)
+            {
+                CBPDerefInvalidBlock invalidBlock = self.invalidBlock;
+
+                block = ^{
+                    invalidBlock(error);
+                };
+            }
+        }
+
+        if (block)
+        {
+            if (CBPMetricsActive())
+            {
+                uint64_t realizedTimestamp = CBPMetricsNow();
+                dispatch_block_t callbackBlock = block;
+
+                block = ^{
+                    CBPMetricsRecord(CBPMetricCallbackDelay, CBPMetricsNow() - realizedTimestamp);
+                    callbackBlock();
+                };
+            }
+
+            dispatch_queue_t dispatchQueue = self.callbackQueue ? self.callbackQueue : dispatch_get_main_queue();
+
+            switch (self.callbackDelivery)
+            {
+                case CBPDerefCallbackDeliveryInline:
+                    block();
+                    break;
+                case CBPDerefCallbackDeliveryBatched:
+                    CBPDerefEnqueueBatchedCallback(dispatchQueue, block);
+                    break;
+                case CBPDerefCallbackDeliveryQueue:
                     dispatch_async(dispatchQueue, block);
-                }
+                    break;
             }
-            
-            self.successBlock = NULL;
-            self.invalidBlock = NULL;
-            self.callbackQueue = NULL;
         }
     }
-    
-    return success;
+
+    self.successBlock = NULL;
+    self.invalidBlock = NULL;
+    self.callbackQueue = NULL;
+
+    return YES;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPDerefAggregate
+{
+    _Atomic(NSUInteger) _remaining;
+    NSUInteger _count;
+    __strong id *_values;
+    NSPointerArray *_derefs;
+}
+
+- (instancetype)initWithDerefs:(NSArray *)derefs
+{
+    self = [super init];
+
+    if (self)
+    {
+        _count = [derefs count];
+        atomic_init(&_remaining, _count);
+        _derefs = [NSPointerArray weakObjectsPointerArray];
+
+        for (CBPDeref *deref in derefs)
+        {
+            [_derefs addPointer:(__bridge void *)deref];
+        }
+    }
+
+    return self;
+}
+
+- (instancetype)initWithCount:(NSUInteger)count
+{
+    self = [super init];
+
+    if (self)
+    {
+        _count = count;
+        atomic_init(&_remaining, count);
+        _values = (__strong id *)calloc(count, sizeof(id));
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_values)
+    {
+        for (NSUInteger i = 0; i < _count; i++)
+        {
+            _values[i] = nil;
+        }
+
+        free(_values);
+    }
+}
+
+- (BOOL)countDown
+{
+    return atomic_fetch_sub_explicit(&_remaining, 1, memory_order_acq_rel) == 1;
+}
+
+- (void)setValue:(id)value atIndex:(NSUInteger)index
+{
+    _values[index] = value ? value : [NSNull null];
+}
+
+- (NSArray *)values
+{
+    return [NSArray arrayWithObjects:_values count:_count];
+}
+
+- (void)invalidateDerefsOtherThan:(NSUInteger)winner
+{
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        CBPDeref *deref = (__bridge CBPDeref *)[_derefs pointerAtIndex:i];
+
+        if (i != winner)
+        {
+            [deref invalidateWithError:nil];
+        }
+    }
 }
 
 @end
@@ -24,6 +24,11 @@
 
 #import "CBPDeref.h"
 
+/**
+ *  A continuation's view of a realized deref. The deref itself is not passed so that continuations may safely run while it is being deallocated.
+ */
+typedef void (^CBPDerefContinuationBlock)(CBPDerefState state, id value, NSError *error);
+
 @interface CBPDeref ()
 
 /**
@@ -35,4 +40,49 @@
  */
 - (BOOL)assignValue:(id)value;
 
+/**
+ *  Realizes the deref with a value the subclass stores in its own instance variables, so completing it allocates nothing. @p storeBlock is performed only if the deref hasn't already been realized, after it has been claimed and before it is published, so whoever observes the deref as complete may read what it wrote without a lock. @p -deref, callbacks and continuations see @p -boxedValue instead.
+ *
+ *  @param storeBlock Writes the value. It is performed synchronously and not copied.
+ *
+ *  @return YES if the deref hasn't already been realized and hasn't been invalidated; otherwise, NO.
+ */
+- (BOOL)assignValueUsingBlock:(dispatch_block_t)storeBlock;
+
+/**
+ *  Returns the value stored by @p -assignValueUsingBlock: as an object. Only called when something asks for the value as an object. The default implementation returns nil.
+ */
+- (id)boxedValue;
+
+/**
+ *  Waits indefinitely until the deref has been realized or invalidated, without reading its value.
+ *
+ *  @return The state of the deref.
+ */
+- (CBPDerefState)waitUntilRealized;
+
+/**
+ *  Waits until the deref has been realized or invalidated, or the timeout has expired.
+ *
+ *  @param timeoutInterval The amount of time to block.
+ *
+ *  @return The state of the deref, which is @p CBPDerefStateIncomplete if the timeout expired.
+ */
+- (CBPDerefState)waitUntilRealizedWithTimeoutInterval:(NSTimeInterval)timeoutInterval;
+
+/**
+ *  Adds a continuation that will be performed exactly once, when the deref is realized. If the deref has already been realized the continuation is performed immediately.
+ *
+ *  @param block The continuation.
+ *  @param queue The queue on which to perform the continuation, or nil to perform it on the thread that realizes the deref.
+ */
+- (void)addContinuation:(CBPDerefContinuationBlock)block queue:(dispatch_queue_t)queue;
+
+/**
+ *  Called on a thread that is about to block indefinitely waiting for the deref to be realized. Timed waits never call this method. Subclasses that know how to make progress on their own value, such as a future whose work hasn't started, can do that work here instead of letting the thread sleep. The default implementation does nothing.
+ *
+ *  @return YES if any work was done, in which case the deref is checked again before the thread blocks; otherwise, NO.
+ */
+- (BOOL)performWorkWhileWaiting;
+
 @end
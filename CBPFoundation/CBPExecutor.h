@@ -0,0 +1,93 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  An object that performs blocks. CBPExecutor is an abstract class; use @p +defaultExecutor, @p +executorWithQueue:, or a concrete subclass such as CBPWorkStealingExecutor.
+ */
+@interface CBPExecutor : NSObject
+
+/**
+ *  Returns the shared work-stealing executor, which has one worker per active processor.
+ *
+ *  @return The default executor.
+ */
++ (CBPExecutor *)defaultExecutor;
+
+/**
+ *  Returns an executor that submits blocks to a dispatch queue.
+ *
+ *  @param queue The queue on which to perform blocks. This value must not be nil.
+ *
+ *  @return An executor backed by @p queue.
+ */
++ (CBPExecutor *)executorWithQueue:(dispatch_queue_t)queue;
+
+/**
+ *  Performs a block asynchronously. Subclasses must override this method.
+ *
+ *  @param block The block to perform.
+ */
+- (void)execute:(dispatch_block_t)block;
+
+/**
+ *  Whether work submitted to the executor may instead be performed by a thread that is waiting for it, such as a thread dereferencing a future whose work hasn't started. The default implementation returns YES.
+ */
+@property (readonly) BOOL allowsInlineExecution;
+
+@end
+
+#pragma mark -
+
+/**
+ *  An executor that submits blocks to a dispatch queue.
+ */
+@interface CBPQueueExecutor : CBPExecutor
+
+/**
+ *  Initializes an executor backed by a dispatch queue. Work is only performed inline by waiting threads if @p queue is one of the global concurrent queues; work on serial queues, the main queue and custom concurrent queues stays on its queue.
+ *
+ *  @param queue The queue on which to perform blocks. This value must not be nil or an exception will be thrown.
+ *
+ *  @return An initialized executor.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue;
+
+/**
+ *  Initializes an executor backed by a dispatch queue.
+ *
+ *  @param queue                 The queue on which to perform blocks. This value must not be nil or an exception will be thrown.
+ *  @param allowsInlineExecution Whether waiting threads may perform work instead of @p queue. Pass YES only if the work doesn't rely on the queue for mutual exclusion or for the thread it runs on.
+ *
+ *  @return An initialized executor.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue allowsInlineExecution:(BOOL)allowsInlineExecution;
+
+/**
+ *  The queue on which blocks are performed.
+ */
+@property (readonly) dispatch_queue_t queue;
+
+@end
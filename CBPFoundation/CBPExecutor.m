@@ -0,0 +1,130 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPExecutor.h"
+#import "CBPWorkStealingExecutor.h"
+
+@implementation CBPExecutor
+
++ (CBPExecutor *)defaultExecutor
+{
+    static CBPExecutor *defaultExecutor = nil;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultExecutor = [[CBPWorkStealingExecutor alloc] initWithNumberOfWorkers:[[NSProcessInfo processInfo] activeProcessorCount]];
+    });
+
+    return defaultExecutor;
+}
+
++ (CBPExecutor *)executorWithQueue:(dispatch_queue_t)queue
+{
+    return [[CBPQueueExecutor alloc] initWithQueue:queue];
+}
+
+- (BOOL)allowsInlineExecution
+{
+    return YES;
+}
+
+- (void)execute:(dispatch_block_t)block
+{
+    [NSException raise:NSInternalInconsistencyException format:@"-execute: must be implemented by subclasses of CBPExecutor. %s", __PRETTY_FUNCTION__];
+}
+
+@end
+
+#pragma mark -
+
+/*
+ *  Only the global queues are known to be concurrent; a custom queue's attributes can't be inspected, so it is treated
+ *  as serial.
+ */
+static BOOL CBPQueueIsGlobalConcurrentQueue(dispatch_queue_t queue)
+{
+    static dispatch_queue_t globalQueues[4];
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        globalQueues[0] = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0);
+        globalQueues[1] = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        globalQueues[2] = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+        globalQueues[3] = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
+    });
+
+    for (NSUInteger i = 0; i < sizeof(globalQueues) / sizeof(globalQueues[0]); i++)
+    {
+        if (queue == globalQueues[i])
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+@interface CBPQueueExecutor ()
+
+@property (readwrite) dispatch_queue_t queue;
+
+@property (readwrite) BOOL allowsInlineExecution;
+
+@end
+
+@implementation CBPQueueExecutor
+
+@synthesize allowsInlineExecution = _allowsInlineExecution;
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    return [self initWithQueue:queue allowsInlineExecution:CBPQueueIsGlobalConcurrentQueue(queue)];
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue allowsInlineExecution:(BOOL)allowsInlineExecution
+{
+    if (!queue)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"queue must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+    else
+    {
+        self = [super init];
+
+        if (self)
+        {
+            self.queue = queue;
+            self.allowsInlineExecution = allowsInlineExecution;
+        }
+    }
+
+    return self;
+}
+
+- (void)execute:(dispatch_block_t)block
+{
+    dispatch_async(self.queue, block);
+}
+
+@end
@@ -0,0 +1,41 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/*
+ *  The interface between CBPDeref and CBPFiberScheduler.
+ */
+
+/**
+ *  Returns YES if the caller is running in a fiber.
+ */
+extern BOOL CBPFiberIsRunning(void);
+
+/**
+ *  Suspends the calling fiber until it is resumed. @p arm is performed on the fiber before it suspends and must arrange for the @p resume block it is passed to be called exactly once, from any thread, possibly before @p arm returns.
+ *
+ *  @param arm Registers the wakeup.
+ */
+extern void CBPFiberSuspend(void (^arm)(dispatch_block_t resume));
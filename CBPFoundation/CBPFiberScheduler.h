@@ -0,0 +1,84 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  Runs blocks as fibers: user-space threads with their own stacks, multiplexed over a few OS threads. A fiber that calls @p -deref on an unrealized CBPDeref is suspended, freeing its thread for other fibers, and is resumed once the deref is realized. Code outside a fiber, and timed derefs anywhere, block their thread as usual.
+ *
+ *  Each fiber stays on the thread it was first scheduled on, so thread-local state survives a suspension. Objects autoreleased by a fiber are released when it next suspends or finishes, so an @p \@autoreleasepool block must not span a deref that may suspend.
+ *
+ *  Fibers are only supported on Linux; see @p +isSupported.
+ */
+@interface CBPFiberScheduler : NSObject
+
+/**
+ *  Returns YES if fibers are supported on this platform. On other platforms the initializers throw an exception.
+ */
++ (BOOL)isSupported;
+
+/**
+ *  Returns YES if the caller is running in a fiber.
+ */
++ (BOOL)isRunningInFiber;
+
+/**
+ *  Initializes a scheduler with one thread per active processor and 64 KB stacks.
+ *
+ *  @return An initialized scheduler.
+ */
+- (instancetype)init;
+
+/**
+ *  Initializes a scheduler and starts its threads.
+ *
+ *  @param numberOfThreads The number of threads to run fibers on. This value must be greater than 0 or an exception will be thrown.
+ *  @param stackSize       The usable stack size of each fiber in bytes, rounded up to a whole number of pages. Every stack is preceded by an inaccessible guard page, so an overflow crashes instead of corrupting memory. Stacks are reserved lazily and reused as fibers finish. Each stack and its guard page take two kernel memory mappings, so running more than about 30,000 fibers at once needs a higher vm.max_map_count than Linux's default.
+ *
+ *  @return An initialized scheduler.
+ */
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads stackSize:(NSUInteger)stackSize;
+
+/**
+ *  Runs @p block in a new fiber.
+ *
+ *  @param block The block to run. This value must not be nil or an exception will be thrown.
+ */
+- (void)spawnFiber:(dispatch_block_t)block;
+
+@property (readonly) NSUInteger numberOfThreads;
+
+@property (readonly) NSUInteger stackSize;
+
+/**
+ *  The number of fibers that have been spawned and have not finished, including suspended fibers.
+ */
+@property (readonly) NSUInteger numberOfFibers;
+
+/**
+ *  Waits for every fiber to finish, then stops the scheduler's threads. Fibers may not be spawned afterwards.
+ */
+- (void)invalidate;
+
+@end
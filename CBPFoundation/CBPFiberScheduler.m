@@ -0,0 +1,521 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPFiberScheduler.h"
+#import "CBPFiberRuntime.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+#if defined(__linux__)
+#define CBP_FIBERS_SUPPORTED 1
+#import <errno.h>
+#import <sys/mman.h>
+#import <ucontext.h>
+#import <unistd.h>
+#else
+#define CBP_FIBERS_SUPPORTED 0
+#endif
+
+#if CBP_FIBERS_SUPPORTED
+
+/*
+ *  Finished fibers keep their stacks and are reused by later spawns, up to this many per scheduler.
+ */
+static const NSUInteger CBPFiberMaximumPooledFibers = 1024;
+
+static const NSUInteger CBPFiberMinimumStackSize = 16 * 1024;
+
+#pragma mark - Fibers
+
+/*
+ *  A suspending fiber and whoever resumes it race through parkState. The fiber sets Running before it arms its wakeup;
+ *  once it has switched back to its worker, the worker swaps in Parked and the resumer swaps in Woken. Whichever swap
+ *  comes second sees the other's value and queues the fiber, so it is never queued while it is still running on its
+ *  own stack, and never lost.
+ */
+typedef NS_ENUM(int, CBPFiberParkState)
+{
+    CBPFiberParkStateRunning,
+    CBPFiberParkStateParked,
+    CBPFiberParkStateWoken
+};
+
+typedef struct CBPFiber
+{
+    ucontext_t context;
+    struct CBPFiberWorker *worker;
+    void *block;
+    void *mapping;
+    size_t mappingSize;
+    _Atomic(int) parkState;
+    BOOL finished;
+    struct CBPFiber *next;
+} CBPFiber;
+
+typedef struct CBPFiberWorker
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    CBPFiber *head;
+    CBPFiber *tail;
+    BOOL stopping;
+    CBPFiber *current;
+    ucontext_t context;
+} CBPFiberWorker;
+
+static pthread_key_t CBPFiberCurrentWorkerKey(void)
+{
+    static pthread_key_t currentWorkerKey;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&currentWorkerKey, NULL);
+    });
+
+    return currentWorkerKey;
+}
+
+static void CBPFiberEnqueue(CBPFiber *fiber)
+{
+    CBPFiberWorker *worker = fiber->worker;
+
+    pthread_mutex_lock(&worker->mutex);
+
+    fiber->next = NULL;
+
+    if (worker->tail)
+    {
+        worker->tail->next = fiber;
+    }
+    else
+    {
+        worker->head = fiber;
+    }
+
+    worker->tail = fiber;
+
+    pthread_cond_signal(&worker->condition);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+/*
+ *  makecontext only passes int arguments, so the fiber arrives in two halves.
+ */
+static void CBPFiberMain(unsigned int high, unsigned int low)
+{
+    CBPFiber *fiber = (CBPFiber *)(uintptr_t)(((uint64_t)high << 32) | low);
+    dispatch_block_t block = (__bridge_transfer dispatch_block_t)fiber->block;
+    fiber->block = NULL;
+
+    block();
+
+    //-------------------------------------------------------------------
+    // This frame is never returned from, so nothing is released at the
+    // end of its scope.
+    //-------------------------------------------------------------------
+    block = nil;
+    fiber->finished = YES;
+
+    setcontext(&fiber->worker->context);
+}
+
+BOOL CBPFiberIsRunning(void)
+{
+    CBPFiberWorker *worker = pthread_getspecific(CBPFiberCurrentWorkerKey());
+
+    return worker && worker->current;
+}
+
+void CBPFiberSuspend(void (^arm)(dispatch_block_t resume))
+{
+    CBPFiberWorker *worker = pthread_getspecific(CBPFiberCurrentWorkerKey());
+    CBPFiber *fiber = worker->current;
+
+    atomic_store_explicit(&fiber->parkState, CBPFiberParkStateRunning, memory_order_relaxed);
+
+    arm(^{
+
+        if (atomic_exchange_explicit(&fiber->parkState, CBPFiberParkStateWoken, memory_order_acq_rel) == CBPFiberParkStateParked)
+        {
+            CBPFiberEnqueue(fiber);
+        }
+
+    });
+
+    swapcontext(&fiber->context, &worker->context);
+}
+
+#pragma mark -
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPFiberScheduler
+{
+    CBPFiberWorker *_workers;
+    _Atomic(NSUInteger) _nextWorker;
+    _Atomic(NSUInteger) _numberOfFibers;
+    _Atomic(BOOL) _invalidated;
+    dispatch_group_t _threadGroup;
+    pthread_mutex_t _poolMutex;
+    pthread_cond_t _poolCondition;
+    CBPFiber *_pooledFibers;
+    NSUInteger _numberOfPooledFibers;
+    size_t _pageSize;
+}
+
++ (BOOL)isSupported
+{
+    return YES;
+}
+
++ (BOOL)isRunningInFiber
+{
+    return CBPFiberIsRunning();
+}
+
+- (instancetype)init
+{
+    return [self initWithNumberOfThreads:[[NSProcessInfo processInfo] activeProcessorCount] stackSize:64 * 1024];
+}
+
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads stackSize:(NSUInteger)stackSize
+{
+    if (!numberOfThreads)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"A CBPFiberScheduler must have at least one thread. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        _pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        _numberOfThreads = numberOfThreads;
+        _stackSize = (MAX(stackSize, CBPFiberMinimumStackSize) + _pageSize - 1) / _pageSize * _pageSize;
+        _threadGroup = dispatch_group_create();
+        atomic_init(&_nextWorker, 0);
+        atomic_init(&_numberOfFibers, 0);
+        atomic_init(&_invalidated, NO);
+        pthread_mutex_init(&_poolMutex, NULL);
+        pthread_cond_init(&_poolCondition, NULL);
+
+        _workers = calloc(numberOfThreads, sizeof(CBPFiberWorker));
+
+        for (NSUInteger i = 0; i < numberOfThreads; i++)
+        {
+            pthread_mutex_init(&_workers[i].mutex, NULL);
+            pthread_cond_init(&_workers[i].condition, NULL);
+        }
+
+        for (NSUInteger i = 0; i < numberOfThreads; i++)
+        {
+            dispatch_group_enter(_threadGroup);
+
+            NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(_runWorker:) object:@(i)];
+            thread.name = [NSString stringWithFormat:@"CBPFiberScheduler thread %lu", (unsigned long)i];
+            [thread start];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    while (_pooledFibers)
+    {
+        CBPFiber *fiber = _pooledFibers;
+        _pooledFibers = fiber->next;
+        munmap(fiber->mapping, fiber->mappingSize);
+        free(fiber);
+    }
+
+    for (NSUInteger i = 0; i < _numberOfThreads; i++)
+    {
+        pthread_mutex_destroy(&_workers[i].mutex);
+        pthread_cond_destroy(&_workers[i].condition);
+    }
+
+    free(_workers);
+    pthread_mutex_destroy(&_poolMutex);
+    pthread_cond_destroy(&_poolCondition);
+}
+
+- (NSUInteger)numberOfFibers
+{
+    return atomic_load_explicit(&_numberOfFibers, memory_order_relaxed);
+}
+
+- (void)spawnFiber:(dispatch_block_t)block
+{
+    if (!block)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"block must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    //-------------------------------------------------------------------
+    // Count the fiber before checking for invalidation, which sets the
+    // flag before it checks the count, so one of the two always notices.
+    //-------------------------------------------------------------------
+    atomic_fetch_add(&_numberOfFibers, 1);
+
+    if (atomic_load(&_invalidated))
+    {
+        [self _fiberDidFinish:NULL];
+        [NSException raise:NSInternalInconsistencyException format:@"Fibers can't be spawned on an invalidated scheduler. %s", __PRETTY_FUNCTION__];
+    }
+
+    CBPFiber *fiber = [self _dequeueFiber];
+    fiber->block = (__bridge_retained void *)[block copy];
+    fiber->finished = NO;
+    fiber->worker = &_workers[atomic_fetch_add_explicit(&_nextWorker, 1, memory_order_relaxed) % _numberOfThreads];
+    atomic_store_explicit(&fiber->parkState, CBPFiberParkStateRunning, memory_order_relaxed);
+
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = (uint8_t *)fiber->mapping + _pageSize;
+    fiber->context.uc_stack.ss_size = _stackSize;
+    fiber->context.uc_link = NULL;
+
+    uint64_t address = (uint64_t)(uintptr_t)fiber;
+    makecontext(&fiber->context, (void (*)(void))CBPFiberMain, 2, (unsigned int)(address >> 32), (unsigned int)address);
+
+    CBPFiberEnqueue(fiber);
+}
+
+- (void)invalidate
+{
+    atomic_store(&_invalidated, YES);
+
+    pthread_mutex_lock(&_poolMutex);
+
+    while (atomic_load(&_numberOfFibers))
+    {
+        pthread_cond_wait(&_poolCondition, &_poolMutex);
+    }
+
+    pthread_mutex_unlock(&_poolMutex);
+
+    for (NSUInteger i = 0; i < _numberOfThreads; i++)
+    {
+        pthread_mutex_lock(&_workers[i].mutex);
+        _workers[i].stopping = YES;
+        pthread_cond_signal(&_workers[i].condition);
+        pthread_mutex_unlock(&_workers[i].mutex);
+    }
+
+    dispatch_group_wait(_threadGroup, DISPATCH_TIME_FOREVER);
+}
+
+#pragma mark -
+
+- (void)_runWorker:(NSNumber *)index
+{
+    CBPFiberWorker *worker = &_workers[[index unsignedIntegerValue]];
+    pthread_setspecific(CBPFiberCurrentWorkerKey(), worker);
+
+    while (YES)
+    {
+        pthread_mutex_lock(&worker->mutex);
+
+        while (!worker->head && !worker->stopping)
+        {
+            pthread_cond_wait(&worker->condition, &worker->mutex);
+        }
+
+        CBPFiber *fiber = worker->head;
+
+        if (fiber)
+        {
+            worker->head = fiber->next;
+
+            if (!worker->head)
+            {
+                worker->tail = NULL;
+            }
+        }
+
+        pthread_mutex_unlock(&worker->mutex);
+
+        if (!fiber)
+        {
+            break;
+        }
+
+        worker->current = fiber;
+
+        @autoreleasepool
+        {
+            swapcontext(&worker->context, &fiber->context);
+        }
+
+        worker->current = NULL;
+
+        if (fiber->finished)
+        {
+            [self _fiberDidFinish:fiber];
+        }
+        else if (atomic_exchange_explicit(&fiber->parkState, CBPFiberParkStateParked, memory_order_acq_rel) == CBPFiberParkStateWoken)
+        {
+            CBPFiberEnqueue(fiber);
+        }
+    }
+
+    pthread_setspecific(CBPFiberCurrentWorkerKey(), NULL);
+    dispatch_group_leave(_threadGroup);
+}
+
+- (CBPFiber *)_dequeueFiber
+{
+    pthread_mutex_lock(&_poolMutex);
+
+    CBPFiber *fiber = _pooledFibers;
+
+    if (fiber)
+    {
+        _pooledFibers = fiber->next;
+        _numberOfPooledFibers--;
+    }
+
+    pthread_mutex_unlock(&_poolMutex);
+
+    if (!fiber)
+    {
+        //-------------------------------------------------------------------
+        // The stack grows down, so the guard page goes at the bottom of the
+        // mapping.
+        //-------------------------------------------------------------------
+        size_t mappingSize = _stackSize + _pageSize;
+        void *mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+        if (mapping != MAP_FAILED && mprotect(mapping, _pageSize, PROT_NONE) != 0)
+        {
+            int error = errno;
+            munmap(mapping, mappingSize);
+            mapping = MAP_FAILED;
+            errno = error;
+        }
+
+        if (mapping == MAP_FAILED)
+        {
+            [self _fiberDidFinish:NULL];
+            [NSException raise:NSMallocException format:@"Couldn't map a %lu byte fiber stack: %s. Each stack takes two mappings, so vm.max_map_count may need raising. %s", (unsigned long)mappingSize, strerror(errno), __PRETTY_FUNCTION__];
+        }
+
+        fiber = calloc(1, sizeof(CBPFiber));
+        fiber->mapping = mapping;
+        fiber->mappingSize = mappingSize;
+    }
+
+    return fiber;
+}
+
+/**
+ *  Returns a finished fiber's stack to the pool and counts it out. @p fiber is NULL when a spawn is refused.
+ */
+- (void)_fiberDidFinish:(CBPFiber *)fiber
+{
+    CBPFiber *unpooledFiber = NULL;
+
+    pthread_mutex_lock(&_poolMutex);
+
+    if (fiber && _numberOfPooledFibers < CBPFiberMaximumPooledFibers)
+    {
+        fiber->next = _pooledFibers;
+        _pooledFibers = fiber;
+        _numberOfPooledFibers++;
+    }
+    else
+    {
+        unpooledFiber = fiber;
+    }
+
+    if (atomic_fetch_sub(&_numberOfFibers, 1) == 1)
+    {
+        pthread_cond_broadcast(&_poolCondition);
+    }
+
+    pthread_mutex_unlock(&_poolMutex);
+
+    if (unpooledFiber)
+    {
+        munmap(unpooledFiber->mapping, unpooledFiber->mappingSize);
+        free(unpooledFiber);
+    }
+}
+
+@end
+
+#else
+
+BOOL CBPFiberIsRunning(void)
+{
+    return NO;
+}
+
+void CBPFiberSuspend(void (^arm)(dispatch_block_t resume))
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Fibers are not supported on this platform. %s", __PRETTY_FUNCTION__];
+}
+
+@implementation CBPFiberScheduler
+
++ (BOOL)isSupported
+{
+    return NO;
+}
+
++ (BOOL)isRunningInFiber
+{
+    return NO;
+}
+
+- (instancetype)init
+{
+    return [self initWithNumberOfThreads:1 stackSize:0];
+}
+
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads stackSize:(NSUInteger)stackSize
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Fibers are not supported on this platform. %s", __PRETTY_FUNCTION__];
+    return nil;
+}
+
+- (NSUInteger)numberOfFibers
+{
+    return 0;
+}
+
+- (void)spawnFiber:(dispatch_block_t)block
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Fibers are not supported on this platform. %s", __PRETTY_FUNCTION__];
+}
+
+- (void)invalidate
+{
+    ;
+}
+
+@end
+
+#endif
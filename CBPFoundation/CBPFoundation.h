@@ -24,13 +24,29 @@
 
 @import Foundation;
 #import "CBPRuntime.h"
+#import "CBPMethodCache.h"
 #import "NSString+CBPExtensions.h"
+#import "CBPStringSearch.h"
+#import "CBPStringMatcher.h"
 #import "NSThread+CBPExtensions.h"
+#import "CBPThreadConfiguration.h"
+#import "CBPRunLoopThreadPool.h"
+#import "CBPFiberScheduler.h"
 #import "NSArray+CBPExtensions.h"
 #import "NSMutableArray+CBPExtensions.h"
+#import "CBPMetrics.h"
 #import "CBPDeref.h"
+#import "CBPExecutor.h"
+#import "CBPWorkStealingExecutor.h"
+#import "CBPParallel.h"
+#import "CBPCancellationToken.h"
 #import "CBPFuture.h"
+#import "CBPTypedFuture.h"
+#import "CBPFutureCache.h"
+#import "CBPBatcher.h"
 #import "CBPPromise.h"
+#import "CBPTimerWheel.h"
 #import "CBPCollectionTypes.h"
+#import "CBPSequence.h"
 #import "CBPTask.h"
 #import "CBPBackgroundTask.h"
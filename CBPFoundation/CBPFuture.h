@@ -24,9 +24,11 @@
 
 @import Foundation;
 #import "CBPDeref.h"
+#import "CBPExecutor.h"
+#import "CBPCancellationToken.h"
 
 /**
- *  Use this block to determine if the future is canceled or not. Similar to an NSOperation, the value of this block should be checked occasionally in longer running work blocks.
+ *  Use this block to determine if the future is canceled or not. Similar to an NSOperation, the value of this block should be checked occasionally in longer running work blocks. Calling it costs a single relaxed load.
  *
  *  @return YES if the future has been canceled, otherwise NO.
  */
@@ -48,7 +50,47 @@ typedef id (^CBPFutureWorkBlock)(CBPFutureCanceledBlock isCanceled);
 /**
  *  Initializes and starts a new future.
  *
- *  @param queue     The queue on which to perform the work. If nil, a global concurrent background queue will be used.
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used. If the work hasn't started by the time the future is dereferenced without a timeout and the executor's @p allowsInlineExecution is YES, it is performed on the dereferencing thread instead.
+ *  @param cancellationToken A token that invalidates the future when cancelled. If the work hasn't started by then it is never performed. May be nil.
+ *  @param workBlock         The work block whose value will be computed in the background and cached. An exception will be thrown if @p -main is also implemented.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock;
+
+/**
+ *  Initializes and starts a new future. @p -main must be implemented or an exception will be thrown.
+ *
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used. If the work hasn't started by the time the future is dereferenced without a timeout and the executor's @p allowsInlineExecution is YES, it is performed on the dereferencing thread instead.
+ *  @param cancellationToken A token that invalidates the future when cancelled. If the work hasn't started by then it is never performed. May be nil.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken;
+
+/**
+ *  Initializes and starts a new future.
+ *
+ *  @param executor  The executor on which to perform the work. If nil, the default executor will be used. If the work hasn't started by the time the future is dereferenced without a timeout and the executor's @p allowsInlineExecution is YES, it is performed on the dereferencing thread instead.
+ *  @param workBlock The work block whose value will be computed in the background and cached. An exception will be thrown if @p -main is also implemented.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor workBlock:(CBPFutureWorkBlock)workBlock;
+
+/**
+ *  Initializes and starts a new future. @p -main must be implemented or an exception will be thrown.
+ *
+ *  @param executor The executor on which to perform the work. If nil, the default executor will be used. If the work hasn't started by the time the future is dereferenced without a timeout and the executor's @p allowsInlineExecution is YES, it is performed on the dereferencing thread instead.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor;
+
+/**
+ *  Initializes and starts a new future.
+ *
+ *  @param queue     The queue on which to perform the work. If nil, the default executor will be used. Only work on a global concurrent queue may be performed on a dereferencing thread instead; see @p -[CBPQueueExecutor initWithQueue:].
  *  @param workBlock The work block whose value will be computed in the background and cached. An exception will be thrown if @p -main is also implemented.
  *
  *  @return An initialized future.
@@ -58,12 +100,17 @@ typedef id (^CBPFutureWorkBlock)(CBPFutureCanceledBlock isCanceled);
 /**
  *  Initializes and starts a new future. @p -main must be implemented or an exception will be thrown.
  *
- *  @param queue The queue on which to perform the work. If nil, an internal concurrent queue will be used.
+ *  @param queue The queue on which to perform the work. If nil, the default executor will be used. Only work on a global concurrent queue may be performed on a dereferencing thread instead; see @p -[CBPQueueExecutor initWithQueue:].
  *
  *  @return An initialized future.
  */
 - (instancetype)initWithQueue:(dispatch_queue_t)queue;
 
+/**
+ *  YES once the future has been invalidated, either directly or through its cancellation token. Subclasses implementing @p -main should check this occasionally in longer running work.
+ */
+@property (readonly, getter = isCanceled) BOOL canceled;
+
 @end
 
 #pragma mark - CBPFuture subclass methods
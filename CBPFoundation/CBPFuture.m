@@ -23,31 +23,49 @@
  */
 
 #import "CBPFuture.h"
-#import "CBPDerefSubclass.h"
+#import "CBPFutureSubclass.h"
+#import "CBPMetricsRecording.h"
+#import <stdatomic.h>
 
 @interface CBPFuture ()
 
-@property dispatch_queue_t workQueue;
+@property CBPExecutor *executor;
 
 @property (copy) CBPFutureWorkBlock workBlock;
 
 @end
 
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
 @implementation CBPFuture
+{
+    _Atomic(BOOL) _claimed;
+    _Atomic(BOOL) _canceled;
+    uint64_t _startTimestamp;
+    uint64_t _runTimestamp;
+}
 
-+ (dispatch_queue_t)sharedDispatchQueue
+- (instancetype)initWithQueue:(dispatch_queue_t)queue workBlock:(CBPFutureWorkBlock)workBlock
 {
-    static dispatch_queue_t sharedDispatchQueue = NULL;
+    return [self initWithExecutor:(queue ? [CBPExecutor executorWithQueue:queue] : nil) workBlock:workBlock];
+}
 
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        sharedDispatchQueue = dispatch_queue_create("CBPFutureSharedDispatchQueue", DISPATCH_QUEUE_CONCURRENT);
-    });
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    return [self initWithExecutor:(queue ? [CBPExecutor executorWithQueue:queue] : nil)];
+}
 
-    return sharedDispatchQueue;
+- (instancetype)initWithExecutor:(CBPExecutor *)executor workBlock:(CBPFutureWorkBlock)workBlock
+{
+    return [self initWithExecutor:executor cancellationToken:nil workBlock:workBlock];
 }
 
-- (instancetype)initWithQueue:(dispatch_queue_t)queue workBlock:(CBPFutureWorkBlock)workBlock
+- (instancetype)initWithExecutor:(CBPExecutor *)executor
+{
+    return [self initWithExecutor:executor cancellationToken:nil];
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock
 {
     if (!workBlock)
     {
@@ -59,13 +77,13 @@
     }
     else
     {
-        self = [self _initWithQueue:queue workBlock:workBlock];
+        self = [self _initWithExecutor:executor cancellationToken:cancellationToken workBlock:workBlock];
     }
 
     return self;
 }
 
-- (instancetype)initWithQueue:(dispatch_queue_t)queue
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken
 {
     if (![self respondsToSelector:@selector(main)])
     {
@@ -73,56 +91,175 @@
     }
     else
     {
-        self = [self _initWithQueue:queue workBlock:NULL];
+        self = [self _initWithExecutor:executor cancellationToken:cancellationToken workBlock:NULL];
     }
 
     return self;
 }
 
-- (instancetype)_initWithQueue:(dispatch_queue_t)queue workBlock:(CBPFutureWorkBlock)workBlock
+- (instancetype)_initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock
 {
     self = [super init];
 
     if (self)
     {
-        self.workQueue = queue;
+        self.executor = executor ? executor : [CBPExecutor defaultExecutor];
         self.workBlock = workBlock;
+        [cancellationToken registerDeref:self];
         [self start];
     }
 
     return self;
 }
 
+- (instancetype)initForSubclassWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken
+{
+    self = [super init];
+
+    if (self)
+    {
+        self.executor = executor ? executor : [CBPExecutor defaultExecutor];
+        [cancellationToken registerDeref:self];
+    }
+
+    return self;
+}
+
+- (BOOL)invalidateWithError:(NSError *)error
+{
+    BOOL invalidated = [super invalidateWithError:error];
+
+    if (invalidated)
+    {
+        atomic_store_explicit(&_canceled, YES, memory_order_relaxed);
+
+        //-------------------------------------------------------------------
+        // Claim the work so the queued block becomes a no-op, and release
+        // whatever the work block captured right away rather than when the
+        // executor finally gets to it.
+        //-------------------------------------------------------------------
+        if (!atomic_exchange_explicit(&_claimed, YES, memory_order_acq_rel))
+        {
+            [self discardWork];
+        }
+    }
+
+    return invalidated;
+}
+
+- (BOOL)isCanceled
+{
+    return atomic_load_explicit(&_canceled, memory_order_relaxed);
+}
+
 #pragma mark -
 
 - (void)start
 {
-    dispatch_block_t workBlock = ^{
-        
-        @autoreleasepool
+    //-------------------------------------------------------------------
+    // Whoever claims the future first runs the work: either the executor
+    // or a thread that derefs it before the executor gets to it. The
+    // queued block becomes a no-op in the second case.
+    //-------------------------------------------------------------------
+    if (CBPMetricsActive())
+    {
+        _startTimestamp = CBPMetricsNow();
+    }
+
+    [self.executor execute:^{
+        [self _claimAndPerformWork];
+    }];
+}
+
+- (BOOL)_claimAndPerformWork
+{
+    if (atomic_load_explicit(&_claimed, memory_order_relaxed) || atomic_exchange_explicit(&_claimed, YES, memory_order_acquire))
+    {
+        return NO;
+    }
+
+    if (CBPMetricsActive())
+    {
+        _runTimestamp = CBPMetricsNow();
+
+        if (_startTimestamp)
         {
-            id value = nil;
-            
-            if ([self respondsToSelector:@selector(main)])
-            {
-                value = [self main];
-            }
-            else
-            {
-                value = self.workBlock(^BOOL {
-
-                    return self.state == CBPDerefStateInvalid;
-
-                });
-            }
-            
-            [self assignValue:value];
+            CBPMetricsRecord(CBPMetricFutureQueueTime, _runTimestamp - _startTimestamp);
         }
-    };
-    
-    dispatch_queue_t queue = self.workQueue ? self.workQueue : [[self class] sharedDispatchQueue];
-    
-    dispatch_async(queue, workBlock);
+    }
+
+    CBPMetricsProbe(future__start, self);
+
+    @autoreleasepool
+    {
+        [self performWork];
+    }
+
+    [self _recordRunTime];
+
+    return YES;
+}
+
+- (void)_recordRunTime
+{
+    //-------------------------------------------------------------------
+    // Called by the thread performing the work just before it assigns the
+    // result, so the run time leaves out inline continuations and
+    // callbacks.
+    //-------------------------------------------------------------------
+    if (_runTimestamp)
+    {
+        CBPMetricsRecord(CBPMetricFutureRunTime, CBPMetricsNow() - _runTimestamp);
+        _runTimestamp = 0;
+    }
+}
+
+#pragma mark - CBPFutureSubclass methods
+
+- (void)performWork
+{
+    id value = nil;
+
+    if ([self respondsToSelector:@selector(main)])
+    {
+        value = [self main];
+    }
+    else
+    {
+        value = self.workBlock(^BOOL {
+
+            return atomic_load_explicit(&self->_canceled, memory_order_relaxed);
+
+        });
+    }
+
+    [self assignValue:value];
+}
+
+- (void)discardWork
+{
+    self.workBlock = nil;
+}
+
+#pragma mark - CBPDerefSubclass methods
+
+- (BOOL)assignValue:(id)value
+{
+    [self _recordRunTime];
+
+    return [super assignValue:value];
+}
+
+- (BOOL)assignValueUsingBlock:(dispatch_block_t)storeBlock
+{
+    [self _recordRunTime];
+
+    return [super assignValueUsingBlock:storeBlock];
+}
+
+- (BOOL)performWorkWhileWaiting
+{
+    return self.executor.allowsInlineExecution && [self _claimAndPerformWork];
 }
 
 @end
@@ -0,0 +1,108 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import "CBPFuture.h"
+
+@class CBPExecutor;
+
+/**
+ *  A concurrent, single-flight cache of futures. The first caller to ask for a key starts its work; every caller that
+ *  asks for the key while that work is running, or after it has completed, gets the same deref. Futures that are
+ *  invalidated are removed so the next caller starts over.
+ *
+ *  Keys are spread over independently locked shards, and a hit only takes its shard's lock for reading. When a count
+ *  limit is set, each shard evicts with the CLOCK algorithm, an approximation of least recently used that only has to
+ *  set a flag on a hit.
+ */
+@interface CBPFutureCache : NSObject
+
+/**
+ *  Initializes an unbounded cache whose entries never expire, running work on the default executor.
+ *
+ *  @return An initialized cache.
+ */
+- (instancetype)init;
+
+/**
+ *  Initializes a cache.
+ *
+ *  @param countLimit The maximum number of entries, or 0 for no limit. The limit is divided evenly between shards, so a shard may begin evicting slightly before the cache as a whole is full.
+ *  @param timeToLive The number of seconds an entry remains usable after its future is realized, or 0 to keep entries until they are evicted.
+ *  @param executor   The executor on which to perform work blocks. If nil, the default executor is used.
+ *
+ *  @return An initialized cache.
+ */
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit timeToLive:(NSTimeInterval)timeToLive executor:(CBPExecutor *)executor;
+
+/**
+ *  Returns the deref cached for @p key, starting a future with @p workBlock if there is none.
+ *
+ *  @param key       The key. It is copied.
+ *  @param workBlock The work to perform on a miss. This value must not be nil or an exception will be thrown.
+ *
+ *  @return A deref for the value of @p key.
+ */
+- (CBPDeref *)derefForKey:(id<NSCopying>)key workBlock:(CBPFutureWorkBlock)workBlock;
+
+/**
+ *  Returns the deref cached for @p key without starting any work, or nil.
+ */
+- (CBPDeref *)cachedDerefForKey:(id<NSCopying>)key;
+
+/**
+ *  Removes the entry for @p key. Callers already holding its deref are unaffected.
+ */
+- (void)removeDerefForKey:(id<NSCopying>)key;
+
+- (void)removeAllDerefs;
+
+/**
+ *  The number of entries, including those whose futures are still running.
+ */
+@property (readonly) NSUInteger count;
+
+#pragma mark - Statistics
+
+/**
+ *  The number of lookups that returned a realized deref.
+ */
+@property (readonly) uint64_t hitCount;
+
+/**
+ *  The number of lookups that started a new future.
+ */
+@property (readonly) uint64_t missCount;
+
+/**
+ *  The number of lookups that joined a future that was still running.
+ */
+@property (readonly) uint64_t coalescedCount;
+
+/**
+ *  The number of entries removed to stay under the count limit or because they expired.
+ */
+@property (readonly) uint64_t evictionCount;
+
+@end
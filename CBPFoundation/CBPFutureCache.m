@@ -0,0 +1,511 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPFutureCache.h"
+#import "CBPDerefSubclass.h"
+#import "CBPExecutor.h"
+#import <pthread.h>
+#import "CBPTime.h"
+#import <stdatomic.h>
+
+#define CBPFutureCacheMaximumShardCount 64
+
+@interface CBPFutureCacheEntry : NSObject
+
+- (instancetype)initWithKey:(id)key future:(CBPFuture *)future;
+
+@property (nonatomic, readonly) id key;
+
+@property (nonatomic, readonly) CBPFuture *future;
+
+/**
+ *  The entry's index in its shard's clock. Only accessed with the shard's lock held for writing.
+ */
+@property (nonatomic) NSUInteger slot;
+
+- (void)markReferenced;
+
+/**
+ *  Clears the referenced flag.
+ *
+ *  @return The previous value of the flag.
+ */
+- (BOOL)clearReferenced;
+
+- (void)expireAfterInterval:(NSTimeInterval)interval;
+
+- (BOOL)isUsableAtTime:(uint64_t)now;
+
+@end
+
+#pragma mark -
+
+@interface CBPFutureCacheShard : NSObject
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ *  Returns a usable entry for @p key, taking the lock only for reading.
+ */
+- (CBPFutureCacheEntry *)usableEntryForKey:(id)key;
+
+/**
+ *  Returns a usable entry for @p key, inserting the entry returned by @p create if there is none.
+ *
+ *  @param created Set to YES if the entry was created.
+ */
+- (CBPFutureCacheEntry *)entryForKey:(id)key creatingWithBlock:(CBPFutureCacheEntry *(^)(void))create created:(BOOL *)created;
+
+/**
+ *  Removes @p entry if it is still the entry for its key.
+ */
+- (void)removeEntry:(CBPFutureCacheEntry *)entry;
+
+- (void)removeEntryForKey:(id)key;
+
+- (void)removeAllEntries;
+
+- (NSUInteger)count;
+
+- (uint64_t)evictionCount;
+
+@end
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPFutureCache
+{
+    NSArray *_shards;
+    NSUInteger _shardMask;
+    NSTimeInterval _timeToLive;
+    CBPExecutor *_executor;
+    _Atomic(uint64_t) _hitCount;
+    _Atomic(uint64_t) _missCount;
+    _Atomic(uint64_t) _coalescedCount;
+}
+
+- (instancetype)init
+{
+    return [self initWithCountLimit:0 timeToLive:0 executor:nil];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit timeToLive:(NSTimeInterval)timeToLive executor:(CBPExecutor *)executor
+{
+    self = [super init];
+
+    if (self)
+    {
+        NSUInteger shardCount = 1;
+
+        while (shardCount < CBPFutureCacheMaximumShardCount && shardCount < [[NSProcessInfo processInfo] activeProcessorCount] * 2)
+        {
+            shardCount <<= 1;
+        }
+
+        while (countLimit && shardCount > countLimit)
+        {
+            shardCount >>= 1;
+        }
+
+        NSUInteger capacity = countLimit ? (countLimit + shardCount - 1) / shardCount : 0;
+        NSMutableArray *shards = [NSMutableArray arrayWithCapacity:shardCount];
+
+        for (NSUInteger i = 0; i < shardCount; i++)
+        {
+            [shards addObject:[[CBPFutureCacheShard alloc] initWithCapacity:capacity]];
+        }
+
+        _shards = [shards copy];
+        _shardMask = shardCount - 1;
+        _timeToLive = timeToLive;
+        _executor = executor;
+        atomic_init(&_hitCount, 0);
+        atomic_init(&_missCount, 0);
+        atomic_init(&_coalescedCount, 0);
+    }
+
+    return self;
+}
+
+- (CBPFutureCacheShard *)shardForKey:(id)key
+{
+    //-------------------------------------------------------------------
+    // Plenty of -hash implementations leave the low bits poorly mixed, so
+    // take the shard from the top of a Fibonacci hash instead.
+    //-------------------------------------------------------------------
+    uint64_t hash = (uint64_t)[key hash] * 0x9E3779B97F4A7C15ull;
+
+    return _shards[(NSUInteger)(hash >> 32) & _shardMask];
+}
+
+- (CBPDeref *)derefForKey:(id<NSCopying>)key workBlock:(CBPFutureWorkBlock)workBlock
+{
+    if (!workBlock)
+    {
+        [NSException raise:NSInternalInconsistencyException format:@"workBlock must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    CBPFutureCacheShard *shard = [self shardForKey:key];
+    CBPFutureCacheEntry *entry = [shard usableEntryForKey:key];
+    BOOL created = NO;
+
+    if (!entry)
+    {
+        CBPExecutor *executor = _executor;
+        id copiedKey = [(id)key copy];
+
+        entry = [shard entryForKey:copiedKey creatingWithBlock:^CBPFutureCacheEntry *{
+
+            return [[CBPFutureCacheEntry alloc] initWithKey:copiedKey future:[[CBPFuture alloc] initWithExecutor:executor workBlock:workBlock]];
+
+        } created:&created];
+    }
+
+    if (!created)
+    {
+        atomic_fetch_add_explicit([entry.future isRealized] ? &_hitCount : &_coalescedCount, 1, memory_order_relaxed);
+        return entry.future;
+    }
+
+    atomic_fetch_add_explicit(&_missCount, 1, memory_order_relaxed);
+
+    //-------------------------------------------------------------------
+    // Attached outside the shard's lock: if the future has already been
+    // realized, the continuation runs right here and may need the lock.
+    //-------------------------------------------------------------------
+    __weak CBPFutureCacheShard *weakShard = shard;
+    __weak CBPFutureCacheEntry *weakEntry = entry;
+    NSTimeInterval timeToLive = _timeToLive;
+
+    [entry.future addContinuation:^(CBPDerefState state, id value, NSError *error) {
+
+        CBPFutureCacheEntry *realizedEntry = weakEntry;
+
+        if (!realizedEntry)
+        {
+            return;
+        }
+
+        if (state == CBPDerefStateInvalid)
+        {
+            [weakShard removeEntry:realizedEntry];
+        }
+        else if (timeToLive > 0)
+        {
+            [realizedEntry expireAfterInterval:timeToLive];
+        }
+
+    } queue:nil];
+
+    return entry.future;
+}
+
+- (CBPDeref *)cachedDerefForKey:(id<NSCopying>)key
+{
+    return [[self shardForKey:key] usableEntryForKey:key].future;
+}
+
+- (void)removeDerefForKey:(id<NSCopying>)key
+{
+    [[self shardForKey:key] removeEntryForKey:key];
+}
+
+- (void)removeAllDerefs
+{
+    for (CBPFutureCacheShard *shard in _shards)
+    {
+        [shard removeAllEntries];
+    }
+}
+
+- (NSUInteger)count
+{
+    NSUInteger count = 0;
+
+    for (CBPFutureCacheShard *shard in _shards)
+    {
+        count += [shard count];
+    }
+
+    return count;
+}
+
+- (uint64_t)hitCount
+{
+    return atomic_load_explicit(&_hitCount, memory_order_relaxed);
+}
+
+- (uint64_t)missCount
+{
+    return atomic_load_explicit(&_missCount, memory_order_relaxed);
+}
+
+- (uint64_t)coalescedCount
+{
+    return atomic_load_explicit(&_coalescedCount, memory_order_relaxed);
+}
+
+- (uint64_t)evictionCount
+{
+    uint64_t evictionCount = 0;
+
+    for (CBPFutureCacheShard *shard in _shards)
+    {
+        evictionCount += [shard evictionCount];
+    }
+
+    return evictionCount;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPFutureCacheEntry
+{
+    _Atomic(BOOL) _referenced;
+    _Atomic(uint64_t) _expiration;
+}
+
+- (instancetype)initWithKey:(id)key future:(CBPFuture *)future
+{
+    self = [super init];
+
+    if (self)
+    {
+        _key = key;
+        _future = future;
+        atomic_init(&_referenced, YES);
+        atomic_init(&_expiration, 0);
+    }
+
+    return self;
+}
+
+- (void)markReferenced
+{
+    //-------------------------------------------------------------------
+    // Skip the store when the flag is already set so hot entries don't
+    // bounce their cache line between readers.
+    //-------------------------------------------------------------------
+    if (!atomic_load_explicit(&_referenced, memory_order_relaxed))
+    {
+        atomic_store_explicit(&_referenced, YES, memory_order_relaxed);
+    }
+}
+
+- (BOOL)clearReferenced
+{
+    return atomic_exchange_explicit(&_referenced, NO, memory_order_relaxed);
+}
+
+- (void)expireAfterInterval:(NSTimeInterval)interval
+{
+    atomic_store_explicit(&_expiration, CBPMonotonicNanoseconds() + (uint64_t)(interval * NSEC_PER_SEC), memory_order_relaxed);
+}
+
+- (BOOL)isUsableAtTime:(uint64_t)now
+{
+    uint64_t expiration = atomic_load_explicit(&_expiration, memory_order_relaxed);
+
+    return (!expiration || now < expiration) && [self.future state] != CBPDerefStateInvalid;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPFutureCacheShard
+{
+    pthread_rwlock_t _lock;
+    NSMutableDictionary *_entries;
+    NSMutableArray *_clock;
+    NSUInteger _hand;
+    NSUInteger _capacity;
+    _Atomic(uint64_t) _evictionCount;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+    self = [super init];
+
+    if (self)
+    {
+        pthread_rwlock_init(&_lock, NULL);
+        _entries = [NSMutableDictionary dictionary];
+        _clock = [NSMutableArray array];
+        _capacity = capacity;
+        atomic_init(&_evictionCount, 0);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_rwlock_destroy(&_lock);
+}
+
+- (CBPFutureCacheEntry *)usableEntryForKey:(id)key
+{
+    pthread_rwlock_rdlock(&_lock);
+    CBPFutureCacheEntry *entry = _entries[key];
+    pthread_rwlock_unlock(&_lock);
+
+    if (![entry isUsableAtTime:CBPMonotonicNanoseconds()])
+    {
+        return nil;
+    }
+
+    [entry markReferenced];
+
+    return entry;
+}
+
+- (CBPFutureCacheEntry *)entryForKey:(id)key creatingWithBlock:(CBPFutureCacheEntry *(^)(void))create created:(BOOL *)created
+{
+    pthread_rwlock_wrlock(&_lock);
+
+    CBPFutureCacheEntry *entry = _entries[key];
+
+    if (entry && ![entry isUsableAtTime:CBPMonotonicNanoseconds()])
+    {
+        if ([entry.future state] != CBPDerefStateInvalid)
+        {
+            atomic_fetch_add_explicit(&_evictionCount, 1, memory_order_relaxed);
+        }
+
+        [self _removeEntry:entry];
+        entry = nil;
+    }
+
+    if (entry)
+    {
+        [entry markReferenced];
+    }
+    else
+    {
+        [self _evictIfFull];
+
+        entry = create();
+        entry.slot = [_clock count];
+        [_clock addObject:entry];
+        _entries[key] = entry;
+        *created = YES;
+    }
+
+    pthread_rwlock_unlock(&_lock);
+
+    return entry;
+}
+
+- (void)removeEntry:(CBPFutureCacheEntry *)entry
+{
+    pthread_rwlock_wrlock(&_lock);
+
+    if (_entries[entry.key] == entry)
+    {
+        [self _removeEntry:entry];
+    }
+
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeEntryForKey:(id)key
+{
+    pthread_rwlock_wrlock(&_lock);
+
+    CBPFutureCacheEntry *entry = _entries[key];
+
+    if (entry)
+    {
+        [self _removeEntry:entry];
+    }
+
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeAllEntries
+{
+    pthread_rwlock_wrlock(&_lock);
+    [_entries removeAllObjects];
+    [_clock removeAllObjects];
+    _hand = 0;
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (NSUInteger)count
+{
+    pthread_rwlock_rdlock(&_lock);
+    NSUInteger count = [_entries count];
+    pthread_rwlock_unlock(&_lock);
+
+    return count;
+}
+
+- (uint64_t)evictionCount
+{
+    return atomic_load_explicit(&_evictionCount, memory_order_relaxed);
+}
+
+#pragma mark - Must hold the lock for writing
+
+/**
+ *  Sweeps the clock hand forward, giving each referenced entry a second chance, until it finds one to evict.
+ */
+- (void)_evictIfFull
+{
+    while (_capacity && [_clock count] >= _capacity)
+    {
+        _hand %= [_clock count];
+        CBPFutureCacheEntry *entry = _clock[_hand];
+
+        if ([entry clearReferenced])
+        {
+            _hand++;
+        }
+        else
+        {
+            [self _removeEntry:entry];
+            atomic_fetch_add_explicit(&_evictionCount, 1, memory_order_relaxed);
+        }
+    }
+}
+
+- (void)_removeEntry:(CBPFutureCacheEntry *)entry
+{
+    //-------------------------------------------------------------------
+    // Move the last entry into the hole so removal doesn't shift the
+    // whole clock.
+    //-------------------------------------------------------------------
+    NSUInteger slot = entry.slot;
+    CBPFutureCacheEntry *last = [_clock lastObject];
+
+    _clock[slot] = last;
+    last.slot = slot;
+    [_clock removeLastObject];
+    [_entries removeObjectForKey:entry.key];
+}
+
+@end
@@ -0,0 +1,55 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPFuture.h"
+#import "CBPDerefSubclass.h"
+
+@interface CBPFuture ()
+
+/**
+ *  Initializes a future that has neither a work block nor @p -main, for subclasses that store their result inline. The future is not started; call @p -start once the subclass is ready for @p -performWork to be called, possibly before @p -start returns.
+ *
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used.
+ *  @param cancellationToken A token that invalidates the future when cancelled. May be nil.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initForSubclassWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken;
+
+/**
+ *  Submits the future's work to its executor.
+ */
+- (void)start;
+
+/**
+ *  Performs the work and realizes the future with its result. Called at most once, by whichever thread claims the work. The default implementation performs @p -main or the work block and calls @p -assignValue:.
+ */
+- (void)performWork;
+
+/**
+ *  Called instead of @p -performWork when the future is invalidated before its work is claimed, so that whatever the work captured can be released right away. The default implementation releases the work block.
+ */
+- (void)discardWork;
+
+@end
@@ -0,0 +1,88 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  Sends one message, or reads one key, to many objects while only looking up the method once per class.
+ *
+ *  A small inline cache keyed on the receiver's class remembers the last few classes seen along with their implementation, so homogeneous collections pay for one method lookup in total and mixed collections fall back to a lookup per new class. Scalar return values are boxed in an NSNumber. Instances are not thread safe.
+ */
+@interface CBPMethodCache : NSObject
+
+/**
+ *  Initializes a cache that sends @p selector, which must take no arguments.
+ *
+ *  @param selector The selector to send.
+ *
+ *  @return An initialized cache.
+ */
+- (instancetype)initWithSelector:(SEL)selector;
+
+/**
+ *  Initializes a cache that reads @p key using the same accessor search as @p -valueForKey:. Classes that customize @p -valueForKey:, such as collections, and classes with no matching accessor, use @p -valueForKey: itself.
+ *
+ *  @param key The key to read.
+ *
+ *  @return An initialized cache.
+ */
+- (instancetype)initWithKey:(NSString *)key;
+
+/**
+ *  Sends the message to @p object, or reads the key from it.
+ *
+ *  @param object The receiver.
+ *
+ *  @return The result, boxed if it is a scalar.
+ */
+- (id)valueForObject:(id)object;
+
+@end
+
+#pragma mark -
+
+/**
+ *  A key path compiled into a chain of method caches, for reading the same key path from many objects.
+ */
+@interface CBPCompiledKeyPath : NSObject
+
+/**
+ *  Initializes a compiled key path. Key paths containing collection operators are evaluated with @p -valueForKeyPath:.
+ *
+ *  @param keyPath A dotted key path.
+ *
+ *  @return An initialized compiled key path.
+ */
+- (instancetype)initWithKeyPath:(NSString *)keyPath;
+
+/**
+ *  Reads the key path from @p object.
+ *
+ *  @param object The object to read from.
+ *
+ *  @return The value, or nil if any key along the path was nil.
+ */
+- (id)valueForObject:(id)object;
+
+@end
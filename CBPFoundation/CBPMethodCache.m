@@ -0,0 +1,337 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPMethodCache.h"
+#import <objc/runtime.h>
+
+typedef NS_ENUM(uint8_t, CBPMethodCacheReturnType)
+{
+    CBPMethodCacheReturnTypeObject,
+    CBPMethodCacheReturnTypeChar,
+    CBPMethodCacheReturnTypeUnsignedChar,
+    CBPMethodCacheReturnTypeShort,
+    CBPMethodCacheReturnTypeUnsignedShort,
+    CBPMethodCacheReturnTypeInt,
+    CBPMethodCacheReturnTypeUnsignedInt,
+    CBPMethodCacheReturnTypeLong,
+    CBPMethodCacheReturnTypeUnsignedLong,
+    CBPMethodCacheReturnTypeLongLong,
+    CBPMethodCacheReturnTypeUnsignedLongLong,
+    CBPMethodCacheReturnTypeFloat,
+    CBPMethodCacheReturnTypeDouble,
+    CBPMethodCacheReturnTypeBool,
+    CBPMethodCacheReturnTypeUnsupported,
+    CBPMethodCacheReturnTypeKeyValueCoding,
+};
+
+typedef struct CBPMethodCacheEntry
+{
+    __unsafe_unretained Class cls;
+    SEL selector;
+    IMP imp;
+    CBPMethodCacheReturnType returnType;
+} CBPMethodCacheEntry;
+
+/*
+ *  Enough to cover a class cluster's handful of private subclasses without making misses expensive to scan.
+ */
+#define CBPMethodCacheEntryCount 4
+
+static CBPMethodCacheReturnType CBPMethodCacheReturnTypeForMethod(Method method)
+{
+    char returnType[64];
+    method_getReturnType(method, returnType, sizeof(returnType));
+
+    //-------------------------------------------------------------------
+    // Skip type qualifiers such as const and oneway.
+    //-------------------------------------------------------------------
+    const char *type = returnType;
+
+    while (*type && strchr("rnNoORV", *type))
+    {
+        type++;
+    }
+
+    switch (*type)
+    {
+        case '@':
+        case '#':
+            return CBPMethodCacheReturnTypeObject;
+        case 'c':
+            return CBPMethodCacheReturnTypeChar;
+        case 'C':
+            return CBPMethodCacheReturnTypeUnsignedChar;
+        case 's':
+            return CBPMethodCacheReturnTypeShort;
+        case 'S':
+            return CBPMethodCacheReturnTypeUnsignedShort;
+        case 'i':
+            return CBPMethodCacheReturnTypeInt;
+        case 'I':
+            return CBPMethodCacheReturnTypeUnsignedInt;
+        case 'l':
+            return CBPMethodCacheReturnTypeLong;
+        case 'L':
+            return CBPMethodCacheReturnTypeUnsignedLong;
+        case 'q':
+            return CBPMethodCacheReturnTypeLongLong;
+        case 'Q':
+            return CBPMethodCacheReturnTypeUnsignedLongLong;
+        case 'f':
+            return CBPMethodCacheReturnTypeFloat;
+        case 'd':
+            return CBPMethodCacheReturnTypeDouble;
+        case 'B':
+            return CBPMethodCacheReturnTypeBool;
+        default:
+            return CBPMethodCacheReturnTypeUnsupported;
+    }
+}
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPMethodCache
+{
+    SEL _selector;
+    NSString *_key;
+    CBPMethodCacheEntry _entries[CBPMethodCacheEntryCount];
+    NSUInteger _nextEntry;
+}
+
+- (instancetype)initWithSelector:(SEL)selector
+{
+    self = [super init];
+
+    if (self)
+    {
+        _selector = selector;
+    }
+
+    return self;
+}
+
+- (instancetype)initWithKey:(NSString *)key
+{
+    self = [super init];
+
+    if (self)
+    {
+        _key = [key copy];
+    }
+
+    return self;
+}
+
+- (id)valueForObject:(id)object
+{
+    if (!object)
+    {
+        return nil;
+    }
+
+    Class cls = object_getClass(object);
+    CBPMethodCacheEntry *entry = NULL;
+
+    for (NSUInteger i = 0; i < CBPMethodCacheEntryCount; i++)
+    {
+        if (_entries[i].cls == cls)
+        {
+            entry = &_entries[i];
+            break;
+        }
+    }
+
+    if (!entry)
+    {
+        entry = [self _fillEntryForClass:cls];
+    }
+
+    IMP imp = entry->imp;
+    SEL selector = entry->selector;
+
+    switch (entry->returnType)
+    {
+        case CBPMethodCacheReturnTypeObject:
+            return ((id (*)(id, SEL))imp)(object, selector);
+        case CBPMethodCacheReturnTypeChar:
+            return @(((char (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeUnsignedChar:
+            return @(((unsigned char (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeShort:
+            return @(((short (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeUnsignedShort:
+            return @(((unsigned short (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeInt:
+            return @(((int (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeUnsignedInt:
+            return @(((unsigned int (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeLong:
+            return @(((long (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeUnsignedLong:
+            return @(((unsigned long (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeLongLong:
+            return @(((long long (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeUnsignedLongLong:
+            return @(((unsigned long long (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeFloat:
+            return @(((float (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeDouble:
+            return @(((double (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeBool:
+            return @(((bool (*)(id, SEL))imp)(object, selector));
+        case CBPMethodCacheReturnTypeKeyValueCoding:
+            return [object valueForKey:_key];
+        case CBPMethodCacheReturnTypeUnsupported:
+            [NSException raise:NSInvalidArgumentException format:@"-[%@ %@] has an unsupported return type. %s", NSStringFromClass(cls), NSStringFromSelector(selector), __PRETTY_FUNCTION__];
+            break;
+    }
+
+    return nil;
+}
+
+#pragma mark -
+
+- (CBPMethodCacheEntry *)_fillEntryForClass:(Class)cls
+{
+    CBPMethodCacheEntry *entry = &_entries[_nextEntry];
+    _nextEntry = (_nextEntry + 1) % CBPMethodCacheEntryCount;
+
+    entry->cls = cls;
+    entry->selector = _selector;
+    entry->returnType = CBPMethodCacheReturnTypeKeyValueCoding;
+
+    if (_key)
+    {
+        entry->selector = [self _getterForClass:cls];
+    }
+
+    if (entry->selector)
+    {
+        //-------------------------------------------------------------------
+        // A class that doesn't implement the selector gets the forwarding
+        // IMP, which raises or forwards exactly as a normal send would.
+        //-------------------------------------------------------------------
+        Method method = class_getInstanceMethod(cls, entry->selector);
+        entry->imp = class_getMethodImplementation(cls, entry->selector);
+        entry->returnType = method ? CBPMethodCacheReturnTypeForMethod(method) : CBPMethodCacheReturnTypeObject;
+
+        if (_key && entry->returnType == CBPMethodCacheReturnTypeUnsupported)
+        {
+            entry->returnType = CBPMethodCacheReturnTypeKeyValueCoding;
+        }
+    }
+
+    return entry;
+}
+
+- (SEL)_getterForClass:(Class)cls
+{
+    //-------------------------------------------------------------------
+    // Classes that customize -valueForKey: may not map keys to accessors
+    // at all (dictionaries, collections, managed objects), so leave them
+    // to it.
+    //-------------------------------------------------------------------
+    static IMP defaultValueForKey = NULL;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultValueForKey = class_getMethodImplementation([NSObject class], @selector(valueForKey:));
+    });
+
+    if (class_getMethodImplementation(cls, @selector(valueForKey:)) != defaultValueForKey || ![_key length])
+    {
+        return NULL;
+    }
+
+    NSString *capitalizedKey = [[[_key substringToIndex:1] uppercaseString] stringByAppendingString:[_key substringFromIndex:1]];
+    NSArray *getters = @[[@"get" stringByAppendingString:capitalizedKey], _key, [@"is" stringByAppendingString:capitalizedKey], [@"_" stringByAppendingString:_key]];
+
+    for (NSString *getter in getters)
+    {
+        SEL selector = NSSelectorFromString(getter);
+
+        if (class_respondsToSelector(cls, selector))
+        {
+            return selector;
+        }
+    }
+
+    return NULL;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPCompiledKeyPath
+{
+    NSString *_keyPath;
+    NSArray *_caches;
+}
+
+- (instancetype)initWithKeyPath:(NSString *)keyPath
+{
+    self = [super init];
+
+    if (self)
+    {
+        _keyPath = [keyPath copy];
+
+        if ([keyPath rangeOfString:@"@"].location == NSNotFound)
+        {
+            NSMutableArray *caches = [NSMutableArray array];
+
+            for (NSString *key in [keyPath componentsSeparatedByString:@"."])
+            {
+                [caches addObject:[[CBPMethodCache alloc] initWithKey:key]];
+            }
+
+            _caches = [caches copy];
+        }
+    }
+
+    return self;
+}
+
+- (id)valueForObject:(id)object
+{
+    if (!_caches)
+    {
+        return [object valueForKeyPath:_keyPath];
+    }
+
+    for (CBPMethodCache *cache in _caches)
+    {
+        if (!object)
+        {
+            break;
+        }
+
+        object = [cache valueForObject:object];
+    }
+
+    return object;
+}
+
+@end
@@ -0,0 +1,120 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  The intervals CBPMetrics records. Every interval is measured in nanoseconds.
+ */
+typedef NS_ENUM(NSUInteger, CBPMetric)
+{
+    /**
+     *  How long a CBPFuture waited between being started and its work beginning.
+     */
+    CBPMetricFutureQueueTime,
+
+    /**
+     *  How long a CBPFuture's work ran, up to the moment its result was assigned. Continuations and callbacks that run inline are not included.
+     */
+    CBPMetricFutureRunTime,
+
+    /**
+     *  How long a thread was blocked in @p -deref or @p -derefWithTimeoutInterval:timeoutValue:. Calls that find the deref already realized are not recorded.
+     */
+    CBPMetricDerefBlockTime,
+
+    /**
+     *  How old a CBPPromise was when it timed out. The count is the number of timeouts.
+     */
+    CBPMetricPromiseTimeout,
+
+    /**
+     *  How long a success or invalid block waited on its callback queue after the deref was realized.
+     */
+    CBPMetricCallbackDelay,
+};
+
+/**
+ *  Turns recording on or off for the whole process. Recording is off by default, and while it is off each place that would record costs a single branch.
+ *
+ *  Independently of recording, CBPDeref, CBPFuture and CBPPromise fire USDT probes in the @p cbpfoundation provider on Linux when <sys/sdt.h> is available: @p deref__create, @p deref__block, @p deref__wake, @p deref__realize, @p deref__invalidate and @p future__start, each with the object's address as its argument. The probes are defined with <sys/sdt.h> directly rather than from a provider file, so tools such as bpftrace see those names as written, double underscores included (e.g. @p usdt:/path/to/binary:cbpfoundation:deref__block). A probe nobody is tracing is a single no-op instruction.
+ *
+ *  @param enabled YES to record.
+ */
+extern void CBPMetricsSetEnabled(BOOL enabled);
+
+/**
+ *  Returns YES if recording is on.
+ */
+extern BOOL CBPMetricsIsEnabled(void);
+
+/**
+ *  A point-in-time copy of every thread's histograms, merged.
+ *
+ *  Each thread records into its own histograms without locks or read-modify-write instructions, and taking a snapshot only reads them, so snapshots are cheap enough to take periodically. Buckets are log-linear with 16 sub-buckets per power of two, so reported values are within about 6% of the recorded ones.
+ */
+@interface CBPMetricsSnapshot : NSObject
+
+/**
+ *  Takes a snapshot of everything recorded so far.
+ *
+ *  @return A new snapshot.
+ */
++ (instancetype)snapshot;
+
+/**
+ *  Returns what was recorded between @p snapshot and the receiver.
+ *
+ *  @param snapshot An earlier snapshot.
+ *
+ *  @return A snapshot of the difference. Its maximums are the receiver's, since they cannot be subtracted.
+ */
+- (CBPMetricsSnapshot *)snapshotBySubtractingSnapshot:(CBPMetricsSnapshot *)snapshot;
+
+/**
+ *  Returns the number of intervals recorded for @p metric.
+ */
+- (uint64_t)countForMetric:(CBPMetric)metric;
+
+/**
+ *  Returns the mean of the intervals recorded for @p metric, or 0.
+ */
+- (double)meanForMetric:(CBPMetric)metric;
+
+/**
+ *  Returns the longest interval recorded for @p metric, or 0.
+ */
+- (uint64_t)maximumForMetric:(CBPMetric)metric;
+
+/**
+ *  Returns the interval that @p percentile percent of the intervals recorded for @p metric are no longer than.
+ *
+ *  @param percentile A percentile between 0 and 100, such as 99.9.
+ *  @param metric     The metric.
+ *
+ *  @return The interval, or 0 if nothing was recorded.
+ */
+- (uint64_t)valueAtPercentile:(double)percentile forMetric:(CBPMetric)metric;
+
+@end
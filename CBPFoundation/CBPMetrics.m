@@ -0,0 +1,279 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPMetricsRecording.h"
+#import <pthread.h>
+
+#define CBPMetricCount (CBPMetricCallbackDelay + 1)
+
+/*
+ *  Values below 16 get a bucket each; above that, every power of two is split into 16 linear sub-buckets. Intervals
+ *  past 2^48 nanoseconds, about three days, share the last bucket.
+ */
+#define CBPMetricsSubBucketBits 4
+#define CBPMetricsSubBucketCount (1 << CBPMetricsSubBucketBits)
+#define CBPMetricsMaximumExponent 47
+#define CBPMetricsBucketCount ((CBPMetricsMaximumExponent - CBPMetricsSubBucketBits + 2) * CBPMetricsSubBucketCount)
+
+_Atomic(BOOL) CBPMetricsEnabledFlag = NO;
+
+/*
+ *  One thread's histograms. Only the owning thread writes to them, with plain relaxed stores, so recording needs no
+ *  read-modify-write instructions; snapshots read them with relaxed loads. Histograms are never freed: when a thread
+ *  exits its histograms are disowned, and the next thread to record adopts them, counts and all.
+ */
+typedef struct CBPMetricsHistograms
+{
+    struct CBPMetricsHistograms *next;
+    _Atomic(BOOL) owned;
+    _Atomic(uint64_t) sums[CBPMetricCount];
+    _Atomic(uint64_t) maximums[CBPMetricCount];
+    _Atomic(uint64_t) counts[CBPMetricCount][CBPMetricsBucketCount];
+} CBPMetricsHistograms;
+
+static _Atomic(CBPMetricsHistograms *) CBPMetricsAllHistograms = NULL;
+
+static void CBPMetricsDisownHistograms(void *histograms)
+{
+    atomic_store_explicit(&((CBPMetricsHistograms *)histograms)->owned, NO, memory_order_release);
+}
+
+static pthread_key_t CBPMetricsHistogramsKey(void)
+{
+    static pthread_key_t histogramsKey;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&histogramsKey, CBPMetricsDisownHistograms);
+    });
+
+    return histogramsKey;
+}
+
+static CBPMetricsHistograms *CBPMetricsCurrentHistograms(void)
+{
+    pthread_key_t key = CBPMetricsHistogramsKey();
+    CBPMetricsHistograms *histograms = pthread_getspecific(key);
+
+    if (histograms)
+    {
+        return histograms;
+    }
+
+    for (histograms = atomic_load_explicit(&CBPMetricsAllHistograms, memory_order_acquire); histograms; histograms = histograms->next)
+    {
+        BOOL owned = NO;
+
+        if (atomic_compare_exchange_strong_explicit(&histograms->owned, &owned, YES, memory_order_acquire, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (!histograms)
+    {
+        histograms = calloc(1, sizeof(CBPMetricsHistograms));
+        atomic_init(&histograms->owned, YES);
+
+        CBPMetricsHistograms *head = atomic_load_explicit(&CBPMetricsAllHistograms, memory_order_relaxed);
+
+        do
+        {
+            histograms->next = head;
+        }
+        while (!atomic_compare_exchange_weak_explicit(&CBPMetricsAllHistograms, &head, histograms, memory_order_release, memory_order_relaxed));
+    }
+
+    pthread_setspecific(key, histograms);
+
+    return histograms;
+}
+
+static NSUInteger CBPMetricsBucketIndex(uint64_t value)
+{
+    if (value < CBPMetricsSubBucketCount)
+    {
+        return (NSUInteger)value;
+    }
+
+    NSUInteger exponent = 63 - (NSUInteger)__builtin_clzll(value);
+
+    if (exponent > CBPMetricsMaximumExponent)
+    {
+        return CBPMetricsBucketCount - 1;
+    }
+
+    NSUInteger shift = exponent - CBPMetricsSubBucketBits;
+
+    return (shift + 1) * CBPMetricsSubBucketCount + (NSUInteger)((value >> shift) & (CBPMetricsSubBucketCount - 1));
+}
+
+/*
+ *  The largest value that falls into a bucket.
+ */
+static uint64_t CBPMetricsBucketValue(NSUInteger index)
+{
+    if (index < CBPMetricsSubBucketCount)
+    {
+        return index;
+    }
+
+    NSUInteger shift = index / CBPMetricsSubBucketCount - 1;
+    uint64_t lowest = (uint64_t)(CBPMetricsSubBucketCount + index % CBPMetricsSubBucketCount) << shift;
+
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+NS_INLINE void CBPMetricsStore(_Atomic(uint64_t) *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+NS_INLINE uint64_t CBPMetricsLoad(_Atomic(uint64_t) *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void CBPMetricsSetEnabled(BOOL enabled)
+{
+    atomic_store_explicit(&CBPMetricsEnabledFlag, enabled, memory_order_relaxed);
+}
+
+BOOL CBPMetricsIsEnabled(void)
+{
+    return atomic_load_explicit(&CBPMetricsEnabledFlag, memory_order_relaxed);
+}
+
+void CBPMetricsRecord(CBPMetric metric, uint64_t nanoseconds)
+{
+    CBPMetricsHistograms *histograms = CBPMetricsCurrentHistograms();
+    _Atomic(uint64_t) *count = &histograms->counts[metric][CBPMetricsBucketIndex(nanoseconds)];
+
+    CBPMetricsStore(count, CBPMetricsLoad(count) + 1);
+    CBPMetricsStore(&histograms->sums[metric], CBPMetricsLoad(&histograms->sums[metric]) + nanoseconds);
+
+    if (nanoseconds > CBPMetricsLoad(&histograms->maximums[metric]))
+    {
+        CBPMetricsStore(&histograms->maximums[metric], nanoseconds);
+    }
+}
+
+#pragma mark -
+
+@interface CBPMetricsSnapshot ()
+{
+    uint64_t _sums[CBPMetricCount];
+    uint64_t _maximums[CBPMetricCount];
+    uint64_t _totals[CBPMetricCount];
+    uint64_t _counts[CBPMetricCount][CBPMetricsBucketCount];
+}
+
+@end
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPMetricsSnapshot
+
++ (instancetype)snapshot
+{
+    CBPMetricsSnapshot *snapshot = [[self alloc] init];
+
+    for (CBPMetricsHistograms *histograms = atomic_load_explicit(&CBPMetricsAllHistograms, memory_order_acquire); histograms; histograms = histograms->next)
+    {
+        for (NSUInteger metric = 0; metric < CBPMetricCount; metric++)
+        {
+            snapshot->_sums[metric] += CBPMetricsLoad(&histograms->sums[metric]);
+            snapshot->_maximums[metric] = MAX(snapshot->_maximums[metric], CBPMetricsLoad(&histograms->maximums[metric]));
+
+            for (NSUInteger bucket = 0; bucket < CBPMetricsBucketCount; bucket++)
+            {
+                uint64_t count = CBPMetricsLoad(&histograms->counts[metric][bucket]);
+                snapshot->_counts[metric][bucket] += count;
+                snapshot->_totals[metric] += count;
+            }
+        }
+    }
+
+    return snapshot;
+}
+
+- (CBPMetricsSnapshot *)snapshotBySubtractingSnapshot:(CBPMetricsSnapshot *)snapshot
+{
+    CBPMetricsSnapshot *difference = [[CBPMetricsSnapshot alloc] init];
+
+    for (NSUInteger metric = 0; metric < CBPMetricCount; metric++)
+    {
+        difference->_sums[metric] = _sums[metric] - snapshot->_sums[metric];
+        difference->_maximums[metric] = _maximums[metric];
+
+        for (NSUInteger bucket = 0; bucket < CBPMetricsBucketCount; bucket++)
+        {
+            uint64_t count = _counts[metric][bucket] - snapshot->_counts[metric][bucket];
+            difference->_counts[metric][bucket] = count;
+            difference->_totals[metric] += count;
+        }
+    }
+
+    return difference;
+}
+
+- (uint64_t)countForMetric:(CBPMetric)metric
+{
+    return _totals[metric];
+}
+
+- (double)meanForMetric:(CBPMetric)metric
+{
+    return _totals[metric] ? (double)_sums[metric] / (double)_totals[metric] : 0;
+}
+
+- (uint64_t)maximumForMetric:(CBPMetric)metric
+{
+    return _maximums[metric];
+}
+
+- (uint64_t)valueAtPercentile:(double)percentile forMetric:(CBPMetric)metric
+{
+    if (!_totals[metric])
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)ceil(MIN(MAX(percentile, 0), 100) / 100 * (double)_totals[metric]);
+    uint64_t seen = 0;
+
+    for (NSUInteger bucket = 0; bucket < CBPMetricsBucketCount; bucket++)
+    {
+        seen += _counts[metric][bucket];
+
+        if (seen >= MAX(rank, (uint64_t)1))
+        {
+            return MIN(CBPMetricsBucketValue(bucket), _maximums[metric]);
+        }
+    }
+
+    return _maximums[metric];
+}
+
+@end
@@ -0,0 +1,61 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import "CBPMetrics.h"
+#import "CBPTime.h"
+#import <stdatomic.h>
+
+#if defined(__linux__) && __has_include(<sys/sdt.h>)
+#import <sys/sdt.h>
+#define CBPMetricsProbe(name, object) DTRACE_PROBE1(cbpfoundation, name, (uintptr_t)(__bridge const void *)(object))
+#else
+#define CBPMetricsProbe(name, object) do { } while (0)
+#endif
+
+extern _Atomic(BOOL) CBPMetricsEnabledFlag;
+
+/**
+ *  Returns YES if recording is on. This is the one branch callers pay while it is off.
+ */
+NS_INLINE BOOL CBPMetricsActive(void)
+{
+    return __builtin_expect(atomic_load_explicit(&CBPMetricsEnabledFlag, memory_order_relaxed), 0);
+}
+
+/**
+ *  Returns a monotonic timestamp in nanoseconds.
+ */
+NS_INLINE uint64_t CBPMetricsNow(void)
+{
+    return CBPMonotonicNanoseconds();
+}
+
+/**
+ *  Records an interval in the calling thread's histogram for @p metric.
+ *
+ *  @param metric      The metric.
+ *  @param nanoseconds The interval.
+ */
+extern void CBPMetricsRecord(CBPMetric metric, uint64_t nanoseconds);
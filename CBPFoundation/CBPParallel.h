@@ -0,0 +1,44 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  Performs part of a parallel loop.
+ *
+ *  @param range The indexes to process.
+ */
+typedef void (^CBPParallelApplyBlock)(NSRange range);
+
+/**
+ *  Performs @p block over the indexes [0, @p count), splitting them into chunks that are processed concurrently on the default executor. The calling thread processes chunks too and returns once every index has been processed.
+ *
+ *  Chunks are handed out largest first, each one a share of whatever is left, so the loop starts with few large chunks and finishes with small ones that balance uneven work. Every chunk except the last starts and ends on a multiple of @p grainSize.
+ *
+ *  @param count              The number of indexes.
+ *  @param grainSize          The smallest chunk to hand out. This value must be greater than 0.
+ *  @param maximumParallelism The maximum number of threads to use, including the calling thread. If 0, one per active processor.
+ *  @param block              The block to perform on each chunk.
+ */
+extern void CBPParallelApply(NSUInteger count, NSUInteger grainSize, NSUInteger maximumParallelism, CBPParallelApplyBlock block);
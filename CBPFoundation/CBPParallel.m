@@ -0,0 +1,158 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPParallel.h"
+#import "CBPExecutor.h"
+#import <stdatomic.h>
+
+@interface CBPParallelApplyContext : NSObject
+
+- (instancetype)initWithCount:(NSUInteger)count grainSize:(NSUInteger)grainSize parallelism:(NSUInteger)parallelism block:(CBPParallelApplyBlock)block;
+
+/**
+ *  Processes chunks until none are left.
+ */
+- (void)participate;
+
+/**
+ *  Blocks until every chunk has been processed.
+ */
+- (void)wait;
+
+@end
+
+#pragma mark -
+
+void CBPParallelApply(NSUInteger count, NSUInteger grainSize, NSUInteger maximumParallelism, CBPParallelApplyBlock block)
+{
+    if (!grainSize)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"grainSize must be greater than 0. %s", __PRETTY_FUNCTION__];
+    }
+
+    if (!count)
+    {
+        return;
+    }
+
+    NSUInteger unitCount = (count + grainSize - 1) / grainSize;
+    NSUInteger parallelism = maximumParallelism ? maximumParallelism : [[NSProcessInfo processInfo] activeProcessorCount];
+    parallelism = MIN(parallelism, unitCount);
+
+    if (parallelism <= 1)
+    {
+        block(NSMakeRange(0, count));
+        return;
+    }
+
+    CBPParallelApplyContext *context = [[CBPParallelApplyContext alloc] initWithCount:count grainSize:grainSize parallelism:parallelism block:block];
+    CBPExecutor *executor = [CBPExecutor defaultExecutor];
+
+    //-------------------------------------------------------------------
+    // The caller takes chunks too, so the loop finishes even if none of
+    // the helpers get to run. Helpers that start late find nothing left
+    // and return.
+    //-------------------------------------------------------------------
+    for (NSUInteger i = 1; i < parallelism; i++)
+    {
+        [executor execute:^{
+            [context participate];
+        }];
+    }
+
+    [context participate];
+    [context wait];
+}
+
+#pragma mark -
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPParallelApplyContext
+{
+    NSUInteger _count;
+    NSUInteger _grainSize;
+    NSUInteger _unitCount;
+    NSUInteger _parallelism;
+    CBPParallelApplyBlock _block;
+    dispatch_semaphore_t _semaphore;
+    _Atomic(NSUInteger) _nextUnit;
+    _Atomic(NSUInteger) _completedUnits;
+}
+
+- (instancetype)initWithCount:(NSUInteger)count grainSize:(NSUInteger)grainSize parallelism:(NSUInteger)parallelism block:(CBPParallelApplyBlock)block
+{
+    self = [super init];
+
+    if (self)
+    {
+        _count = count;
+        _grainSize = grainSize;
+        _unitCount = (count + grainSize - 1) / grainSize;
+        _parallelism = parallelism;
+        _block = [block copy];
+        _semaphore = dispatch_semaphore_create(0);
+        atomic_init(&_nextUnit, 0);
+        atomic_init(&_completedUnits, 0);
+    }
+
+    return self;
+}
+
+- (void)participate
+{
+    NSUInteger unit = atomic_load_explicit(&_nextUnit, memory_order_relaxed);
+
+    while (unit < _unitCount)
+    {
+        //-------------------------------------------------------------------
+        // Guided scheduling: take a share of what is left, so there are few
+        // chunks to hand out while the loop is young and small ones to
+        // even out the finish.
+        //-------------------------------------------------------------------
+        NSUInteger unitsInChunk = MAX((_unitCount - unit) / (_parallelism * 2), (NSUInteger)1);
+
+        if (!atomic_compare_exchange_weak_explicit(&_nextUnit, &unit, unit + unitsInChunk, memory_order_relaxed, memory_order_relaxed))
+        {
+            continue;
+        }
+
+        NSUInteger location = unit * _grainSize;
+        _block(NSMakeRange(location, MIN((unit + unitsInChunk) * _grainSize, _count) - location));
+
+        if (atomic_fetch_add_explicit(&_completedUnits, unitsInChunk, memory_order_acq_rel) + unitsInChunk == _unitCount)
+        {
+            dispatch_semaphore_signal(_semaphore);
+        }
+
+        unit = atomic_load_explicit(&_nextUnit, memory_order_relaxed);
+    }
+}
+
+- (void)wait
+{
+    dispatch_semaphore_wait(_semaphore, DISPATCH_TIME_FOREVER);
+}
+
+@end
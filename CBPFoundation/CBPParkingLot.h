@@ -0,0 +1,67 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import <time.h>
+
+/**
+ *  A process-wide table of wait queues keyed by address, so objects that are rarely waited on don't need a lock and condition of their own.
+ *
+ *  Addresses are hashed onto a fixed set of buckets. Each bucket owns one mutex, one condition and a list of parked threads, so the only per-object cost is whatever word the caller validates against.
+ */
+
+/**
+ *  Called with the bucket for the address locked. Return NO to return immediately without parking.
+ */
+typedef BOOL (*CBPParkingLotValidateFunction)(void *context);
+
+/**
+ *  Parks the calling thread on @p address until another thread unparks it, or until @p deadline passes.
+ *
+ *  @param address  The address to park on.
+ *  @param validate Called with the bucket locked before parking. Any state an unparking thread will check must be updated here.
+ *  @param context  Passed to @p validate.
+ *  @param deadline An absolute CLOCK_REALTIME deadline, or NULL to wait forever.
+ *
+ *  @return YES if the thread was unparked; NO if validation failed or the deadline passed.
+ */
+extern BOOL CBPParkingLotPark(const void *address, CBPParkingLotValidateFunction validate, void *context, const struct timespec *deadline);
+
+/**
+ *  Unparks every thread parked on @p address.
+ *
+ *  @param address The address threads are parked on.
+ *
+ *  @return The number of threads that were unparked.
+ */
+extern NSUInteger CBPParkingLotUnparkAll(const void *address);
+
+/**
+ *  Converts a relative timeout into an absolute deadline suitable for @p CBPParkingLotPark.
+ *
+ *  @param timeoutInterval The timeout, relative to now.
+ *
+ *  @return The deadline.
+ */
+extern struct timespec CBPParkingLotDeadlineWithTimeoutInterval(NSTimeInterval timeoutInterval);
@@ -0,0 +1,179 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPParkingLot.h"
+#import <pthread.h>
+#import <sys/time.h>
+#import <errno.h>
+
+#define CBPParkingLotBucketCount 256
+
+typedef struct CBPParkingLotWaiter
+{
+    const void *address;
+    struct CBPParkingLotWaiter *next;
+    BOOL unparked;
+} CBPParkingLotWaiter;
+
+typedef struct CBPParkingLotBucket
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    CBPParkingLotWaiter *waiters;
+} CBPParkingLotBucket;
+
+static CBPParkingLotBucket *CBPParkingLotBuckets(void)
+{
+    static CBPParkingLotBucket buckets[CBPParkingLotBucketCount];
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+
+        for (NSUInteger i = 0; i < CBPParkingLotBucketCount; i++)
+        {
+            pthread_mutex_init(&buckets[i].mutex, NULL);
+            pthread_cond_init(&buckets[i].condition, NULL);
+            buckets[i].waiters = NULL;
+        }
+
+    });
+
+    return buckets;
+}
+
+static CBPParkingLotBucket *CBPParkingLotBucketForAddress(const void *address)
+{
+    //-------------------------------------------------------------------
+    // Objects are at least 16 byte aligned, so drop the low bits before
+    // mixing in the rest with a Fibonacci hash.
+    //-------------------------------------------------------------------
+    uint64_t hash = ((uint64_t)(uintptr_t)address >> 4) * 11400714819323198485ull;
+
+    return &CBPParkingLotBuckets()[hash >> (64 - 8)];
+}
+
+static void CBPParkingLotBucketRemoveWaiter(CBPParkingLotBucket *bucket, CBPParkingLotWaiter *waiter)
+{
+    for (CBPParkingLotWaiter **link = &bucket->waiters; *link; link = &(*link)->next)
+    {
+        if (*link == waiter)
+        {
+            *link = waiter->next;
+            break;
+        }
+    }
+}
+
+BOOL CBPParkingLotPark(const void *address, CBPParkingLotValidateFunction validate, void *context, const struct timespec *deadline)
+{
+    CBPParkingLotBucket *bucket = CBPParkingLotBucketForAddress(address);
+
+    pthread_mutex_lock(&bucket->mutex);
+
+    if (!validate(context))
+    {
+        pthread_mutex_unlock(&bucket->mutex);
+        return NO;
+    }
+
+    CBPParkingLotWaiter waiter = { address, bucket->waiters, NO };
+    bucket->waiters = &waiter;
+
+    //-------------------------------------------------------------------
+    // Several addresses share a bucket and its condition, so a wakeup is
+    // only ours once the unparking thread has marked our waiter.
+    //-------------------------------------------------------------------
+    while (!waiter.unparked)
+    {
+        if (deadline)
+        {
+            if (pthread_cond_timedwait(&bucket->condition, &bucket->mutex, deadline) == ETIMEDOUT && !waiter.unparked)
+            {
+                CBPParkingLotBucketRemoveWaiter(bucket, &waiter);
+                break;
+            }
+        }
+        else
+        {
+            pthread_cond_wait(&bucket->condition, &bucket->mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&bucket->mutex);
+
+    return waiter.unparked;
+}
+
+NSUInteger CBPParkingLotUnparkAll(const void *address)
+{
+    CBPParkingLotBucket *bucket = CBPParkingLotBucketForAddress(address);
+    NSUInteger count = 0;
+
+    pthread_mutex_lock(&bucket->mutex);
+
+    CBPParkingLotWaiter **link = &bucket->waiters;
+
+    while (*link)
+    {
+        CBPParkingLotWaiter *waiter = *link;
+
+        if (waiter->address == address)
+        {
+            *link = waiter->next;
+            waiter->unparked = YES;
+            count++;
+        }
+        else
+        {
+            link = &waiter->next;
+        }
+    }
+
+    if (count)
+    {
+        pthread_cond_broadcast(&bucket->condition);
+    }
+
+    pthread_mutex_unlock(&bucket->mutex);
+
+    return count;
+}
+
+struct timespec CBPParkingLotDeadlineWithTimeoutInterval(NSTimeInterval timeoutInterval)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    //-------------------------------------------------------------------
+    // Clamp to roughly thirty years so "forever" style timeouts such as
+    // DBL_MAX don't overflow time_t.
+    //-------------------------------------------------------------------
+    NSTimeInterval seconds = (NSTimeInterval)now.tv_sec + (NSTimeInterval)now.tv_usec / USEC_PER_SEC + MIN(MAX(timeoutInterval, 0), 1e9);
+
+    struct timespec deadline;
+    deadline.tv_sec = (time_t)seconds;
+    deadline.tv_nsec = (long)((seconds - (NSTimeInterval)deadline.tv_sec) * NSEC_PER_SEC);
+
+    return deadline;
+}
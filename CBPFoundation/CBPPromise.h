@@ -25,6 +25,8 @@
 @import Foundation;
 #import "CBPDeref.h"
 
+@class CBPTimerWheel;
+
 /**
  *  The value returned by an invalid promise.
  */
@@ -41,6 +43,16 @@ extern id const CBPPromiseTimeoutValue;
  */
 - (instancetype)initWithTimeout:(NSTimeInterval)timeout;
 
+/**
+ *  Initializes a promise with a timeout value that is tracked by the given timer wheel. The timeout is accurate to within one tick of the wheel.
+ *
+ *  @param timeout    The length of time the promise is valid. This value must be greater than 0 or an exception will be thrown.
+ *  @param timerWheel The timer wheel that tracks the timeout. If nil, the shared timer wheel will be used.
+ *
+ *  @return An initialized promise.
+ */
+- (instancetype)initWithTimeout:(NSTimeInterval)timeout timerWheel:(CBPTimerWheel *)timerWheel;
+
 /**
  *  Deliver a value to the promise.
  *
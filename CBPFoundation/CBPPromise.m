@@ -24,36 +24,32 @@
 
 #import "CBPPromise.h"
 #import "CBPDerefSubclass.h"
-#import "NSThread+CBPExtensions.h"
+#import "CBPTimerWheel.h"
+#import "CBPMetricsRecording.h"
+#import <stdatomic.h>
 
 id const CBPPromiseTimeoutValue = @"CBPPromiseTimeoutValue";
 
-@interface CBPPromise ()
-
-@property (weak) NSTimer *timeoutTimer;
-
-@end
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
 
 @implementation CBPPromise
-
-+ (NSThread *)sharedPromiseTimerThread
 {
-    static NSThread *sharedPromiseTimerThread = nil;
-
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        sharedPromiseTimerThread = [NSThread cbp_runningThread];
-    });
-
-    return sharedPromiseTimerThread;
+    CBPTimerWheel *_timerWheel;
+    _Atomic(CBPTimerWheelTimeout) _timeout;
 }
 
 - (void)dealloc
 {
+    [self _cancelTimeout];
     [self invalidateWithError:nil];
 }
 
 - (instancetype)initWithTimeout:(NSTimeInterval)timeout
+{
+    return [self initWithTimeout:timeout timerWheel:nil];
+}
+
+- (instancetype)initWithTimeout:(NSTimeInterval)timeout timerWheel:(CBPTimerWheel *)timerWheel
 {
     if (timeout <= 0)
     {
@@ -65,15 +61,24 @@ id const CBPPromiseTimeoutValue = @"CBPPromiseTimeoutValue";
 
         if (self)
         {
-            [[[self class] sharedPromiseTimerThread] cbp_performBlockSync:^{
+            //-------------------------------------------------------------------
+            // Like the NSTimer this replaces, the timeout keeps the promise
+            // alive until it is delivered or times out.
+            //-------------------------------------------------------------------
+            _timerWheel = timerWheel ? timerWheel : [CBPTimerWheel sharedTimerWheel];
 
-                self.timeoutTimer = [NSTimer scheduledTimerWithTimeInterval:timeout
-                                                                     target:self
-                                                                   selector:@selector(invalidate:)
-                                                                   userInfo:nil
-                                                                    repeats:NO];
+            uint64_t createdTimestamp = CBPMetricsActive() ? CBPMetricsNow() : 0;
+
+            CBPTimerWheelTimeout timeoutHandle = [_timerWheel scheduleTimeout:timeout block:^{
+
+                if ([self _deliver:CBPPromiseTimeoutValue] && createdTimestamp)
+                {
+                    CBPMetricsRecord(CBPMetricPromiseTimeout, CBPMetricsNow() - createdTimestamp);
+                }
 
             }];
+
+            atomic_store_explicit(&_timeout, timeoutHandle, memory_order_release);
         }
     }
 
@@ -91,19 +96,19 @@ id const CBPPromiseTimeoutValue = @"CBPPromiseTimeoutValue";
 {
     BOOL delivered = [self assignValue:value];
 
-    if (self.timeoutTimer)
-    {
-        [[[self class] sharedPromiseTimerThread] cbp_performBlockSync:^{
-            [self.timeoutTimer invalidate];
-        }];
-    }
+    [self _cancelTimeout];
 
     return delivered;
 }
 
-- (void)invalidate:(NSTimer *)timer
+- (void)_cancelTimeout
 {
-    [self _deliver:CBPPromiseTimeoutValue];
+    CBPTimerWheelTimeout timeoutHandle = atomic_exchange_explicit(&_timeout, NULL, memory_order_acq_rel);
+
+    if (timeoutHandle)
+    {
+        [_timerWheel cancelTimeout:timeoutHandle];
+    }
 }
 
 @end
@@ -0,0 +1,100 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+@class CBPThreadConfiguration;
+
+/**
+ *  A fixed set of long-lived run loop threads that many clients share.
+ *
+ *  Each thread is created with +[NSThread cbp_runningThread] when the pool is initialized, so acquiring and relinquishing threads never creates or destroys one. A client acquires the thread with the fewest current clients and keeps it until it relinquishes it, so everything a client performs on its thread stays serial and confined to that thread. Clients that share a thread share its run loop, so blocking it delays all of them. All methods are thread safe.
+ */
+@interface CBPRunLoopThreadPool : NSObject
+
+/**
+ *  A shared pool with one thread per active processor.
+ *
+ *  @return The shared pool.
+ */
++ (instancetype)sharedPool;
+
+/**
+ *  Initializes a pool and starts its threads.
+ *
+ *  @param numberOfThreads The number of threads to start. Must be greater than 0.
+ *
+ *  @return An initialized pool.
+ */
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads;
+
+/**
+ *  Initializes a pool and starts its threads with @p configuration. Each thread's name is the configuration's name followed by the thread's index.
+ *
+ *  @param numberOfThreads The number of threads to start. Must be greater than 0.
+ *  @param configuration   The configuration for every thread, or nil for the defaults.
+ *
+ *  @return An initialized pool.
+ */
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads configuration:(CBPThreadConfiguration *)configuration;
+
+/**
+ *  The number of threads in the pool.
+ */
+@property (readonly, nonatomic) NSUInteger numberOfThreads;
+
+/**
+ *  The pool's threads, or an empty array once the pool is invalidated.
+ */
+@property (readonly, nonatomic) NSArray *threads;
+
+/**
+ *  Returns the thread with the fewest clients and counts the caller as one of its clients.
+ *
+ *  @return A running thread. Every call must be balanced by a call to -relinquishThread:.
+ */
+- (NSThread *)acquireThread;
+
+/**
+ *  Stops counting the caller as a client of @p thread.
+ *
+ *  @param thread A thread returned by -acquireThread.
+ */
+- (void)relinquishThread:(NSThread *)thread;
+
+/**
+ *  Returns the number of clients currently using @p thread.
+ *
+ *  @param thread A thread in the pool.
+ *
+ *  @return The number of clients.
+ */
+- (NSUInteger)numberOfClientsForThread:(NSThread *)thread;
+
+/**
+ *  Stops the pool's threads once they finish the work already scheduled on them. Pools other than the shared pool are invalidated when they are deallocated.
+ */
+- (void)invalidate;
+
+@end
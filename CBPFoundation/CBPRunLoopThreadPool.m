@@ -0,0 +1,176 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) 2014 Cameron Pulsford
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPRunLoopThreadPool.h"
+#import "NSThread+CBPExtensions.h"
+#import "CBPThreadConfiguration.h"
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@interface CBPRunLoopThreadPool ()
+{
+    NSArray *_threads;
+    NSUInteger *_clientCounts;
+    BOOL _invalidated;
+}
+
+@end
+
+@implementation CBPRunLoopThreadPool
+
++ (instancetype)sharedPool
+{
+    static CBPRunLoopThreadPool *sharedPool = nil;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        sharedPool = [[self alloc] initWithNumberOfThreads:[[NSProcessInfo processInfo] activeProcessorCount]];
+    });
+
+    return sharedPool;
+}
+
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads
+{
+    return [self initWithNumberOfThreads:numberOfThreads configuration:nil];
+}
+
+- (instancetype)initWithNumberOfThreads:(NSUInteger)numberOfThreads configuration:(CBPThreadConfiguration *)configuration
+{
+    if (!numberOfThreads)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"numberOfThreads must be greater than 0. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        NSMutableArray *threads = [NSMutableArray arrayWithCapacity:numberOfThreads];
+
+        CBPThreadConfiguration *threadConfiguration = configuration ? [configuration copy] : [[CBPThreadConfiguration alloc] init];
+        NSString *name = configuration.name ? configuration.name : @"com.cbpfoundation.runloopthreadpool";
+
+        for (NSUInteger i = 0; i < numberOfThreads; i++)
+        {
+            threadConfiguration.name = [NSString stringWithFormat:@"%@.%lu", name, (unsigned long)i];
+            [threads addObject:[NSThread cbp_runningThreadWithConfiguration:threadConfiguration]];
+        }
+
+        _threads = [threads copy];
+        _numberOfThreads = numberOfThreads;
+        _clientCounts = calloc(numberOfThreads, sizeof(NSUInteger));
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self invalidate];
+    free(_clientCounts);
+}
+
+- (NSArray *)threads
+{
+    @synchronized (self)
+    {
+        return _invalidated ? @[] : _threads;
+    }
+}
+
+- (NSThread *)acquireThread
+{
+    @synchronized (self)
+    {
+        if (_invalidated)
+        {
+            [NSException raise:NSInternalInconsistencyException format:@"Threads cannot be acquired from an invalidated pool. %s", __PRETTY_FUNCTION__];
+        }
+
+        //-------------------------------------------------------------------
+        // Least loaded placement; ties go to the lowest index so that a
+        // lightly used pool keeps its work on as few threads as possible.
+        //-------------------------------------------------------------------
+        NSUInteger index = 0;
+
+        for (NSUInteger i = 1; i < _numberOfThreads; i++)
+        {
+            if (_clientCounts[i] < _clientCounts[index])
+            {
+                index = i;
+            }
+        }
+
+        _clientCounts[index]++;
+
+        return _threads[index];
+    }
+}
+
+- (void)relinquishThread:(NSThread *)thread
+{
+    @synchronized (self)
+    {
+        NSUInteger index = [_threads indexOfObjectIdenticalTo:thread];
+
+        if (index == NSNotFound || !_clientCounts[index])
+        {
+            [NSException raise:NSInvalidArgumentException format:@"%@ was not acquired from this pool. %s", thread, __PRETTY_FUNCTION__];
+        }
+
+        _clientCounts[index]--;
+    }
+}
+
+- (NSUInteger)numberOfClientsForThread:(NSThread *)thread
+{
+    @synchronized (self)
+    {
+        NSUInteger index = [_threads indexOfObjectIdenticalTo:thread];
+
+        return index == NSNotFound ? 0 : _clientCounts[index];
+    }
+}
+
+- (void)invalidate
+{
+    NSArray *threads = nil;
+
+    @synchronized (self)
+    {
+        if (!_invalidated)
+        {
+            _invalidated = YES;
+            threads = _threads;
+        }
+    }
+
+    for (NSThread *thread in threads)
+    {
+        [thread cbp_stop];
+    }
+}
+
+@end
@@ -0,0 +1,181 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import "CBPCollectionTypes.h"
+
+@class CBPSequence;
+
+/**
+ *  Produces the elements of a generated sequence.
+ *
+ *  @return The next element, or nil to end the sequence.
+ */
+typedef id (^CBPSequenceGeneratorBlock)(void);
+
+/**
+ *  Maps an element to a sequence whose elements replace it.
+ *
+ *  @param object The element.
+ *
+ *  @return The replacement elements. If nil, the element is dropped.
+ */
+typedef CBPSequence *(^CBPSequenceFlatMapBlock)(id object);
+
+/**
+ *  Combines an element into an accumulated value.
+ *
+ *  @param accumulator The value accumulated so far.
+ *  @param object      The element.
+ *
+ *  @return The new accumulated value.
+ */
+typedef id (^CBPSequenceReduceBlock)(id accumulator, id object);
+
+/**
+ *  A lazy, composable sequence of objects.
+ *
+ *  Intermediate operations such as @p -map: and @p -filter: only describe a stage; nothing is evaluated until a terminal operation such as @p -array or @p -reduceWithInitialValue:block: runs. The terminal operation then pushes each element through every stage in a single pass, so no intermediate collections are built and stages after a @p -take: stop the source as soon as enough elements have been produced.
+ *
+ *  Sequences created from an array can be run any number of times. Sequences created from an enumerator or a generator consume their source and can only be run once.
+ */
+@interface CBPSequence : NSObject
+
+/**
+ *  Creates a sequence of the objects in an array.
+ *
+ *  @param array The array.
+ *
+ *  @return A sequence.
+ */
++ (instancetype)sequenceWithArray:(NSArray *)array;
+
+/**
+ *  Creates a sequence of the remaining objects in an enumerator.
+ *
+ *  @param enumerator The enumerator.
+ *
+ *  @return A sequence.
+ */
++ (instancetype)sequenceWithEnumerator:(NSEnumerator *)enumerator;
+
+/**
+ *  Creates a sequence of the objects returned by a generator, up to the first nil.
+ *
+ *  @param generator The generator.
+ *
+ *  @return A sequence.
+ */
++ (instancetype)sequenceWithGenerator:(CBPSequenceGeneratorBlock)generator;
+
+#pragma mark - Intermediate operations
+
+/**
+ *  Returns a sequence of the results of performing a block on each element.
+ *
+ *  @param block A block that must not return nil.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)map:(CBPArrayMappingBlock)block;
+
+/**
+ *  Returns a sequence of the elements for which a block returns YES.
+ *
+ *  @param block The block against which to evaluate each element.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)filter:(CBPArrayFilteringBlock)block;
+
+/**
+ *  Returns a sequence of the elements of the sequences returned by a block for each element.
+ *
+ *  @param block The block.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)flatMap:(CBPSequenceFlatMapBlock)block;
+
+/**
+ *  Returns a sequence of at most the first @p count elements.
+ *
+ *  @param count The number of elements to take.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)take:(NSUInteger)count;
+
+/**
+ *  Returns a sequence of all but the first @p count elements.
+ *
+ *  @param count The number of elements to skip.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)skip:(NSUInteger)count;
+
+/**
+ *  Returns a sequence of arrays of @p count consecutive elements. The last array may be shorter.
+ *
+ *  @param count The number of elements in each array. This value must be greater than 0 or an exception will be thrown.
+ *
+ *  @return A new sequence.
+ */
+- (CBPSequence *)chunk:(NSUInteger)count;
+
+#pragma mark - Terminal operations
+
+/**
+ *  Runs the sequence and collects its elements.
+ *
+ *  @return An array of the elements.
+ */
+- (NSArray *)array;
+
+/**
+ *  Runs the sequence and collects its elements, processing parts of the source concurrently when it is a large array and every stage is a map, filter or flat map. Otherwise this is the same as @p -array. The blocks must be safe to perform concurrently.
+ *
+ *  @return An array of the elements, in order.
+ */
+- (NSArray *)concurrentArray;
+
+/**
+ *  Runs the sequence and combines its elements into a single value.
+ *
+ *  @param initialValue The initial accumulated value.
+ *  @param block        The block that combines each element into the accumulated value.
+ *
+ *  @return The final accumulated value.
+ */
+- (id)reduceWithInitialValue:(id)initialValue block:(CBPSequenceReduceBlock)block;
+
+/**
+ *  Runs the sequence, performing a block with each element.
+ *
+ *  @param block The block. Set @p stop to YES to stop the sequence early.
+ */
+- (void)enumerateObjectsUsingBlock:(void (^)(id object, BOOL *stop))block;
+
+@end
@@ -0,0 +1,496 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPSequence.h"
+#import "CBPParallel.h"
+
+/*
+ *  Elements flow through a sequence as calls to a chain of sinks, one per stage, ending in the terminal operation's
+ *  sink. A sink returns NO once it doesn't want any more elements. The source calls the sink with nil once it runs
+ *  out, so stages that buffer (such as chunking) can flush; a stage that stops early sends nil downstream itself.
+ */
+typedef BOOL (^CBPSequenceSink)(id object);
+
+/*
+ *  Pushes every element into the sink. Returns NO if the sink stopped it early.
+ */
+typedef BOOL (^CBPSequenceSource)(CBPSequenceSink sink);
+
+/*
+ *  Wraps the downstream sink in this stage's sink. Called once per run, so any state a stage keeps is created here.
+ */
+typedef CBPSequenceSink (^CBPSequenceStage)(CBPSequenceSink downstream);
+
+/*
+ *  Objects are copied out of a source array this many at a time.
+ */
+#define CBPSequenceBufferCount 64
+
+/*
+ *  Arrays shorter than this are always run serially by -concurrentArray.
+ */
+static const NSUInteger CBPSequenceConcurrentThreshold = 2048;
+
+/*
+ *  The smallest part of a source array handed to a thread by -concurrentArray.
+ */
+static const NSUInteger CBPSequenceConcurrentGrainSize = 256;
+
+static BOOL CBPSequenceEnumerateArray(NSArray *array, NSRange range, CBPSequenceSink sink)
+{
+    __unsafe_unretained id objects[CBPSequenceBufferCount];
+
+    for (NSUInteger location = range.location; location < NSMaxRange(range); location += CBPSequenceBufferCount)
+    {
+        NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPSequenceBufferCount, NSMaxRange(range) - location));
+        [array getObjects:objects range:bufferRange];
+
+        for (NSUInteger i = 0; i < bufferRange.length; i++)
+        {
+            if (!sink(objects[i]))
+            {
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+@interface CBPSequence ()
+
+- (instancetype)initWithSource:(CBPSequenceSource)source array:(NSArray *)array stage:(CBPSequenceStage)stage stateless:(BOOL)stateless;
+
+@end
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPSequence
+{
+    CBPSequenceSource _source;
+    NSArray *_array;
+    CBPSequenceStage _stage;
+    BOOL _stateless;
+}
+
++ (instancetype)sequenceWithArray:(NSArray *)array
+{
+    NSArray *source = [array copy];
+
+    return [[self alloc] initWithSource:^BOOL(CBPSequenceSink sink) {
+
+        if (!CBPSequenceEnumerateArray(source, NSMakeRange(0, [source count]), sink))
+        {
+            return NO;
+        }
+
+        sink(nil);
+        return YES;
+
+    } array:source stage:nil stateless:YES];
+}
+
++ (instancetype)sequenceWithEnumerator:(NSEnumerator *)enumerator
+{
+    return [[self alloc] initWithSource:^BOOL(CBPSequenceSink sink) {
+
+        id object = nil;
+
+        while ((object = [enumerator nextObject]))
+        {
+            if (!sink(object))
+            {
+                return NO;
+            }
+        }
+
+        sink(nil);
+        return YES;
+
+    } array:nil stage:nil stateless:YES];
+}
+
++ (instancetype)sequenceWithGenerator:(CBPSequenceGeneratorBlock)generator
+{
+    return [[self alloc] initWithSource:^BOOL(CBPSequenceSink sink) {
+
+        id object = nil;
+
+        while ((object = generator()))
+        {
+            if (!sink(object))
+            {
+                return NO;
+            }
+        }
+
+        sink(nil);
+        return YES;
+
+    } array:nil stage:nil stateless:YES];
+}
+
+- (instancetype)initWithSource:(CBPSequenceSource)source array:(NSArray *)array stage:(CBPSequenceStage)stage stateless:(BOOL)stateless
+{
+    self = [super init];
+
+    if (self)
+    {
+        _source = [source copy];
+        _array = array;
+        _stage = [stage copy];
+        _stateless = stateless;
+    }
+
+    return self;
+}
+
+#pragma mark - Intermediate operations
+
+- (CBPSequence *)map:(CBPArrayMappingBlock)block
+{
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        return ^BOOL(id object) {
+
+            id result = object ? block(object) : nil;
+
+            if (object && !result)
+            {
+                [NSException raise:NSInvalidArgumentException format:@"The mapping block must not return nil. %s", __PRETTY_FUNCTION__];
+            }
+
+            return downstream(result);
+
+        };
+
+    } stateless:YES];
+}
+
+- (CBPSequence *)filter:(CBPArrayFilteringBlock)block
+{
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        return ^BOOL(id object) {
+
+            if (object && !block(object))
+            {
+                return YES;
+            }
+
+            return downstream(object);
+
+        };
+
+    } stateless:YES];
+}
+
+- (CBPSequence *)flatMap:(CBPSequenceFlatMapBlock)block
+{
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        //-------------------------------------------------------------------
+        // The end of each inner sequence is swallowed; only the end of the
+        // outer sequence is passed on. An inner sequence may also stop
+        // itself (e.g. with -take:), so only a NO from downstream stops the
+        // outer sequence.
+        //-------------------------------------------------------------------
+        __block BOOL downstreamStopped = NO;
+
+        CBPSequenceSink innerSink = ^BOOL(id innerObject) {
+
+            if (innerObject && !downstream(innerObject))
+            {
+                downstreamStopped = YES;
+                return NO;
+            }
+
+            return YES;
+
+        };
+
+        return ^BOOL(id object) {
+
+            if (!object)
+            {
+                return downstream(nil);
+            }
+
+            [block(object) _runWithSink:innerSink];
+
+            return !downstreamStopped;
+
+        };
+
+    } stateless:YES];
+}
+
+- (CBPSequence *)take:(NSUInteger)count
+{
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        __block NSUInteger taken = 0;
+
+        return ^BOOL(id object) {
+
+            if (!object)
+            {
+                return downstream(nil);
+            }
+
+            if (taken < count)
+            {
+                taken++;
+
+                if (!downstream(object))
+                {
+                    return NO;
+                }
+            }
+
+            if (taken == count)
+            {
+                //-------------------------------------------------------------------
+                // Stop the source now; it won't send the end, so send it here.
+                //-------------------------------------------------------------------
+                downstream(nil);
+                return NO;
+            }
+
+            return YES;
+
+        };
+
+    } stateless:NO];
+}
+
+- (CBPSequence *)skip:(NSUInteger)count
+{
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        __block NSUInteger skipped = 0;
+
+        return ^BOOL(id object) {
+
+            if (object && skipped < count)
+            {
+                skipped++;
+                return YES;
+            }
+
+            return downstream(object);
+
+        };
+
+    } stateless:NO];
+}
+
+- (CBPSequence *)chunk:(NSUInteger)count
+{
+    if (!count)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"count must be greater than 0. %s", __PRETTY_FUNCTION__];
+    }
+
+    return [self _sequenceByAddingStage:^CBPSequenceSink(CBPSequenceSink downstream) {
+
+        __block NSMutableArray *chunk = nil;
+
+        return ^BOOL(id object) {
+
+            if (!object)
+            {
+                if ([chunk count] && !downstream([chunk copy]))
+                {
+                    return NO;
+                }
+
+                return downstream(nil);
+            }
+
+            if (!chunk)
+            {
+                chunk = [NSMutableArray arrayWithCapacity:count];
+            }
+
+            [chunk addObject:object];
+
+            if ([chunk count] < count)
+            {
+                return YES;
+            }
+
+            NSArray *fullChunk = [chunk copy];
+            chunk = nil;
+
+            return downstream(fullChunk);
+
+        };
+
+    } stateless:NO];
+}
+
+#pragma mark - Terminal operations
+
+- (NSArray *)array
+{
+    //-------------------------------------------------------------------
+    // The output is the only collection built, so it is returned as is
+    // rather than copied.
+    //-------------------------------------------------------------------
+    NSMutableArray *array = [NSMutableArray array];
+
+    [self _runWithSink:^BOOL(id object) {
+
+        if (object)
+        {
+            [array addObject:object];
+        }
+
+        return YES;
+
+    }];
+
+    return array;
+}
+
+- (NSArray *)concurrentArray
+{
+    NSArray *source = _array;
+    NSUInteger count = [source count];
+
+    if (!source || !_stateless || count < CBPSequenceConcurrentThreshold)
+    {
+        return [self array];
+    }
+
+    //-------------------------------------------------------------------
+    // Every stage is stateless, so each part of the source can be run
+    // through its own chain of sinks. Parts are grain aligned, which
+    // gives each one a slot to keep its output in order.
+    //-------------------------------------------------------------------
+    NSUInteger slotCount = (count + CBPSequenceConcurrentGrainSize - 1) / CBPSequenceConcurrentGrainSize;
+    __strong NSArray **slots = (__strong NSArray **)calloc(slotCount, sizeof(NSArray *));
+    CBPSequenceStage stage = _stage;
+
+    CBPParallelApply(count, CBPSequenceConcurrentGrainSize, 0, ^(NSRange range) {
+
+        NSMutableArray *part = [NSMutableArray array];
+
+        CBPSequenceSink sink = ^BOOL(id object) {
+
+            if (object)
+            {
+                [part addObject:object];
+            }
+
+            return YES;
+
+        };
+
+        CBPSequenceEnumerateArray(source, range, stage ? stage(sink) : sink);
+        slots[range.location / CBPSequenceConcurrentGrainSize] = part;
+
+    });
+
+    NSUInteger resultCount = 0;
+
+    for (NSUInteger i = 0; i < slotCount; i++)
+    {
+        resultCount += [slots[i] count];
+    }
+
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:resultCount];
+
+    for (NSUInteger i = 0; i < slotCount; i++)
+    {
+        if (slots[i])
+        {
+            [array addObjectsFromArray:slots[i]];
+            slots[i] = nil;
+        }
+    }
+
+    free(slots);
+
+    return array;
+}
+
+- (id)reduceWithInitialValue:(id)initialValue block:(CBPSequenceReduceBlock)block
+{
+    __block id accumulator = initialValue;
+
+    [self _runWithSink:^BOOL(id object) {
+
+        if (object)
+        {
+            accumulator = block(accumulator, object);
+        }
+
+        return YES;
+
+    }];
+
+    return accumulator;
+}
+
+- (void)enumerateObjectsUsingBlock:(void (^)(id object, BOOL *stop))block
+{
+    [self _runWithSink:^BOOL(id object) {
+
+        BOOL stop = NO;
+
+        if (object)
+        {
+            block(object, &stop);
+        }
+
+        return !stop;
+
+    }];
+}
+
+#pragma mark -
+
+- (CBPSequence *)_sequenceByAddingStage:(CBPSequenceStage)stage stateless:(BOOL)stateless
+{
+    CBPSequenceStage previousStage = _stage;
+    CBPSequenceStage composedStage = stage;
+
+    if (previousStage)
+    {
+        composedStage = ^CBPSequenceSink(CBPSequenceSink downstream) {
+            return previousStage(stage(downstream));
+        };
+    }
+
+    return [[CBPSequence alloc] initWithSource:_source array:_array stage:composedStage stateless:_stateless && stateless];
+}
+
+- (BOOL)_runWithSink:(CBPSequenceSink)sink
+{
+    return _source(_stage ? _stage(sink) : sink);
+}
+
+@end
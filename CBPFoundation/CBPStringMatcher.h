@@ -0,0 +1,91 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+typedef void (^CBPStringMatcherBlock)(NSUInteger patternIndex, NSRange range, BOOL *stop);
+
+/**
+ *  Finds any number of patterns in a string with a single pass over it.
+ *
+ *  The patterns are compiled once into an Aho–Corasick automaton, so the time to scan a string depends on its length and the number of matches, not on the number of patterns. Matching is literal, one UTF-16 code unit at a time. Case-insensitive matchers fold each code unit to its lower case form, which covers ASCII and most alphabets but not foldings that change the length, such as "ß" and "SS". Matchers are immutable and may be shared between threads.
+ */
+@interface CBPStringMatcher : NSObject
+
+/**
+ *  Initializes a matcher for @p patterns.
+ *
+ *  @param patterns The strings to search for. Empty strings are never found, and only the first of any duplicate patterns is reported.
+ *  @param options  0, or any combination of NSCaseInsensitiveSearch and NSLiteralSearch.
+ *
+ *  @return An initialized matcher.
+ */
+- (instancetype)initWithPatterns:(NSArray *)patterns options:(NSStringCompareOptions)options;
+
+/**
+ *  The patterns the matcher was initialized with.
+ */
+@property (readonly, copy, nonatomic) NSArray *patterns;
+
+/**
+ *  The options the matcher was initialized with.
+ */
+@property (readonly, nonatomic) NSStringCompareOptions options;
+
+/**
+ *  Returns YES if any pattern occurs in @p string.
+ *
+ *  @param string The string to search.
+ *
+ *  @return YES if any pattern occurs in @p string.
+ */
+- (BOOL)containsAnyPatternInString:(NSString *)string;
+
+/**
+ *  Returns the range of the match that ends first in @p string. If several patterns end at the same place, the longest one wins.
+ *
+ *  @param string The string to search.
+ *
+ *  @return The range of the first match, or {NSNotFound, 0}.
+ */
+- (NSRange)rangeOfFirstMatchInString:(NSString *)string;
+
+/**
+ *  Returns the ranges of every match in @p string, including overlapping ones, ordered by where they end.
+ *
+ *  @param string The string to search.
+ *
+ *  @return An array of NSValue wrapped NSRanges.
+ */
+- (NSArray *)rangesOfMatchesInString:(NSString *)string;
+
+/**
+ *  Calls @p block for every match in @p string, including overlapping ones, ordered by where they end.
+ *
+ *  @param string The string to search.
+ *  @param block  The block to call with the index of the matching pattern and the range it matched.
+ */
+- (void)enumerateMatchesInString:(NSString *)string usingBlock:(CBPStringMatcherBlock)block;
+
+@end
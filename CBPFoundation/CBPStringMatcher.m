@@ -0,0 +1,492 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPStringMatcher.h"
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+/*
+ *  The automaton runs over symbols rather than code units. An ASCII code unit is one symbol, and any other code unit is
+ *  two: its high byte followed by its low byte. The three kinds of symbol are numbered into disjoint equivalence
+ *  classes, so a match can only begin and end on a code unit boundary, and the transition table needs one column per
+ *  distinct symbol that occurs in the patterns rather than one per code unit. Class 0 stands for every symbol that
+ *  occurs in no pattern and always leads back to the root.
+ */
+typedef struct CBPStringMatcherAutomaton
+{
+    uint32_t *transitions;
+    int32_t *patternAtState;
+    uint32_t *outputLinks;
+    uint8_t *matching;
+    unichar *foldedVariants;
+    unichar *foldedUnits;
+    NSUInteger foldedCount;
+    uint32_t stateCount;
+    uint32_t classCount;
+    BOOL caseInsensitive;
+    uint16_t asciiClasses[128];
+    uint16_t highClasses[256];
+    uint16_t lowClasses[256];
+} CBPStringMatcherAutomaton;
+
+#define CBPStringMatcherNoState UINT32_MAX
+
+static unichar CBPStringMatcherFold(const CBPStringMatcherAutomaton *automaton, unichar unit)
+{
+    NSUInteger low = 0;
+    NSUInteger high = automaton->foldedCount;
+
+    while (low < high)
+    {
+        NSUInteger middle = (low + high) / 2;
+
+        if (automaton->foldedVariants[middle] < unit)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (low < automaton->foldedCount && automaton->foldedVariants[low] == unit) ? automaton->foldedUnits[low] : unit;
+}
+
+NS_INLINE uint32_t CBPStringMatcherStep(const CBPStringMatcherAutomaton *automaton, uint32_t state, unichar unit)
+{
+    const uint32_t *transitions = automaton->transitions;
+    uint32_t classCount = automaton->classCount;
+
+    if (unit >= 0x80 && automaton->foldedCount)
+    {
+        unit = CBPStringMatcherFold(automaton, unit);
+    }
+
+    if (unit < 0x80)
+    {
+        return transitions[state * classCount + automaton->asciiClasses[unit]];
+    }
+
+    uint16_t highClass = automaton->highClasses[unit >> 8];
+
+    //-------------------------------------------------------------------
+    // No pattern contains this code unit, so no match can span it.
+    //-------------------------------------------------------------------
+    if (!highClass)
+    {
+        return 0;
+    }
+
+    state = transitions[state * classCount + highClass];
+
+    return transitions[state * classCount + automaton->lowClasses[unit & 0xFF]];
+}
+
+static uint16_t CBPStringMatcherClass(uint16_t *classes, NSUInteger index, uint32_t *classCount)
+{
+    if (!classes[index])
+    {
+        classes[index] = (uint16_t)(*classCount)++;
+    }
+
+    return classes[index];
+}
+
+/*
+ *  Builds the automaton from patterns that have already been folded. Each pattern is added to a trie, and a breadth
+ *  first pass then fills in the missing transitions from each state's failure link so that scanning never backtracks.
+ */
+static void CBPStringMatcherBuild(CBPStringMatcherAutomaton *automaton, const unichar *const *patterns, const NSUInteger *patternLengths, NSUInteger patternCount)
+{
+    automaton->classCount = 1;
+
+    NSUInteger symbolCount = 0;
+
+    for (NSUInteger i = 0; i < patternCount; i++)
+    {
+        for (NSUInteger j = 0; j < patternLengths[i]; j++)
+        {
+            unichar unit = patterns[i][j];
+
+            if (unit < 0x80)
+            {
+                if (automaton->caseInsensitive && unit >= 'A' && unit <= 'Z')
+                {
+                    unit = (unichar)(unit | 0x20);
+                }
+
+                CBPStringMatcherClass(automaton->asciiClasses, unit, &automaton->classCount);
+                symbolCount += 1;
+            }
+            else
+            {
+                CBPStringMatcherClass(automaton->highClasses, unit >> 8, &automaton->classCount);
+                CBPStringMatcherClass(automaton->lowClasses, unit & 0xFF, &automaton->classCount);
+                symbolCount += 2;
+            }
+        }
+    }
+
+    if (automaton->caseInsensitive)
+    {
+        for (unichar unit = 'A'; unit <= 'Z'; unit++)
+        {
+            automaton->asciiClasses[unit] = automaton->asciiClasses[unit | 0x20];
+        }
+    }
+
+    uint32_t classCount = automaton->classCount;
+    NSUInteger maximumStateCount = symbolCount + 1;
+    uint32_t *transitions = malloc(maximumStateCount * classCount * sizeof(uint32_t));
+    int32_t *patternAtState = malloc(maximumStateCount * sizeof(int32_t));
+
+    memset(transitions, 0xFF, maximumStateCount * classCount * sizeof(uint32_t));
+    memset(patternAtState, 0xFF, maximumStateCount * sizeof(int32_t));
+
+    uint32_t stateCount = 1;
+
+    for (NSUInteger i = 0; i < patternCount; i++)
+    {
+        if (!patternLengths[i])
+        {
+            continue;
+        }
+
+        uint32_t state = 0;
+
+        for (NSUInteger j = 0; j < patternLengths[i]; j++)
+        {
+            unichar unit = patterns[i][j];
+            uint16_t symbols[2];
+            NSUInteger count = 0;
+
+            if (unit < 0x80)
+            {
+                symbols[count++] = automaton->asciiClasses[unit];
+            }
+            else
+            {
+                symbols[count++] = automaton->highClasses[unit >> 8];
+                symbols[count++] = automaton->lowClasses[unit & 0xFF];
+            }
+
+            for (NSUInteger k = 0; k < count; k++)
+            {
+                uint32_t *transition = &transitions[state * classCount + symbols[k]];
+
+                if (*transition == CBPStringMatcherNoState)
+                {
+                    *transition = stateCount++;
+                }
+
+                state = *transition;
+            }
+        }
+
+        if (patternAtState[state] < 0)
+        {
+            patternAtState[state] = (int32_t)i;
+        }
+    }
+
+    uint32_t *failureLinks = calloc(stateCount, sizeof(uint32_t));
+    uint32_t *outputLinks = calloc(stateCount, sizeof(uint32_t));
+    uint32_t *queue = malloc(stateCount * sizeof(uint32_t));
+    NSUInteger head = 0;
+    NSUInteger tail = 0;
+
+    for (uint32_t symbol = 0; symbol < classCount; symbol++)
+    {
+        uint32_t child = transitions[symbol];
+
+        if (child == CBPStringMatcherNoState)
+        {
+            transitions[symbol] = 0;
+        }
+        else
+        {
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail)
+    {
+        uint32_t state = queue[head++];
+        uint32_t *row = &transitions[state * classCount];
+        const uint32_t *failureRow = &transitions[failureLinks[state] * classCount];
+
+        for (uint32_t symbol = 0; symbol < classCount; symbol++)
+        {
+            uint32_t child = row[symbol];
+
+            if (child == CBPStringMatcherNoState)
+            {
+                row[symbol] = failureRow[symbol];
+            }
+            else
+            {
+                //-------------------------------------------------------------------
+                // The failure state is shallower, so its links are final.
+                //-------------------------------------------------------------------
+                uint32_t failure = failureRow[symbol];
+                failureLinks[child] = failure;
+                outputLinks[child] = patternAtState[failure] >= 0 ? failure : outputLinks[failure];
+                queue[tail++] = child;
+            }
+        }
+    }
+
+    uint8_t *matching = malloc(stateCount);
+
+    for (uint32_t state = 0; state < stateCount; state++)
+    {
+        matching[state] = patternAtState[state] >= 0 || outputLinks[state] != 0;
+    }
+
+    free(failureLinks);
+    free(queue);
+
+    automaton->transitions = realloc(transitions, (NSUInteger)stateCount * classCount * sizeof(uint32_t));
+    automaton->patternAtState = realloc(patternAtState, stateCount * sizeof(int32_t));
+    automaton->outputLinks = outputLinks;
+    automaton->matching = matching;
+    automaton->stateCount = stateCount;
+}
+
+@interface CBPStringMatcher ()
+{
+    CBPStringMatcherAutomaton _automaton;
+    NSUInteger *_patternLengths;
+}
+
+@end
+
+@implementation CBPStringMatcher
+
+- (instancetype)initWithPatterns:(NSArray *)patterns options:(NSStringCompareOptions)options
+{
+    if ((options & ~(NSStringCompareOptions)(NSCaseInsensitiveSearch | NSLiteralSearch)) != 0)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"Only NSCaseInsensitiveSearch and NSLiteralSearch are supported. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        _patterns = [patterns copy];
+        _options = options;
+        _automaton.caseInsensitive = (options & NSCaseInsensitiveSearch) != 0;
+
+        NSUInteger patternCount = [_patterns count];
+        _patternLengths = calloc(MAX(patternCount, (NSUInteger)1), sizeof(NSUInteger));
+
+        unichar **foldedPatterns = calloc(MAX(patternCount, (NSUInteger)1), sizeof(unichar *));
+        NSMutableDictionary *foldedVariants = [NSMutableDictionary dictionary];
+        NSMutableDictionary *foldCache = [NSMutableDictionary dictionary];
+
+        [_patterns enumerateObjectsUsingBlock:^(NSString *pattern, NSUInteger index, BOOL *stop) {
+
+            if (![pattern isKindOfClass:[NSString class]])
+            {
+                [NSException raise:NSInvalidArgumentException format:@"Patterns must be strings, not %@. %s", pattern, __PRETTY_FUNCTION__];
+            }
+
+            NSUInteger length = [pattern length];
+            unichar *units = malloc(MAX(length, (NSUInteger)1) * sizeof(unichar));
+            [pattern getCharacters:units range:NSMakeRange(0, length)];
+
+            if (self->_automaton.caseInsensitive)
+            {
+                for (NSUInteger i = 0; i < length; i++)
+                {
+                    if (units[i] >= 0x80)
+                    {
+                        units[i] = [self _foldUnit:units[i] cache:foldCache variants:foldedVariants];
+                    }
+                }
+            }
+
+            self->_patternLengths[index] = length;
+            foldedPatterns[index] = units;
+        }];
+
+        //-------------------------------------------------------------------
+        // Code units in the haystack are folded by looking them up in a
+        // sorted table of the case variants of the patterns' code units.
+        //-------------------------------------------------------------------
+        NSArray *variants = [[foldedVariants allKeys] sortedArrayUsingSelector:@selector(compare:)];
+        _automaton.foldedCount = [variants count];
+
+        if (_automaton.foldedCount)
+        {
+            _automaton.foldedVariants = malloc(_automaton.foldedCount * sizeof(unichar));
+            _automaton.foldedUnits = malloc(_automaton.foldedCount * sizeof(unichar));
+
+            [variants enumerateObjectsUsingBlock:^(NSNumber *variant, NSUInteger index, BOOL *stop) {
+                self->_automaton.foldedVariants[index] = [variant unsignedShortValue];
+                self->_automaton.foldedUnits[index] = [foldedVariants[variant] unsignedShortValue];
+            }];
+        }
+
+        CBPStringMatcherBuild(&_automaton, (const unichar *const *)foldedPatterns, _patternLengths, patternCount);
+
+        for (NSUInteger i = 0; i < patternCount; i++)
+        {
+            free(foldedPatterns[i]);
+        }
+
+        free(foldedPatterns);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_automaton.transitions);
+    free(_automaton.patternAtState);
+    free(_automaton.outputLinks);
+    free(_automaton.matching);
+    free(_automaton.foldedVariants);
+    free(_automaton.foldedUnits);
+    free(_patternLengths);
+}
+
+- (BOOL)containsAnyPatternInString:(NSString *)string
+{
+    __block BOOL found = NO;
+
+    [self enumerateMatchesInString:string usingBlock:^(NSUInteger patternIndex, NSRange range, BOOL *stop) {
+        found = YES;
+        *stop = YES;
+    }];
+
+    return found;
+}
+
+- (NSRange)rangeOfFirstMatchInString:(NSString *)string
+{
+    __block NSRange firstRange = NSMakeRange(NSNotFound, 0);
+
+    [self enumerateMatchesInString:string usingBlock:^(NSUInteger patternIndex, NSRange range, BOOL *stop) {
+        firstRange = range;
+        *stop = YES;
+    }];
+
+    return firstRange;
+}
+
+- (NSArray *)rangesOfMatchesInString:(NSString *)string
+{
+    NSMutableArray *ranges = [NSMutableArray array];
+
+    [self enumerateMatchesInString:string usingBlock:^(NSUInteger patternIndex, NSRange range, BOOL *stop) {
+        [ranges addObject:[NSValue valueWithRange:range]];
+    }];
+
+    return ranges;
+}
+
+- (void)enumerateMatchesInString:(NSString *)string usingBlock:(CBPStringMatcherBlock)block
+{
+    CFStringRef cfString = (__bridge CFStringRef)string;
+    CFIndex length = CFStringGetLength(cfString);
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer(cfString, &buffer, CFRangeMake(0, length));
+
+    const CBPStringMatcherAutomaton *automaton = &_automaton;
+    uint32_t state = 0;
+    BOOL stop = NO;
+
+    for (CFIndex index = 0; index < length; index++)
+    {
+        state = CBPStringMatcherStep(automaton, state, CFStringGetCharacterFromInlineBuffer(&buffer, index));
+
+        if (!automaton->matching[state])
+        {
+            continue;
+        }
+
+        //-------------------------------------------------------------------
+        // Report the pattern ending here, if any, then every shorter one
+        // reachable through the output links.
+        //-------------------------------------------------------------------
+        uint32_t output = automaton->patternAtState[state] >= 0 ? state : automaton->outputLinks[state];
+
+        for (; output; output = automaton->outputLinks[output])
+        {
+            NSUInteger patternIndex = (NSUInteger)automaton->patternAtState[output];
+            NSUInteger patternLength = _patternLengths[patternIndex];
+
+            block(patternIndex, NSMakeRange((NSUInteger)index + 1 - patternLength, patternLength), &stop);
+
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+}
+
+#pragma mark - Private
+
+- (unichar)_foldUnit:(unichar)unit cache:(NSMutableDictionary *)cache variants:(NSMutableDictionary *)variants
+{
+    NSNumber *cached = cache[@(unit)];
+
+    if (cached)
+    {
+        return [cached unsignedShortValue];
+    }
+
+    //-------------------------------------------------------------------
+    // Only foldings that keep the length at one code unit are used; the
+    // upper case form is recorded so haystacks can be folded to match.
+    //-------------------------------------------------------------------
+    NSString *string = [NSString stringWithCharacters:&unit length:1];
+    NSString *lowercase = [string lowercaseString];
+    NSString *uppercase = [string uppercaseString];
+    unichar folded = [lowercase length] == 1 ? [lowercase characterAtIndex:0] : unit;
+
+    for (NSString *variant in @[string, uppercase, [NSString stringWithCharacters:&folded length:1]])
+    {
+        if ([variant length] == 1)
+        {
+            unichar variantUnit = [variant characterAtIndex:0];
+
+            if (variantUnit != folded && variantUnit >= 0x80 && !variants[@(variantUnit)])
+            {
+                variants[@(variantUnit)] = @(folded);
+            }
+        }
+    }
+
+    cache[@(unit)] = @(folded);
+
+    return folded;
+}
+
+@end
@@ -0,0 +1,59 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+/**
+ *  Byte-level substring search for ASCII text.
+ *
+ *  Candidate positions are found by comparing the needle's first and last bytes against a whole vector of haystack positions at once (AVX2 or SSE2 on x86, NEON on ARM, and a portable scalar loop elsewhere); only positions where both match are compared in full. Case-insensitive searches fold ASCII letters only, so both buffers must be ASCII for the result to match NSString's.
+ */
+
+typedef NS_OPTIONS(NSUInteger, CBPStringSearchOptions)
+{
+    CBPStringSearchCaseInsensitive = 1 << 0,
+};
+
+/**
+ *  Finds the first occurrence of @p needle in @p haystack.
+ *
+ *  @param haystack       The bytes to search.
+ *  @param haystackLength The number of bytes to search.
+ *  @param needle         The bytes to search for.
+ *  @param needleLength   The number of bytes to search for.
+ *  @param options        The search options.
+ *
+ *  @return The offset of the first occurrence, or NSNotFound. Like @p -rangeOfString:, an empty needle is never found.
+ */
+extern NSUInteger CBPStringSearchFind(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, CBPStringSearchOptions options);
+
+/**
+ *  Returns YES if every byte is ASCII.
+ *
+ *  @param bytes  The bytes to check.
+ *  @param length The number of bytes to check.
+ *
+ *  @return YES if no byte has its high bit set.
+ */
+extern BOOL CBPStringSearchIsASCII(const uint8_t *bytes, NSUInteger length);
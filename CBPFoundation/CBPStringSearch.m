@@ -0,0 +1,281 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPStringSearch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#import <immintrin.h>
+#define CBP_STRING_SEARCH_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#import <arm_neon.h>
+#define CBP_STRING_SEARCH_NEON 1
+#endif
+
+/*
+ *  A byte filter matches a haystack byte when (byte | mask) == value. Letters in a case-insensitive search get a mask
+ *  of 0x20, which folds upper case onto lower case in one OR; the few non-letters it also folds are weeded out by the
+ *  full comparison.
+ */
+typedef struct CBPStringSearchFilter
+{
+    uint8_t mask;
+    uint8_t value;
+} CBPStringSearchFilter;
+
+NS_INLINE uint8_t CBPStringSearchFold(uint8_t byte)
+{
+    return (byte >= 'A' && byte <= 'Z') ? byte | 0x20 : byte;
+}
+
+NS_INLINE CBPStringSearchFilter CBPStringSearchFilterMake(uint8_t byte, BOOL caseInsensitive)
+{
+    uint8_t folded = CBPStringSearchFold(byte);
+    BOOL isLetter = folded >= 'a' && folded <= 'z';
+
+    return (CBPStringSearchFilter){ .mask = (caseInsensitive && isLetter) ? 0x20 : 0x00, .value = (caseInsensitive && isLetter) ? folded : byte };
+}
+
+static BOOL CBPStringSearchEqual(const uint8_t *bytes, const uint8_t *needle, NSUInteger length, BOOL caseInsensitive)
+{
+    if (!caseInsensitive)
+    {
+        return memcmp(bytes, needle, length) == 0;
+    }
+
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        if (CBPStringSearchFold(bytes[i]) != CBPStringSearchFold(needle[i]))
+        {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+static NSUInteger CBPStringSearchScalar(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, BOOL caseInsensitive, NSUInteger start)
+{
+    CBPStringSearchFilter first = CBPStringSearchFilterMake(needle[0], caseInsensitive);
+    CBPStringSearchFilter last = CBPStringSearchFilterMake(needle[needleLength - 1], caseInsensitive);
+    NSUInteger end = haystackLength - needleLength;
+
+    for (NSUInteger i = start; i <= end; i++)
+    {
+        if (!caseInsensitive)
+        {
+            //-------------------------------------------------------------------
+            // memchr is vectorized by libc; skip straight to the next
+            // candidate.
+            //-------------------------------------------------------------------
+            const uint8_t *candidate = memchr(haystack + i, needle[0], end - i + 1);
+
+            if (!candidate)
+            {
+                break;
+            }
+
+            i = (NSUInteger)(candidate - haystack);
+        }
+        else if ((haystack[i] | first.mask) != first.value)
+        {
+            continue;
+        }
+
+        if ((haystack[i + needleLength - 1] | last.mask) == last.value && CBPStringSearchEqual(haystack + i, needle, needleLength, caseInsensitive))
+        {
+            return i;
+        }
+    }
+
+    return NSNotFound;
+}
+
+#if CBP_STRING_SEARCH_X86
+
+static NSUInteger CBPStringSearchSSE2(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, BOOL caseInsensitive)
+{
+    CBPStringSearchFilter first = CBPStringSearchFilterMake(needle[0], caseInsensitive);
+    CBPStringSearchFilter last = CBPStringSearchFilterMake(needle[needleLength - 1], caseInsensitive);
+
+    __m128i firstMask = _mm_set1_epi8((char)first.mask);
+    __m128i firstValue = _mm_set1_epi8((char)first.value);
+    __m128i lastMask = _mm_set1_epi8((char)last.mask);
+    __m128i lastValue = _mm_set1_epi8((char)last.value);
+
+    NSUInteger i = 0;
+
+    for (; i + needleLength - 1 + 16 <= haystackLength; i += 16)
+    {
+        __m128i firstBlock = _mm_loadu_si128((const __m128i *)(const void *)(haystack + i));
+        __m128i lastBlock = _mm_loadu_si128((const __m128i *)(const void *)(haystack + i + needleLength - 1));
+
+        __m128i firstMatches = _mm_cmpeq_epi8(_mm_or_si128(firstBlock, firstMask), firstValue);
+        __m128i lastMatches = _mm_cmpeq_epi8(_mm_or_si128(lastBlock, lastMask), lastValue);
+
+        unsigned int candidates = (unsigned int)_mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+
+        while (candidates)
+        {
+            NSUInteger candidate = i + (NSUInteger)__builtin_ctz(candidates);
+
+            if (CBPStringSearchEqual(haystack + candidate, needle, needleLength, caseInsensitive))
+            {
+                return candidate;
+            }
+
+            candidates &= candidates - 1;
+        }
+    }
+
+    return CBPStringSearchScalar(haystack, haystackLength, needle, needleLength, caseInsensitive, i);
+}
+
+__attribute__((target("avx2")))
+static NSUInteger CBPStringSearchAVX2(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, BOOL caseInsensitive)
+{
+    CBPStringSearchFilter first = CBPStringSearchFilterMake(needle[0], caseInsensitive);
+    CBPStringSearchFilter last = CBPStringSearchFilterMake(needle[needleLength - 1], caseInsensitive);
+
+    __m256i firstMask = _mm256_set1_epi8((char)first.mask);
+    __m256i firstValue = _mm256_set1_epi8((char)first.value);
+    __m256i lastMask = _mm256_set1_epi8((char)last.mask);
+    __m256i lastValue = _mm256_set1_epi8((char)last.value);
+
+    NSUInteger i = 0;
+
+    for (; i + needleLength - 1 + 32 <= haystackLength; i += 32)
+    {
+        __m256i firstBlock = _mm256_loadu_si256((const __m256i *)(const void *)(haystack + i));
+        __m256i lastBlock = _mm256_loadu_si256((const __m256i *)(const void *)(haystack + i + needleLength - 1));
+
+        __m256i firstMatches = _mm256_cmpeq_epi8(_mm256_or_si256(firstBlock, firstMask), firstValue);
+        __m256i lastMatches = _mm256_cmpeq_epi8(_mm256_or_si256(lastBlock, lastMask), lastValue);
+
+        unsigned int candidates = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(firstMatches, lastMatches));
+
+        while (candidates)
+        {
+            NSUInteger candidate = i + (NSUInteger)__builtin_ctz(candidates);
+
+            if (CBPStringSearchEqual(haystack + candidate, needle, needleLength, caseInsensitive))
+            {
+                return candidate;
+            }
+
+            candidates &= candidates - 1;
+        }
+    }
+
+    return CBPStringSearchScalar(haystack, haystackLength, needle, needleLength, caseInsensitive, i);
+}
+
+#elif CBP_STRING_SEARCH_NEON
+
+static NSUInteger CBPStringSearchNEON(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, BOOL caseInsensitive)
+{
+    CBPStringSearchFilter first = CBPStringSearchFilterMake(needle[0], caseInsensitive);
+    CBPStringSearchFilter last = CBPStringSearchFilterMake(needle[needleLength - 1], caseInsensitive);
+
+    uint8x16_t firstMask = vdupq_n_u8(first.mask);
+    uint8x16_t firstValue = vdupq_n_u8(first.value);
+    uint8x16_t lastMask = vdupq_n_u8(last.mask);
+    uint8x16_t lastValue = vdupq_n_u8(last.value);
+
+    NSUInteger i = 0;
+
+    for (; i + needleLength - 1 + 16 <= haystackLength; i += 16)
+    {
+        uint8x16_t firstMatches = vceqq_u8(vorrq_u8(vld1q_u8(haystack + i), firstMask), firstValue);
+        uint8x16_t lastMatches = vceqq_u8(vorrq_u8(vld1q_u8(haystack + i + needleLength - 1), lastMask), lastValue);
+
+        //-------------------------------------------------------------------
+        // NEON has no movemask; narrowing each 16-bit lane by 4 leaves one
+        // nibble per byte instead.
+        //-------------------------------------------------------------------
+        uint64_t candidates = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vandq_u8(firstMatches, lastMatches)), 4)), 0);
+
+        while (candidates)
+        {
+            NSUInteger candidate = i + (NSUInteger)(__builtin_ctzll(candidates) >> 2);
+
+            if (CBPStringSearchEqual(haystack + candidate, needle, needleLength, caseInsensitive))
+            {
+                return candidate;
+            }
+
+            candidates &= ~(0xFULL << ((candidate - i) << 2));
+        }
+    }
+
+    return CBPStringSearchScalar(haystack, haystackLength, needle, needleLength, caseInsensitive, i);
+}
+
+#endif
+
+NSUInteger CBPStringSearchFind(const uint8_t *haystack, NSUInteger haystackLength, const uint8_t *needle, NSUInteger needleLength, CBPStringSearchOptions options)
+{
+    if (!needleLength || needleLength > haystackLength)
+    {
+        return NSNotFound;
+    }
+
+    BOOL caseInsensitive = (options & CBPStringSearchCaseInsensitive) != 0;
+
+#if CBP_STRING_SEARCH_X86
+    static BOOL hasAVX2;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        hasAVX2 = __builtin_cpu_supports("avx2") ? YES : NO;
+    });
+
+    return hasAVX2 ? CBPStringSearchAVX2(haystack, haystackLength, needle, needleLength, caseInsensitive) : CBPStringSearchSSE2(haystack, haystackLength, needle, needleLength, caseInsensitive);
+#elif CBP_STRING_SEARCH_NEON
+    return CBPStringSearchNEON(haystack, haystackLength, needle, needleLength, caseInsensitive);
+#else
+    return CBPStringSearchScalar(haystack, haystackLength, needle, needleLength, caseInsensitive, 0);
+#endif
+}
+
+BOOL CBPStringSearchIsASCII(const uint8_t *bytes, NSUInteger length)
+{
+    //-------------------------------------------------------------------
+    // A word at a time; compilers vectorize this loop further.
+    //-------------------------------------------------------------------
+    uint64_t highBits = 0;
+    NSUInteger i = 0;
+
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        highBits |= word;
+    }
+
+    for (; i < length; i++)
+    {
+        highBits |= bytes[i];
+    }
+
+    return (highBits & 0x8080808080808080ULL) == 0;
+}
@@ -0,0 +1,98 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+typedef NS_ENUM(NSInteger, CBPThreadSchedulingPolicy)
+{
+    /**
+     *  The system's default time sharing policy.
+     */
+    CBPThreadSchedulingPolicyDefault,
+
+    /**
+     *  SCHED_FIFO. The thread runs until it blocks or a higher priority thread becomes runnable.
+     */
+    CBPThreadSchedulingPolicyFIFO,
+
+    /**
+     *  SCHED_RR. Like SCHED_FIFO, but threads of equal priority share the processor in time slices.
+     */
+    CBPThreadSchedulingPolicyRoundRobin,
+};
+
+/**
+ *  Describes how a thread should be created and scheduled: its name, stack size, scheduling policy, nice level and the processors it may run on.
+ *
+ *  The name and stack size must be set before a thread starts, with @p -prepareThread:; the rest is applied by the thread itself, with @p -applyToCurrentThread:. Processor sets are enforced with pthread_setaffinity_np on Linux. Darwin has no hard affinity, so there the first processor in the set becomes a thread affinity tag, which macOS uses as a placement hint and iOS does not support.
+ */
+@interface CBPThreadConfiguration : NSObject <NSCopying>
+
+/**
+ *  The thread's name, or nil to leave it unnamed.
+ */
+@property (copy) NSString *name;
+
+/**
+ *  The thread's stack size in bytes, rounded up to a multiple of 4 KB, or 0 for the system default.
+ */
+@property NSUInteger stackSize;
+
+/**
+ *  The thread's scheduling policy. Realtime policies usually require elevated privileges.
+ */
+@property CBPThreadSchedulingPolicy schedulingPolicy;
+
+/**
+ *  The thread's priority under a realtime scheduling policy, clamped to the range the policy allows. Ignored by CBPThreadSchedulingPolicyDefault.
+ */
+@property int schedulingPriority;
+
+/**
+ *  The thread's nice level under CBPThreadSchedulingPolicyDefault, from -20 (most favorable) to 19, or 0 to keep the level the thread inherited. Lowering a thread's nice level usually requires elevated privileges. Applied with setpriority on Linux, where nice levels are per thread; Darwin has no per-thread nice level, so it is ignored there.
+ */
+@property int niceLevel;
+
+/**
+ *  The indexes of the processors the thread may run on, or nil for any processor.
+ */
+@property (copy) NSIndexSet *processors;
+
+/**
+ *  Applies the name and stack size to a thread that has not been started yet.
+ *
+ *  @param thread The thread to prepare.
+ */
+- (void)prepareThread:(NSThread *)thread;
+
+/**
+ *  Applies the scheduling policy, nice level and processor set to the calling thread. Each is attempted even if an earlier one fails, so a thread that may not use a realtime policy is still pinned to its processors.
+ *
+ *  @param error On failure, the first error encountered, in NSPOSIXErrorDomain or NSMachErrorDomain.
+ *
+ *  @return YES if everything was applied.
+ */
+- (BOOL)applyToCurrentThread:(NSError **)error;
+
+@end
@@ -0,0 +1,152 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#import "CBPThreadConfiguration.h"
+#import <pthread.h>
+#import <sched.h>
+
+#if defined(__linux__)
+#import <sys/resource.h>
+#import <sys/syscall.h>
+#import <unistd.h>
+#endif
+
+#if defined(__APPLE__)
+#import <mach/mach.h>
+#import <mach/thread_policy.h>
+#endif
+
+#define CBPThreadConfigurationStackSizeGranularity 4096
+
+@implementation CBPThreadConfiguration
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    CBPThreadConfiguration *configuration = [[[self class] allocWithZone:zone] init];
+    configuration.name = self.name;
+    configuration.stackSize = self.stackSize;
+    configuration.schedulingPolicy = self.schedulingPolicy;
+    configuration.schedulingPriority = self.schedulingPriority;
+    configuration.niceLevel = self.niceLevel;
+    configuration.processors = self.processors;
+    return configuration;
+}
+
+- (void)prepareThread:(NSThread *)thread
+{
+    if (self.name)
+    {
+        thread.name = self.name;
+    }
+
+    if (self.stackSize)
+    {
+        NSUInteger granularity = CBPThreadConfigurationStackSizeGranularity;
+        thread.stackSize = (self.stackSize + granularity - 1) / granularity * granularity;
+    }
+}
+
+- (BOOL)applyToCurrentThread:(NSError **)error
+{
+    //-------------------------------------------------------------------
+    // Each setting is attempted even if an earlier one failed; an
+    // unprivileged thread that can't use SCHED_FIFO can still be pinned.
+    //-------------------------------------------------------------------
+    NSError *firstError = nil;
+
+    if (self.schedulingPolicy != CBPThreadSchedulingPolicyDefault)
+    {
+        int policy = self.schedulingPolicy == CBPThreadSchedulingPolicyFIFO ? SCHED_FIFO : SCHED_RR;
+        struct sched_param parameters = { .sched_priority = MIN(MAX(self.schedulingPriority, sched_get_priority_min(policy)), sched_get_priority_max(policy)) };
+        int result = pthread_setschedparam(pthread_self(), policy, &parameters);
+
+        if (result)
+        {
+            firstError = [NSError errorWithDomain:NSPOSIXErrorDomain code:result userInfo:nil];
+        }
+    }
+#if defined(__linux__)
+    else if (self.niceLevel)
+    {
+        //-------------------------------------------------------------------
+        // Linux applies PRIO_PROCESS to a single thread when given its
+        // thread id rather than the process id.
+        //-------------------------------------------------------------------
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), MIN(MAX(self.niceLevel, -20), 19)))
+        {
+            firstError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+    }
+#endif
+
+    NSIndexSet *processors = self.processors;
+
+    if ([processors count])
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        [processors enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+
+            if (index < CPU_SETSIZE)
+            {
+                CPU_SET(index, &set);
+            }
+
+        }];
+
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        if (result && !firstError)
+        {
+            firstError = [NSError errorWithDomain:NSPOSIXErrorDomain code:result userInfo:nil];
+        }
+#elif defined(__APPLE__)
+        //-------------------------------------------------------------------
+        // Tag 0 means no affinity, so processor n becomes tag n + 1.
+        //-------------------------------------------------------------------
+        thread_affinity_policy_data_t policy = { .affinity_tag = (integer_t)[processors firstIndex] + 1 };
+        kern_return_t result = thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+
+        if (result != KERN_SUCCESS && !firstError)
+        {
+            firstError = [NSError errorWithDomain:NSMachErrorDomain code:result userInfo:nil];
+        }
+#endif
+    }
+
+    if (firstError && error)
+    {
+        *error = firstError;
+    }
+
+    return !firstError;
+}
+
+@end
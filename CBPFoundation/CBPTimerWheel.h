@@ -0,0 +1,103 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+
+@class CBPThreadConfiguration;
+
+/**
+ *  An opaque handle to a scheduled timeout.
+ */
+typedef struct CBPTimerWheelEntry *CBPTimerWheelTimeout;
+
+/**
+ *  A hashed hierarchical timer wheel. Scheduling and cancelling a timeout are O(1) and lock-free on the calling thread; a single wheel thread advances the wheel one tick at a time and fires every timeout that expired during a tick as one batch.
+ *
+ *  Timeouts are accurate to within one tick. The wheel covers 2^32 ticks; longer timeouts are clamped.
+ */
+@interface CBPTimerWheel : NSObject
+
+/**
+ *  Returns the shared timer wheel, which ticks every 10 milliseconds.
+ *
+ *  @return The shared timer wheel.
+ */
++ (instancetype)sharedTimerWheel;
+
+/**
+ *  Sets the configuration for the shared timer wheel's thread, which CBPPromise timeouts fire on. This must be called before the shared timer wheel is first used or an exception will be thrown. A configuration that can't be applied is logged and recorded in the thread's @p cbp_configurationError.
+ *
+ *  @param threadConfiguration The configuration, or nil for the defaults.
+ */
++ (void)setSharedTimerWheelThreadConfiguration:(CBPThreadConfiguration *)threadConfiguration;
+
+/**
+ *  Initializes a timer wheel and starts its thread.
+ *
+ *  @param tickInterval The tick granularity. This value must be greater than 0 or an exception will be thrown.
+ *
+ *  @return An initialized timer wheel.
+ */
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval;
+
+/**
+ *  Initializes a timer wheel and starts its thread with @p threadConfiguration.
+ *
+ *  @param tickInterval        The tick granularity. This value must be greater than 0 or an exception will be thrown.
+ *  @param threadConfiguration The configuration for the wheel's thread, or nil for the defaults.
+ *
+ *  @return An initialized timer wheel.
+ */
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval threadConfiguration:(CBPThreadConfiguration *)threadConfiguration;
+
+/**
+ *  The tick granularity of the wheel.
+ */
+@property (readonly) NSTimeInterval tickInterval;
+
+/**
+ *  Schedules a block to be performed on the wheel's thread once @p timeout has elapsed. Blocks should be short; every timeout that expires in the same tick shares the thread.
+ *
+ *  @param timeout The timeout.
+ *  @param block   The block to perform.
+ *
+ *  @return A handle which must be passed to @p -cancelTimeout: exactly once, whether or not the timeout has fired.
+ */
+- (CBPTimerWheelTimeout)scheduleTimeout:(NSTimeInterval)timeout block:(dispatch_block_t)block;
+
+/**
+ *  Cancels a timeout and releases its handle.
+ *
+ *  @param timeout A handle returned by @p -scheduleTimeout:block:.
+ *
+ *  @return YES if the timeout was cancelled before it fired; otherwise, NO.
+ */
+- (BOOL)cancelTimeout:(CBPTimerWheelTimeout)timeout;
+
+/**
+ *  Stops the wheel's thread. Timeouts that have not fired are discarded. The shared timer wheel cannot be invalidated.
+ */
+- (void)invalidate;
+
+@end
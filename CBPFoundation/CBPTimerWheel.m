@@ -0,0 +1,518 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPTimerWheel.h"
+#import "CBPThreadConfiguration.h"
+#import "NSThread+CBPExtensions.h"
+#import "CBPTime.h"
+#import <stdatomic.h>
+
+#define CBPTimerWheelLevelBits  8
+#define CBPTimerWheelLevelSize  (1 << CBPTimerWheelLevelBits)
+#define CBPTimerWheelLevelMask  (CBPTimerWheelLevelSize - 1)
+#define CBPTimerWheelLevelCount 4
+#define CBPTimerWheelMaxTicks   0xffffffffull
+
+typedef NS_ENUM(uint32_t, CBPTimerWheelEntryState)
+{
+    CBPTimerWheelEntryStateArmed,
+    CBPTimerWheelEntryStateFired,
+    CBPTimerWheelEntryStateCancelled,
+};
+
+/*
+ *  An entry is referenced once by the wheel and once by the handle returned to the caller. A caller that wins the race
+ *  to cancel hands its reference to the cancelled inbox, so the wheel thread is the only one that ever unlinks an entry.
+ */
+struct CBPTimerWheelEntry
+{
+    struct CBPTimerWheelEntry *next;          /* Slot list, wheel thread only. */
+    struct CBPTimerWheelEntry *previous;      /* Slot list, wheel thread only. */
+    struct CBPTimerWheelEntry **slot;         /* Slot list, wheel thread only. */
+    struct CBPTimerWheelEntry *scheduledNext; /* Scheduled inbox. */
+    struct CBPTimerWheelEntry *cancelledNext; /* Cancelled inbox. */
+    uint64_t deadline;
+    _Atomic(uint32_t) state;
+    _Atomic(uint32_t) references;
+    BOOL linked;
+    void *block;
+};
+
+typedef struct CBPTimerWheelSlots
+{
+    struct CBPTimerWheelEntry *slots[CBPTimerWheelLevelCount][CBPTimerWheelLevelSize];
+    uint64_t nextTick;
+    NSUInteger count;
+} CBPTimerWheelSlots;
+
+static void CBPTimerWheelEntryRelease(struct CBPTimerWheelEntry *entry)
+{
+    if (atomic_fetch_sub_explicit(&entry->references, 1, memory_order_acq_rel) == 1)
+    {
+        free(entry);
+    }
+}
+
+static void CBPTimerWheelEntryReleaseBlock(struct CBPTimerWheelEntry *entry)
+{
+    (void)(__bridge_transfer dispatch_block_t)entry->block;
+    entry->block = NULL;
+}
+
+#pragma mark - Wheel thread only
+
+static void CBPTimerWheelLink(CBPTimerWheelSlots *wheel, struct CBPTimerWheelEntry *entry)
+{
+    uint64_t expires = entry->deadline;
+    int64_t delta = (int64_t)(expires - wheel->nextTick);
+    NSUInteger level = 0;
+
+    if (delta < 0)
+    {
+        //-------------------------------------------------------------------
+        // Already expired; fire it with the next tick.
+        //-------------------------------------------------------------------
+        expires = wheel->nextTick;
+    }
+    else
+    {
+        if ((uint64_t)delta > CBPTimerWheelMaxTicks)
+        {
+            delta = (int64_t)CBPTimerWheelMaxTicks;
+            expires = wheel->nextTick + CBPTimerWheelMaxTicks;
+        }
+
+        while (level + 1 < CBPTimerWheelLevelCount && (uint64_t)delta >= (1ull << (CBPTimerWheelLevelBits * (level + 1))))
+        {
+            level++;
+        }
+    }
+
+    struct CBPTimerWheelEntry **slot = &wheel->slots[level][(expires >> (CBPTimerWheelLevelBits * level)) & CBPTimerWheelLevelMask];
+
+    entry->slot = slot;
+    entry->previous = NULL;
+    entry->next = *slot;
+
+    if (*slot)
+    {
+        (*slot)->previous = entry;
+    }
+
+    *slot = entry;
+    entry->linked = YES;
+    wheel->count++;
+}
+
+static void CBPTimerWheelUnlink(CBPTimerWheelSlots *wheel, struct CBPTimerWheelEntry *entry)
+{
+    if (entry->previous)
+    {
+        entry->previous->next = entry->next;
+    }
+    else
+    {
+        *entry->slot = entry->next;
+    }
+
+    if (entry->next)
+    {
+        entry->next->previous = entry->previous;
+    }
+
+    entry->next = NULL;
+    entry->previous = NULL;
+    entry->slot = NULL;
+    entry->linked = NO;
+    wheel->count--;
+}
+
+/*
+ *  Moves every entry in a slot of a higher level down to the level that now matches its remaining time.
+ */
+static void CBPTimerWheelCascade(CBPTimerWheelSlots *wheel, NSUInteger level, NSUInteger index)
+{
+    struct CBPTimerWheelEntry *entry = wheel->slots[level][index];
+    wheel->slots[level][index] = NULL;
+
+    while (entry)
+    {
+        struct CBPTimerWheelEntry *next = entry->next;
+
+        entry->linked = NO;
+        wheel->count--;
+        CBPTimerWheelLink(wheel, entry);
+
+        entry = next;
+    }
+}
+
+/*
+ *  Advances the wheel through @p tick, inclusive, and returns every entry that expired as a list linked through @p next.
+ */
+static struct CBPTimerWheelEntry *CBPTimerWheelAdvance(CBPTimerWheelSlots *wheel, uint64_t tick)
+{
+    struct CBPTimerWheelEntry *expired = NULL;
+    struct CBPTimerWheelEntry **tail = &expired;
+
+    while (wheel->nextTick <= tick)
+    {
+        NSUInteger index = wheel->nextTick & CBPTimerWheelLevelMask;
+
+        if (index == 0)
+        {
+            for (NSUInteger level = 1; level < CBPTimerWheelLevelCount; level++)
+            {
+                NSUInteger levelIndex = (wheel->nextTick >> (CBPTimerWheelLevelBits * level)) & CBPTimerWheelLevelMask;
+                CBPTimerWheelCascade(wheel, level, levelIndex);
+
+                if (levelIndex != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        wheel->nextTick++;
+
+        struct CBPTimerWheelEntry *entry = wheel->slots[0][index];
+
+        while (entry)
+        {
+            struct CBPTimerWheelEntry *next = entry->next;
+
+            CBPTimerWheelUnlink(wheel, entry);
+            *tail = entry;
+            tail = &entry->next;
+
+            entry = next;
+        }
+    }
+
+    return expired;
+}
+
+#pragma mark -
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPTimerWheel
+{
+    CBPTimerWheelSlots _wheel;
+    _Atomic(struct CBPTimerWheelEntry *) _scheduled;
+    _Atomic(struct CBPTimerWheelEntry *) _cancelled;
+    _Atomic(BOOL) _sleeping;
+    _Atomic(BOOL) _invalidated;
+    dispatch_semaphore_t _semaphore;
+    uint64_t _startTime;
+    uint64_t _tickNanoseconds;
+}
+
+static CBPThreadConfiguration *CBPTimerWheelSharedThreadConfiguration = nil;
+static BOOL CBPTimerWheelSharedTimerWheelCreated = NO;
+
++ (instancetype)sharedTimerWheel
+{
+    static CBPTimerWheel *sharedTimerWheel = nil;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+
+        CBPThreadConfiguration *threadConfiguration = nil;
+
+        @synchronized ([CBPTimerWheel class])
+        {
+            CBPTimerWheelSharedTimerWheelCreated = YES;
+            threadConfiguration = CBPTimerWheelSharedThreadConfiguration;
+        }
+
+        sharedTimerWheel = [[self alloc] initWithTickInterval:0.01 threadConfiguration:threadConfiguration];
+    });
+
+    return sharedTimerWheel;
+}
+
++ (void)setSharedTimerWheelThreadConfiguration:(CBPThreadConfiguration *)threadConfiguration
+{
+    @synchronized ([CBPTimerWheel class])
+    {
+        if (CBPTimerWheelSharedTimerWheelCreated)
+        {
+            [NSException raise:NSInternalInconsistencyException format:@"The shared timer wheel has already been created. %s", __PRETTY_FUNCTION__];
+        }
+
+        CBPTimerWheelSharedThreadConfiguration = [threadConfiguration copy];
+    }
+}
+
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval
+{
+    return [self initWithTickInterval:tickInterval threadConfiguration:nil];
+}
+
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval threadConfiguration:(CBPThreadConfiguration *)threadConfiguration
+{
+    if (tickInterval <= 0)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"A CBPTimerWheel tick interval must be greater than 0."];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        _tickInterval = tickInterval;
+        _tickNanoseconds = MAX((uint64_t)(tickInterval * NSEC_PER_SEC), 1);
+        _startTime = CBPMonotonicNanoseconds();
+        _semaphore = dispatch_semaphore_create(0);
+        atomic_init(&_scheduled, NULL);
+        atomic_init(&_cancelled, NULL);
+        atomic_init(&_sleeping, NO);
+        atomic_init(&_invalidated, NO);
+
+        NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(_runWithThreadConfiguration:) object:[threadConfiguration copy]];
+        thread.name = @"CBPTimerWheel";
+        [threadConfiguration prepareThread:thread];
+        [thread start];
+    }
+
+    return self;
+}
+
+- (CBPTimerWheelTimeout)scheduleTimeout:(NSTimeInterval)timeout block:(dispatch_block_t)block
+{
+    struct CBPTimerWheelEntry *entry = calloc(1, sizeof(struct CBPTimerWheelEntry));
+
+    uint64_t timeoutNanoseconds = (uint64_t)(MIN(MAX(timeout, 0), 1e9) * NSEC_PER_SEC);
+    uint64_t elapsed = CBPMonotonicNanoseconds() - _startTime + timeoutNanoseconds;
+
+    entry->deadline = (elapsed + _tickNanoseconds - 1) / _tickNanoseconds;
+    entry->block = (__bridge_retained void *)[block copy];
+    atomic_init(&entry->state, CBPTimerWheelEntryStateArmed);
+    atomic_init(&entry->references, 2);
+
+    struct CBPTimerWheelEntry *head = atomic_load_explicit(&_scheduled, memory_order_relaxed);
+
+    do
+    {
+        entry->scheduledNext = head;
+    }
+    while (!atomic_compare_exchange_weak(&_scheduled, &head, entry));
+
+    [self _wake];
+
+    return entry;
+}
+
+- (BOOL)cancelTimeout:(CBPTimerWheelTimeout)timeout
+{
+    uint32_t expected = CBPTimerWheelEntryStateArmed;
+
+    if (atomic_compare_exchange_strong(&timeout->state, &expected, CBPTimerWheelEntryStateCancelled))
+    {
+        CBPTimerWheelEntryReleaseBlock(timeout);
+
+        struct CBPTimerWheelEntry *head = atomic_load_explicit(&_cancelled, memory_order_relaxed);
+
+        do
+        {
+            timeout->cancelledNext = head;
+        }
+        while (!atomic_compare_exchange_weak(&_cancelled, &head, timeout));
+
+        [self _wake];
+
+        return YES;
+    }
+    else
+    {
+        CBPTimerWheelEntryRelease(timeout);
+
+        return NO;
+    }
+}
+
+- (void)invalidate
+{
+    if (self != [[self class] sharedTimerWheel])
+    {
+        atomic_store(&_invalidated, YES);
+        dispatch_semaphore_signal(_semaphore);
+    }
+}
+
+#pragma mark -
+
+- (void)_wake
+{
+    if (atomic_exchange(&_sleeping, NO))
+    {
+        dispatch_semaphore_signal(_semaphore);
+    }
+}
+
+- (uint64_t)_currentTick
+{
+    return (CBPMonotonicNanoseconds() - _startTime) / _tickNanoseconds;
+}
+
+- (void)_runWithThreadConfiguration:(CBPThreadConfiguration *)threadConfiguration
+{
+    [NSThread cbp_applyConfigurationToCurrentThread:threadConfiguration];
+
+    while (!atomic_load(&_invalidated))
+    {
+        @autoreleasepool
+        {
+            uint64_t tick = [self _currentTick];
+
+            //-------------------------------------------------------------------
+            // An empty wheel may have slept through any number of ticks, so
+            // skip straight to now instead of stepping through them.
+            //-------------------------------------------------------------------
+            if (!_wheel.count)
+            {
+                _wheel.nextTick = tick;
+            }
+
+            [self _drainInboxes];
+
+            struct CBPTimerWheelEntry *entry = CBPTimerWheelAdvance(&_wheel, tick);
+
+            while (entry)
+            {
+                struct CBPTimerWheelEntry *next = entry->next;
+                uint32_t expected = CBPTimerWheelEntryStateArmed;
+
+                if (atomic_compare_exchange_strong(&entry->state, &expected, CBPTimerWheelEntryStateFired))
+                {
+                    ((__bridge dispatch_block_t)entry->block)();
+                    CBPTimerWheelEntryReleaseBlock(entry);
+                }
+
+                CBPTimerWheelEntryRelease(entry);
+                entry = next;
+            }
+
+            [self _sleep];
+        }
+    }
+
+    [self _discardEntries];
+}
+
+- (void)_drainInboxes
+{
+    struct CBPTimerWheelEntry *entry = atomic_exchange(&_scheduled, NULL);
+
+    while (entry)
+    {
+        struct CBPTimerWheelEntry *next = entry->scheduledNext;
+
+        if (atomic_load(&entry->state) == CBPTimerWheelEntryStateCancelled)
+        {
+            CBPTimerWheelEntryRelease(entry);
+        }
+        else
+        {
+            CBPTimerWheelLink(&_wheel, entry);
+        }
+
+        entry = next;
+    }
+
+    entry = atomic_exchange(&_cancelled, NULL);
+
+    while (entry)
+    {
+        struct CBPTimerWheelEntry *next = entry->cancelledNext;
+
+        if (entry->linked)
+        {
+            CBPTimerWheelUnlink(&_wheel, entry);
+            CBPTimerWheelEntryRelease(entry);
+        }
+
+        CBPTimerWheelEntryRelease(entry);
+        entry = next;
+    }
+}
+
+- (void)_sleep
+{
+    if (_wheel.count)
+    {
+        uint64_t nextTickTime = _startTime + _wheel.nextTick * _tickNanoseconds;
+        uint64_t now = CBPMonotonicNanoseconds();
+
+        if (nextTickTime > now)
+        {
+            dispatch_semaphore_wait(_semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(nextTickTime - now)));
+        }
+    }
+    else
+    {
+        //-------------------------------------------------------------------
+        // Publish that we're going to sleep before checking the inboxes one
+        // last time. A producer either sees the flag and signals, or we see
+        // its entry.
+        //-------------------------------------------------------------------
+        atomic_store(&_sleeping, YES);
+
+        if (!atomic_load(&_scheduled) && !atomic_load(&_cancelled) && !atomic_load(&_invalidated))
+        {
+            dispatch_semaphore_wait(_semaphore, DISPATCH_TIME_FOREVER);
+        }
+
+        atomic_store(&_sleeping, NO);
+    }
+}
+
+- (void)_discardEntries
+{
+    [self _drainInboxes];
+
+    for (NSUInteger level = 0; level < CBPTimerWheelLevelCount; level++)
+    {
+        for (NSUInteger index = 0; index < CBPTimerWheelLevelSize; index++)
+        {
+            while (_wheel.slots[level][index])
+            {
+                struct CBPTimerWheelEntry *entry = _wheel.slots[level][index];
+                uint32_t expected = CBPTimerWheelEntryStateArmed;
+
+                CBPTimerWheelUnlink(&_wheel, entry);
+
+                if (atomic_compare_exchange_strong(&entry->state, &expected, CBPTimerWheelEntryStateCancelled))
+                {
+                    CBPTimerWheelEntryReleaseBlock(entry);
+                }
+
+                CBPTimerWheelEntryRelease(entry);
+            }
+        }
+    }
+}
+
+@end
@@ -0,0 +1,164 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import "CBPFuture.h"
+
+/**
+ *  The largest result a CBPStructFuture can hold.
+ */
+#define CBPStructFutureMaximumSize 64
+
+typedef int64_t (^CBPInt64FutureWorkBlock)(CBPFutureCanceledBlock isCanceled);
+
+typedef double (^CBPDoubleFutureWorkBlock)(CBPFutureCanceledBlock isCanceled);
+
+/**
+ *  Compute the value of a CBPStructFuture.
+ *
+ *  @param result     Zero-filled storage for the result, as large as the future's type and aligned for any scalar.
+ *  @param isCanceled A convenience block to determine if the future is canceled or not.
+ */
+typedef void (^CBPStructFutureWorkBlock)(void *result, CBPFutureCanceledBlock isCanceled);
+
+/*
+ *  Futures whose results are stored inline instead of as objects. Completing one and reading its result with the typed
+ *  accessors allocates nothing. The object API still works: @p -deref, callbacks and continuations receive the result
+ *  boxed in an NSNumber or NSValue, allocated only when asked for.
+ *
+ *  The initializers inherited from CBPFuture throw an exception; use the typed initializers instead.
+ */
+
+#pragma mark -
+
+@interface CBPInt64Future : CBPFuture
+
+/**
+ *  Initializes and starts a new future.
+ *
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used.
+ *  @param cancellationToken A token that invalidates the future when cancelled. May be nil.
+ *  @param workBlock         The work block whose result will be computed in the background and stored. This value must not be nil or an exception will be thrown.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken int64WorkBlock:(CBPInt64FutureWorkBlock)workBlock;
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor int64WorkBlock:(CBPInt64FutureWorkBlock)workBlock;
+
+/**
+ *  Waits indefinitely until the future has been realized.
+ *
+ *  @return The result, or 0 if the future was invalidated.
+ */
+- (int64_t)derefInt64;
+
+/**
+ *  Blocks until the future has been realized, or the timeout has expired.
+ *
+ *  @return The result, 0 if the future was invalidated, or @p timeoutValue if it wasn't realized in the given time.
+ */
+- (int64_t)derefInt64WithTimeoutInterval:(NSTimeInterval)timeoutInterval timeoutValue:(int64_t)timeoutValue;
+
+@end
+
+#pragma mark -
+
+@interface CBPDoubleFuture : CBPFuture
+
+/**
+ *  Initializes and starts a new future.
+ *
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used.
+ *  @param cancellationToken A token that invalidates the future when cancelled. May be nil.
+ *  @param workBlock         The work block whose result will be computed in the background and stored. This value must not be nil or an exception will be thrown.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken doubleWorkBlock:(CBPDoubleFutureWorkBlock)workBlock;
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor doubleWorkBlock:(CBPDoubleFutureWorkBlock)workBlock;
+
+/**
+ *  Waits indefinitely until the future has been realized.
+ *
+ *  @return The result, or NAN if the future was invalidated.
+ */
+- (double)derefDouble;
+
+/**
+ *  Blocks until the future has been realized, or the timeout has expired.
+ *
+ *  @return The result, NAN if the future was invalidated, or @p timeoutValue if it wasn't realized in the given time.
+ */
+- (double)derefDoubleWithTimeoutInterval:(NSTimeInterval)timeoutInterval timeoutValue:(double)timeoutValue;
+
+@end
+
+#pragma mark -
+
+@interface CBPStructFuture : CBPFuture
+
+/**
+ *  Initializes and starts a new future.
+ *
+ *  @param objCType          The type of the result, as returned by @p @encode. It must remain valid for the life of the future, and the type must be no larger than @p CBPStructFutureMaximumSize or an exception will be thrown.
+ *  @param executor          The executor on which to perform the work. If nil, the default executor will be used.
+ *  @param cancellationToken A token that invalidates the future when cancelled. May be nil.
+ *  @param workBlock         The work block which writes the result. This value must not be nil or an exception will be thrown.
+ *
+ *  @return An initialized future.
+ */
+- (instancetype)initWithObjCType:(const char *)objCType executor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPStructFutureWorkBlock)workBlock;
+
+/**
+ *  The type of the result.
+ */
+@property (readonly) const char *objCType;
+
+/**
+ *  The size of the result in bytes.
+ */
+@property (readonly) NSUInteger size;
+
+/**
+ *  Waits indefinitely until the future has been realized.
+ *
+ *  @param value Storage of at least @p size bytes to copy the result into.
+ *
+ *  @return YES if the result was copied; NO if the future was invalidated.
+ */
+- (BOOL)derefValue:(void *)value;
+
+/**
+ *  Blocks until the future has been realized, or the timeout has expired.
+ *
+ *  @param value           Storage of at least @p size bytes to copy the result into.
+ *  @param timeoutInterval The amount of time to block.
+ *
+ *  @return YES if the result was copied; NO if the future was invalidated or wasn't realized in the given time.
+ */
+- (BOOL)derefValue:(void *)value timeoutInterval:(NSTimeInterval)timeoutInterval;
+
+@end
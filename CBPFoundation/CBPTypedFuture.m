@@ -0,0 +1,303 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPTypedFuture.h"
+#import "CBPFutureSubclass.h"
+
+typedef union CBPStructFutureStorage
+{
+    uint8_t bytes[CBPStructFutureMaximumSize];
+    long double alignment;
+} CBPStructFutureStorage;
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPInt64Future
+{
+    CBPInt64FutureWorkBlock _int64WorkBlock;
+    int64_t _int64Value;
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Use -initWithExecutor:cancellationToken:int64WorkBlock: instead. %s", __PRETTY_FUNCTION__];
+    return nil;
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor int64WorkBlock:(CBPInt64FutureWorkBlock)workBlock
+{
+    return [self initWithExecutor:executor cancellationToken:nil int64WorkBlock:workBlock];
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken int64WorkBlock:(CBPInt64FutureWorkBlock)workBlock
+{
+    if (!workBlock)
+    {
+        [NSException raise:NSInternalInconsistencyException format:@"workBlock must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super initForSubclassWithExecutor:executor cancellationToken:cancellationToken];
+
+    if (self)
+    {
+        _int64WorkBlock = [workBlock copy];
+        [self start];
+    }
+
+    return self;
+}
+
+- (int64_t)derefInt64
+{
+    return [self waitUntilRealized] == CBPDerefStateComplete ? _int64Value : 0;
+}
+
+- (int64_t)derefInt64WithTimeoutInterval:(NSTimeInterval)timeoutInterval timeoutValue:(int64_t)timeoutValue
+{
+    switch ([self waitUntilRealizedWithTimeoutInterval:timeoutInterval])
+    {
+        case CBPDerefStateComplete:
+            return _int64Value;
+        case CBPDerefStateInvalid:
+            return 0;
+        default:
+            return timeoutValue;
+    }
+}
+
+#pragma mark - CBPFutureSubclass methods
+
+- (void)performWork
+{
+    int64_t value = _int64WorkBlock(^BOOL {
+        return [self isCanceled];
+    });
+
+    _int64WorkBlock = nil;
+
+    [self assignValueUsingBlock:^{
+        self->_int64Value = value;
+    }];
+}
+
+- (void)discardWork
+{
+    _int64WorkBlock = nil;
+}
+
+- (id)boxedValue
+{
+    return @(_int64Value);
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPDoubleFuture
+{
+    CBPDoubleFutureWorkBlock _doubleWorkBlock;
+    double _doubleValue;
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Use -initWithExecutor:cancellationToken:doubleWorkBlock: instead. %s", __PRETTY_FUNCTION__];
+    return nil;
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor doubleWorkBlock:(CBPDoubleFutureWorkBlock)workBlock
+{
+    return [self initWithExecutor:executor cancellationToken:nil doubleWorkBlock:workBlock];
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken doubleWorkBlock:(CBPDoubleFutureWorkBlock)workBlock
+{
+    if (!workBlock)
+    {
+        [NSException raise:NSInternalInconsistencyException format:@"workBlock must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super initForSubclassWithExecutor:executor cancellationToken:cancellationToken];
+
+    if (self)
+    {
+        _doubleWorkBlock = [workBlock copy];
+        [self start];
+    }
+
+    return self;
+}
+
+- (double)derefDouble
+{
+    return [self waitUntilRealized] == CBPDerefStateComplete ? _doubleValue : NAN;
+}
+
+- (double)derefDoubleWithTimeoutInterval:(NSTimeInterval)timeoutInterval timeoutValue:(double)timeoutValue
+{
+    switch ([self waitUntilRealizedWithTimeoutInterval:timeoutInterval])
+    {
+        case CBPDerefStateComplete:
+            return _doubleValue;
+        case CBPDerefStateInvalid:
+            return NAN;
+        default:
+            return timeoutValue;
+    }
+}
+
+#pragma mark - CBPFutureSubclass methods
+
+- (void)performWork
+{
+    double value = _doubleWorkBlock(^BOOL {
+        return [self isCanceled];
+    });
+
+    _doubleWorkBlock = nil;
+
+    [self assignValueUsingBlock:^{
+        self->_doubleValue = value;
+    }];
+}
+
+- (void)discardWork
+{
+    _doubleWorkBlock = nil;
+}
+
+- (id)boxedValue
+{
+    return @(_doubleValue);
+}
+
+@end
+
+#pragma mark -
+
+@implementation CBPStructFuture
+{
+    CBPStructFutureWorkBlock _structWorkBlock;
+    CBPStructFutureStorage _storage;
+}
+
+- (instancetype)initWithExecutor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPFutureWorkBlock)workBlock
+{
+    [NSException raise:NSInternalInconsistencyException format:@"Use -initWithObjCType:executor:cancellationToken:workBlock: instead. %s", __PRETTY_FUNCTION__];
+    return nil;
+}
+
+- (instancetype)initWithObjCType:(const char *)objCType executor:(CBPExecutor *)executor cancellationToken:(CBPCancellationToken *)cancellationToken workBlock:(CBPStructFutureWorkBlock)workBlock
+{
+    NSUInteger size = 0;
+
+    if (!workBlock)
+    {
+        [NSException raise:NSInternalInconsistencyException format:@"workBlock must not be nil. %s", __PRETTY_FUNCTION__];
+    }
+    else if (!objCType)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"objCType must not be NULL. %s", __PRETTY_FUNCTION__];
+    }
+
+    NSGetSizeAndAlignment(objCType, &size, NULL);
+
+    if (size > CBPStructFutureMaximumSize)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"%s is %lu bytes; a CBPStructFuture holds at most %d. %s", objCType, (unsigned long)size, CBPStructFutureMaximumSize, __PRETTY_FUNCTION__];
+    }
+
+    self = [super initForSubclassWithExecutor:executor cancellationToken:cancellationToken];
+
+    if (self)
+    {
+        _objCType = objCType;
+        _size = size;
+        _structWorkBlock = [workBlock copy];
+        [self start];
+    }
+
+    return self;
+}
+
+- (BOOL)derefValue:(void *)value
+{
+    if ([self waitUntilRealized] != CBPDerefStateComplete)
+    {
+        return NO;
+    }
+
+    memcpy(value, _storage.bytes, _size);
+
+    return YES;
+}
+
+- (BOOL)derefValue:(void *)value timeoutInterval:(NSTimeInterval)timeoutInterval
+{
+    if ([self waitUntilRealizedWithTimeoutInterval:timeoutInterval] != CBPDerefStateComplete)
+    {
+        return NO;
+    }
+
+    memcpy(value, _storage.bytes, _size);
+
+    return YES;
+}
+
+#pragma mark - CBPFutureSubclass methods
+
+- (void)performWork
+{
+    //-------------------------------------------------------------------
+    // The work writes to the stack rather than straight into the future;
+    // only the thread that realizes it may touch the published storage.
+    //-------------------------------------------------------------------
+    CBPStructFutureStorage result;
+    memset(&result, 0, sizeof(result));
+
+    _structWorkBlock(result.bytes, ^BOOL {
+        return [self isCanceled];
+    });
+
+    _structWorkBlock = nil;
+
+    CBPStructFutureStorage *resultPointer = &result;
+
+    [self assignValueUsingBlock:^{
+        memcpy(self->_storage.bytes, resultPointer->bytes, self->_size);
+    }];
+}
+
+- (void)discardWork
+{
+    _structWorkBlock = nil;
+}
+
+- (id)boxedValue
+{
+    return [NSValue valueWithBytes:_storage.bytes objCType:_objCType];
+}
+
+@end
@@ -0,0 +1,78 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+@import Foundation;
+#import "CBPExecutor.h"
+
+/**
+ *  A fixed-size pool of worker threads with a deque per worker.
+ *
+ *  Blocks submitted from one of the executor's own workers are pushed onto that worker's deque and taken back in LIFO order, which keeps recursive fork/join work hot in cache. Blocks submitted from any other thread go to a shared FIFO queue. An idle worker first drains its own deque, then the shared queue, then steals the oldest block from another worker's deque.
+ */
+@interface CBPWorkStealingExecutor : CBPExecutor
+
+/**
+ *  Initializes an executor and starts its workers.
+ *
+ *  @param numberOfWorkers The number of worker threads. This value must be greater than 0 or an exception will be thrown.
+ *
+ *  @return An initialized executor.
+ */
+- (instancetype)initWithNumberOfWorkers:(NSUInteger)numberOfWorkers;
+
+/**
+ *  Returns the executor that owns the calling thread.
+ *
+ *  @return The executor, or nil if the calling thread isn't a worker.
+ */
++ (CBPWorkStealingExecutor *)currentExecutor;
+
+/**
+ *  Performs one queued block on the calling thread, which must be one of the executor's workers. A worker that has to block can use this to keep the pool busy while it waits. Nesting is capped, so this may return NO even if there is work queued.
+ *
+ *  @return YES if a block was performed; otherwise, NO.
+ */
+- (BOOL)performPendingBlock;
+
+/**
+ *  The number of worker threads.
+ */
+@property (readonly) NSUInteger numberOfWorkers;
+
+/**
+ *  The approximate number of blocks waiting to be performed.
+ */
+@property (readonly) NSUInteger queueDepth;
+
+/**
+ *  The number of blocks that have been stolen from one worker by another.
+ */
+@property (readonly) NSUInteger stealCount;
+
+/**
+ *  Stops the workers once every queued block has been performed. Blocks submitted afterwards are never performed. The default executor cannot be invalidated.
+ */
+- (void)invalidate;
+
+@end
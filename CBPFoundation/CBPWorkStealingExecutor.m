@@ -0,0 +1,479 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2014 Cameron Pulsford
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#import "CBPWorkStealingExecutor.h"
+#import <stdatomic.h>
+#import <pthread.h>
+
+/*
+ *  Each nested -performPendingBlock call adds a block's frames to the waiting worker's stack.
+ */
+static const NSUInteger CBPWorkStealingMaximumHelpingDepth = 32;
+
+#pragma mark - Deques
+
+/*
+ *  The deques are Chase-Lev deques, using the C11 orderings from Lê, Pop, Cohen and Zappa Nardelli, "Correct and
+ *  Efficient Work-Stealing for Weak Memory Models". Only the owning worker pushes and takes at the bottom; any thread
+ *  may steal from the top. Tasks are retained blocks.
+ */
+typedef struct CBPWorkStealingBuffer
+{
+    int64_t capacity;
+    struct CBPWorkStealingBuffer *retired;
+    _Atomic(void *) tasks[];
+} CBPWorkStealingBuffer;
+
+typedef struct CBPWorkStealingWorker
+{
+    _Alignas(64) _Atomic(int64_t) top;
+    _Alignas(64) _Atomic(int64_t) bottom;
+    _Atomic(CBPWorkStealingBuffer *) buffer;
+    __unsafe_unretained CBPWorkStealingExecutor *executor;
+    NSUInteger helpingDepth;
+    uint32_t seed;
+} CBPWorkStealingWorker;
+
+static CBPWorkStealingBuffer *CBPWorkStealingBufferCreate(int64_t capacity)
+{
+    CBPWorkStealingBuffer *buffer = calloc(1, sizeof(CBPWorkStealingBuffer) + (size_t)capacity * sizeof(_Atomic(void *)));
+    buffer->capacity = capacity;
+
+    return buffer;
+}
+
+static void CBPWorkStealingPush(CBPWorkStealingWorker *worker, void *task)
+{
+    int64_t bottom = atomic_load_explicit(&worker->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&worker->top, memory_order_acquire);
+    CBPWorkStealingBuffer *buffer = atomic_load_explicit(&worker->buffer, memory_order_relaxed);
+
+    if (bottom - top > buffer->capacity - 1)
+    {
+        //-------------------------------------------------------------------
+        // Thieves may still be reading the old buffer, so it is retired
+        // rather than freed and released along with the executor.
+        //-------------------------------------------------------------------
+        CBPWorkStealingBuffer *grownBuffer = CBPWorkStealingBufferCreate(buffer->capacity * 2);
+
+        for (int64_t i = top; i < bottom; i++)
+        {
+            void *movedTask = atomic_load_explicit(&buffer->tasks[i & (buffer->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&grownBuffer->tasks[i & (grownBuffer->capacity - 1)], movedTask, memory_order_relaxed);
+        }
+
+        grownBuffer->retired = buffer;
+        atomic_store_explicit(&worker->buffer, grownBuffer, memory_order_release);
+        buffer = grownBuffer;
+    }
+
+    atomic_store_explicit(&buffer->tasks[bottom & (buffer->capacity - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&worker->bottom, bottom + 1, memory_order_relaxed);
+}
+
+static void *CBPWorkStealingTake(CBPWorkStealingWorker *worker)
+{
+    int64_t bottom = atomic_load_explicit(&worker->bottom, memory_order_relaxed) - 1;
+    CBPWorkStealingBuffer *buffer = atomic_load_explicit(&worker->buffer, memory_order_relaxed);
+
+    atomic_store_explicit(&worker->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    int64_t top = atomic_load_explicit(&worker->top, memory_order_relaxed);
+    void *task = NULL;
+
+    if (top <= bottom)
+    {
+        task = atomic_load_explicit(&buffer->tasks[bottom & (buffer->capacity - 1)], memory_order_relaxed);
+
+        if (top == bottom)
+        {
+            //-------------------------------------------------------------------
+            // The last task; race any thieves for it.
+            //-------------------------------------------------------------------
+            if (!atomic_compare_exchange_strong_explicit(&worker->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+            {
+                task = NULL;
+            }
+
+            atomic_store_explicit(&worker->bottom, bottom + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&worker->bottom, bottom + 1, memory_order_relaxed);
+    }
+
+    return task;
+}
+
+static void *CBPWorkStealingSteal(CBPWorkStealingWorker *worker)
+{
+    int64_t top = atomic_load_explicit(&worker->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&worker->bottom, memory_order_acquire);
+
+    if (top < bottom)
+    {
+        CBPWorkStealingBuffer *buffer = atomic_load_explicit(&worker->buffer, memory_order_acquire);
+        void *task = atomic_load_explicit(&buffer->tasks[top & (buffer->capacity - 1)], memory_order_relaxed);
+
+        if (atomic_compare_exchange_strong_explicit(&worker->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        {
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+static int64_t CBPWorkStealingCount(CBPWorkStealingWorker *worker)
+{
+    int64_t count = atomic_load_explicit(&worker->bottom, memory_order_relaxed) - atomic_load_explicit(&worker->top, memory_order_relaxed);
+
+    return MAX(count, 0);
+}
+
+static pthread_key_t CBPWorkStealingCurrentWorkerKey(void)
+{
+    static pthread_key_t currentWorkerKey;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&currentWorkerKey, NULL);
+    });
+
+    return currentWorkerKey;
+}
+
+#pragma mark -
+
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+@implementation CBPWorkStealingExecutor
+{
+    CBPWorkStealingWorker *_workers;
+    pthread_mutex_t _injectedMutex;
+    void **_injected;
+    NSUInteger _injectedHead;
+    NSUInteger _injectedCapacity;
+    _Atomic(NSUInteger) _injectedCount;
+    _Atomic(NSUInteger) _idleWorkers;
+    _Atomic(NSUInteger) _stealCount;
+    _Atomic(BOOL) _invalidated;
+    dispatch_semaphore_t _semaphore;
+}
+
++ (CBPWorkStealingExecutor *)currentExecutor
+{
+    CBPWorkStealingWorker *worker = pthread_getspecific(CBPWorkStealingCurrentWorkerKey());
+
+    return worker ? worker->executor : nil;
+}
+
+- (instancetype)initWithNumberOfWorkers:(NSUInteger)numberOfWorkers
+{
+    if (!numberOfWorkers)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"A CBPWorkStealingExecutor must have at least one worker. %s", __PRETTY_FUNCTION__];
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        _numberOfWorkers = numberOfWorkers;
+        _semaphore = dispatch_semaphore_create(0);
+        pthread_mutex_init(&_injectedMutex, NULL);
+        _injectedCapacity = 64;
+        _injected = calloc(_injectedCapacity, sizeof(void *));
+        atomic_init(&_injectedCount, 0);
+        atomic_init(&_idleWorkers, 0);
+        atomic_init(&_stealCount, 0);
+        atomic_init(&_invalidated, NO);
+
+        void *workers = NULL;
+        posix_memalign(&workers, 64, numberOfWorkers * sizeof(CBPWorkStealingWorker));
+        memset(workers, 0, numberOfWorkers * sizeof(CBPWorkStealingWorker));
+        _workers = workers;
+
+        for (NSUInteger i = 0; i < numberOfWorkers; i++)
+        {
+            atomic_init(&_workers[i].top, 0);
+            atomic_init(&_workers[i].bottom, 0);
+            atomic_init(&_workers[i].buffer, CBPWorkStealingBufferCreate(256));
+            _workers[i].executor = self;
+            _workers[i].seed = (uint32_t)i * 2654435761u + 1;
+        }
+
+        for (NSUInteger i = 0; i < numberOfWorkers; i++)
+        {
+            NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(_runWorker:) object:@(i)];
+            thread.name = [NSString stringWithFormat:@"CBPWorkStealingExecutor worker %lu", (unsigned long)i];
+            [thread start];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _numberOfWorkers; i++)
+    {
+        void *task = NULL;
+
+        while ((task = CBPWorkStealingTake(&_workers[i])))
+        {
+            (void)(__bridge_transfer dispatch_block_t)task;
+        }
+
+        CBPWorkStealingBuffer *buffer = atomic_load(&_workers[i].buffer);
+
+        while (buffer)
+        {
+            CBPWorkStealingBuffer *retired = buffer->retired;
+            free(buffer);
+            buffer = retired;
+        }
+    }
+
+    for (NSUInteger i = 0; i < atomic_load(&_injectedCount); i++)
+    {
+        (void)(__bridge_transfer dispatch_block_t)_injected[(_injectedHead + i) % _injectedCapacity];
+    }
+
+    free(_injected);
+    free(_workers);
+    pthread_mutex_destroy(&_injectedMutex);
+}
+
+- (void)execute:(dispatch_block_t)block
+{
+    void *task = (__bridge_retained void *)[block copy];
+    CBPWorkStealingWorker *worker = pthread_getspecific(CBPWorkStealingCurrentWorkerKey());
+
+    if (worker && worker->executor == self)
+    {
+        CBPWorkStealingPush(worker, task);
+    }
+    else
+    {
+        pthread_mutex_lock(&_injectedMutex);
+
+        NSUInteger count = atomic_load_explicit(&_injectedCount, memory_order_relaxed);
+
+        if (count == _injectedCapacity)
+        {
+            void **injected = calloc(_injectedCapacity * 2, sizeof(void *));
+
+            for (NSUInteger i = 0; i < count; i++)
+            {
+                injected[i] = _injected[(_injectedHead + i) % _injectedCapacity];
+            }
+
+            free(_injected);
+            _injected = injected;
+            _injectedHead = 0;
+            _injectedCapacity *= 2;
+        }
+
+        _injected[(_injectedHead + count) % _injectedCapacity] = task;
+        atomic_store_explicit(&_injectedCount, count + 1, memory_order_relaxed);
+
+        pthread_mutex_unlock(&_injectedMutex);
+    }
+
+    //-------------------------------------------------------------------
+    // Pairs with the fence a worker issues between announcing it is idle
+    // and checking the queues one last time.
+    //-------------------------------------------------------------------
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&_idleWorkers, memory_order_relaxed))
+    {
+        dispatch_semaphore_signal(_semaphore);
+    }
+}
+
+- (BOOL)performPendingBlock
+{
+    CBPWorkStealingWorker *worker = pthread_getspecific(CBPWorkStealingCurrentWorkerKey());
+
+    if (!worker || worker->executor != self || worker->helpingDepth >= CBPWorkStealingMaximumHelpingDepth)
+    {
+        return NO;
+    }
+
+    void *task = [self _findTaskForWorker:worker];
+
+    if (task)
+    {
+        worker->helpingDepth++;
+        [self _performTask:task];
+        worker->helpingDepth--;
+    }
+
+    return task != NULL;
+}
+
+- (NSUInteger)queueDepth
+{
+    int64_t depth = (int64_t)atomic_load_explicit(&_injectedCount, memory_order_relaxed);
+
+    for (NSUInteger i = 0; i < _numberOfWorkers; i++)
+    {
+        depth += CBPWorkStealingCount(&_workers[i]);
+    }
+
+    return (NSUInteger)depth;
+}
+
+- (NSUInteger)stealCount
+{
+    return atomic_load_explicit(&_stealCount, memory_order_relaxed);
+}
+
+- (void)invalidate
+{
+    if (self != [CBPExecutor defaultExecutor])
+    {
+        atomic_store(&_invalidated, YES);
+
+        for (NSUInteger i = 0; i < _numberOfWorkers; i++)
+        {
+            dispatch_semaphore_signal(_semaphore);
+        }
+    }
+}
+
+#pragma mark -
+
+- (void *)_dequeueInjectedTask
+{
+    void *task = NULL;
+
+    if (atomic_load_explicit(&_injectedCount, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&_injectedMutex);
+
+        NSUInteger count = atomic_load_explicit(&_injectedCount, memory_order_relaxed);
+
+        if (count)
+        {
+            task = _injected[_injectedHead];
+            _injectedHead = (_injectedHead + 1) % _injectedCapacity;
+            atomic_store_explicit(&_injectedCount, count - 1, memory_order_relaxed);
+        }
+
+        pthread_mutex_unlock(&_injectedMutex);
+    }
+
+    return task;
+}
+
+- (void *)_findTaskForWorker:(CBPWorkStealingWorker *)worker
+{
+    void *task = CBPWorkStealingTake(worker);
+
+    if (!task)
+    {
+        task = [self _dequeueInjectedTask];
+    }
+
+    if (!task && _numberOfWorkers > 1)
+    {
+        //-------------------------------------------------------------------
+        // Start at a random victim so thieves don't all pile onto the same
+        // worker.
+        //-------------------------------------------------------------------
+        worker->seed ^= worker->seed << 13;
+        worker->seed ^= worker->seed >> 17;
+        worker->seed ^= worker->seed << 5;
+
+        NSUInteger start = worker->seed % _numberOfWorkers;
+
+        for (NSUInteger i = 0; i < _numberOfWorkers && !task; i++)
+        {
+            CBPWorkStealingWorker *victim = &_workers[(start + i) % _numberOfWorkers];
+
+            if (victim != worker && (task = CBPWorkStealingSteal(victim)))
+            {
+                atomic_fetch_add_explicit(&_stealCount, 1, memory_order_relaxed);
+            }
+        }
+    }
+
+    return task;
+}
+
+- (BOOL)_hasQueuedTasks
+{
+    return [self queueDepth] > 0;
+}
+
+- (void)_performTask:(void *)task
+{
+    @autoreleasepool
+    {
+        dispatch_block_t block = (__bridge_transfer dispatch_block_t)task;
+        block();
+    }
+}
+
+- (void)_runWorker:(NSNumber *)index
+{
+    CBPWorkStealingWorker *worker = &_workers[[index unsignedIntegerValue]];
+    pthread_setspecific(CBPWorkStealingCurrentWorkerKey(), worker);
+
+    while (YES)
+    {
+        void *task = [self _findTaskForWorker:worker];
+
+        if (task)
+        {
+            [self _performTask:task];
+            continue;
+        }
+
+        if (atomic_load(&_invalidated) && ![self _hasQueuedTasks])
+        {
+            break;
+        }
+
+        atomic_fetch_add(&_idleWorkers, 1);
+
+        if (![self _hasQueuedTasks] && !atomic_load(&_invalidated))
+        {
+            dispatch_semaphore_wait(_semaphore, DISPATCH_TIME_FOREVER);
+        }
+
+        atomic_fetch_sub(&_idleWorkers, 1);
+    }
+
+    pthread_setspecific(CBPWorkStealingCurrentWorkerKey(), NULL);
+}
+
+@end
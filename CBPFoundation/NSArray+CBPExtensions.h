@@ -24,9 +24,19 @@
 
 @import Foundation;
 #import "CBPCollectionTypes.h"
+#import "CBPSequence.h"
 
 @interface NSArray (CBPExtensions)
 
+#pragma mark - Sequences
+
+/**
+ *  Returns a lazy sequence of the objects in the receiving array. Chaining operations on the sequence avoids building an intermediate array for every step.
+ *
+ *  @return A sequence of the objects in the receiving array.
+ */
+- (CBPSequence *)sequence;
+
 #pragma mark - Mapping
 
 /**
@@ -39,7 +49,7 @@
 - (NSArray *)arrayByMappingBlock:(CBPArrayMappingBlock)block;
 
 /**
- *  Returns a new array that is the result of sending the message identified by the given selector to each object in the receiving array.
+ *  Returns a new array that is the result of sending the message identified by the given selector to each object in the receiving array. The method is looked up once per class rather than once per object, and scalar return values are boxed in an NSNumber.
  *
  *  @param selector A selector that identifies the message to send to the objects in the array.
  *
@@ -47,6 +57,24 @@
  */
 - (NSArray *)arrayByMappingSelector:(SEL)selector;
 
+/**
+ *  Returns a new array containing the value of the given key path for each object in the receiving array. Unlike @p -valueForKeyPath:, the key path is compiled once and each accessor is looked up once per class, so this is much faster for large arrays of similar objects. Scalars are boxed, and nil values are represented by NSNull.
+ *
+ *  @param keyPath A dotted key path.
+ *
+ *  @return A new array containing the value of the key path for each object in the receiving array.
+ */
+- (NSArray *)arrayByMappingKeyPath:(NSString *)keyPath;
+
+/**
+ *  Returns a new array that is the result of performing the given block on each object in the receiving array, performing the block concurrently. The order of the results matches the order of the receiving array. Small arrays are mapped serially.
+ *
+ *  @param block A block that will be performed with each object in the array. It must be safe to perform concurrently and must not return nil.
+ *
+ *  @return A new array that is the result of performing the given block on each object in the receiving array.
+ */
+- (NSArray *)concurrentArrayByMappingBlock:(CBPArrayMappingBlock)block;
+
 #pragma mark - Filtering
 
 /**
@@ -58,4 +86,55 @@
  */
 - (NSArray *)filteredArrayUsingBlock:(CBPArrayFilteringBlock)block;
 
+/**
+ *  Evaluates a given block concurrently against each object in the receiving array and returns an array containing the objects for which the block returns true, in their original order. Small arrays are filtered serially.
+ *
+ *  @param block The block against which to evaluate the receiving array’s elements. It must be safe to perform concurrently.
+ *
+ *  @return An array containing the objects in the receiving array for which block returns true.
+ */
+- (NSArray *)concurrentFilteredArrayUsingBlock:(CBPArrayFilteringBlock)block;
+
+#pragma mark - Reducing
+
+/**
+ *  Combines the objects in the receiving array into a single value, in order.
+ *
+ *  @param initialValue The initial accumulated value.
+ *  @param block        A block that combines each object into the accumulated value.
+ *
+ *  @return The final accumulated value.
+ */
+- (id)reduceWithInitialValue:(id)initialValue block:(CBPArrayReducingBlock)block;
+
+/**
+ *  Combines the objects in the receiving array into a single value, reducing parts of the array concurrently and then combining the partial results. Parts are combined in order, so the block needs to be associative but not commutative. Small arrays are reduced serially.
+ *
+ *  @param identity A value that leaves any value unchanged when combined with it, such as @@0 for a sum.
+ *  @param combine  A block that combines two values. It is used both to fold in each object and to combine partial results, so both must be of the same kind. It must be safe to perform concurrently.
+ *
+ *  @return The combined value, or @p identity if the array is empty.
+ */
+- (id)concurrentReduceWithIdentity:(id)identity combine:(CBPArrayReducingBlock)combine;
+
+#pragma mark - Grouping
+
+/**
+ *  Groups the objects in the receiving array by the key a block returns for each of them.
+ *
+ *  @param block A block that returns the key for an object. Objects with a nil key are grouped under NSNull.
+ *
+ *  @return A dictionary mapping each key to an array of the objects with that key, in their original order.
+ */
+- (NSDictionary *)groupedByKeyBlock:(CBPArrayGroupingBlock)block;
+
+/**
+ *  Groups the objects in the receiving array by the key a block returns for each of them, grouping parts of the array concurrently and then merging the groups. Small arrays are grouped serially.
+ *
+ *  @param block A block that returns the key for an object. Objects with a nil key are grouped under NSNull. It must be safe to perform concurrently.
+ *
+ *  @return A dictionary mapping each key to an array of the objects with that key, in their original order.
+ */
+- (NSDictionary *)concurrentGroupedByKeyBlock:(CBPArrayGroupingBlock)block;
+
 @end
@@ -23,67 +23,523 @@
  */
 
 #import "NSArray+CBPExtensions.h"
-#import "CBPRuntime.h"
+#import "CBPMethodCache.h"
+#import "CBPParallel.h"
+#import <stdatomic.h>
+
+/*
+ *  Serial mapping and filtering collect their output on the stack for arrays up to this size.
+ */
+#define CBPArrayStackBufferCount 128
+
+/*
+ *  Arrays shorter than this are mapped and filtered serially; below it, handing out chunks costs more than it saves
+ *  unless the block is very expensive. See the concurrent mapping scaling test in CBPFoundationTests.
+ */
+static const NSUInteger CBPConcurrentArraySerialThreshold = 2048;
+
+/*
+ *  The smallest number of objects handed to a thread at once.
+ */
+static const NSUInteger CBPConcurrentArrayGrainSize = 64;
+
+/*
+ *  Filtering counts the survivors of each block of this many objects, so the output can be written in parallel
+ *  once a prefix sum over the counts gives each block its offset.
+ */
+static const NSUInteger CBPConcurrentArrayFilteringBlockSize = 1024;
+
+/*
+ *  Objects are copied out of the array this many at a time.
+ */
+#define CBPConcurrentArrayBufferCount 64
 
 @implementation NSArray (CBPExtensions)
 
+#pragma mark - Sequences
+
+- (CBPSequence *)sequence
+{
+    return [CBPSequence sequenceWithArray:self];
+}
+
 #pragma mark - Mapping
 
 - (NSArray *)arrayByMappingBlock:(CBPArrayMappingBlock)block
 {
-    NSMutableArray *array = [NSMutableArray array];
-    
+    NSUInteger count = [self count];
+
+    //-------------------------------------------------------------------
+    // Results go into a stack buffer for small arrays and a single heap
+    // buffer otherwise, and the array is built from it in one call. The
+    // buffer holds its own references so only the slots that were used
+    // have to be released afterwards.
+    //-------------------------------------------------------------------
+    void *stackResults[CBPArrayStackBufferCount];
+    void **results = count <= CBPArrayStackBufferCount ? stackResults : malloc(count * sizeof(void *));
+    NSUInteger resultCount = 0;
+    BOOL returnedNil = NO;
+
     for (id object in self)
     {
-        [array addObject:block(object)];
+        id result = block(object);
+
+        if (!result)
+        {
+            returnedNil = YES;
+            break;
+        }
+
+        results[resultCount++] = (__bridge_retained void *)result;
+    }
+
+    NSArray *array = returnedNil ? nil : [[NSArray alloc] initWithObjects:(__unsafe_unretained id *)(void *)results count:resultCount];
+
+    for (NSUInteger i = 0; i < resultCount; i++)
+    {
+        CFRelease(results[i]);
+    }
+
+    if (results != stackResults)
+    {
+        free(results);
+    }
+
+    if (returnedNil)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"The mapping block must not return nil. %s", __PRETTY_FUNCTION__];
     }
-    
-    return [array copy];
+
+    return array;
 }
 
 - (NSArray *)arrayByMappingSelector:(SEL)selector
 {
+    CBPMethodCache *methodCache = [[CBPMethodCache alloc] initWithSelector:selector];
+
+    return [self arrayByMappingBlock:^id(id object) {
+
+        return [methodCache valueForObject:object];
+
+    }];
+}
+
+- (NSArray *)arrayByMappingKeyPath:(NSString *)keyPath
+{
+    CBPCompiledKeyPath *compiledKeyPath = [[CBPCompiledKeyPath alloc] initWithKeyPath:keyPath];
+
     return [self arrayByMappingBlock:^id(id object) {
-        
-        CBPFunctionForSelector(f, object, selector, id);
-        return f(object, selector);
-        
+
+        id value = [compiledKeyPath valueForObject:object];
+        return value ? value : [NSNull null];
+
     }];
 }
 
+- (NSArray *)concurrentArrayByMappingBlock:(CBPArrayMappingBlock)block
+{
+    NSUInteger count = [self count];
+
+    if (count < CBPConcurrentArraySerialThreshold)
+    {
+        return [self arrayByMappingBlock:block];
+    }
+
+    __strong id *results = (__strong id *)calloc(count, sizeof(id));
+    _Atomic(BOOL) returnedNil = NO;
+    _Atomic(BOOL) *returnedNilPointer = &returnedNil;
+
+    //-------------------------------------------------------------------
+    // Each result is written straight into its own slot, which keeps the
+    // order without any merging.
+    //-------------------------------------------------------------------
+    CBPParallelApply(count, CBPConcurrentArrayGrainSize, 0, ^(NSRange range) {
+
+        __unsafe_unretained id objects[CBPConcurrentArrayBufferCount];
+
+        for (NSUInteger location = range.location; location < NSMaxRange(range); location += CBPConcurrentArrayBufferCount)
+        {
+            NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPConcurrentArrayBufferCount, NSMaxRange(range) - location));
+            [self getObjects:objects range:bufferRange];
+
+            for (NSUInteger i = 0; i < bufferRange.length; i++)
+            {
+                id result = block(objects[i]);
+
+                if (!result)
+                {
+                    atomic_store_explicit(returnedNilPointer, YES, memory_order_relaxed);
+                }
+
+                results[bufferRange.location + i] = result;
+            }
+        }
+
+    });
+
+    NSArray *array = atomic_load(&returnedNil) ? nil : [NSArray arrayWithObjects:results count:count];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        results[i] = nil;
+    }
+
+    free(results);
+
+    if (!array)
+    {
+        [NSException raise:NSInvalidArgumentException format:@"The mapping block must not return nil. %s", __PRETTY_FUNCTION__];
+    }
+
+    return array;
+}
+
 #pragma mark - Filtering
 
 - (NSArray *)filteredArrayUsingBlock:(CBPArrayFilteringBlock)block
 {
-    NSMutableIndexSet *indexSet = [NSMutableIndexSet indexSet];
-    
-    [self enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-        
-        if (!block(obj))
+    NSUInteger count = [self count];
+
+    //-------------------------------------------------------------------
+    // The receiver keeps the survivors alive, so the output buffer
+    // doesn't need to retain them.
+    //-------------------------------------------------------------------
+    __unsafe_unretained id stackObjects[CBPArrayStackBufferCount];
+    __unsafe_unretained id *filteredObjects = count <= CBPArrayStackBufferCount ? stackObjects : (__unsafe_unretained id *)malloc(count * sizeof(id));
+    NSUInteger filteredCount = 0;
+
+    for (id object in self)
+    {
+        if (block(object))
         {
-            [indexSet addIndex:idx];
+            filteredObjects[filteredCount++] = object;
         }
-        
-    }];
-    
+    }
+
     NSArray *filteredArray = nil;
-    
+
     //-------------------------------------------------------------------
     // Only create a new array if there are items to remove. Otherwise,
     // return the receiver.
     //-------------------------------------------------------------------
-    if ([indexSet count])
+    if (filteredCount != count)
     {
-        NSMutableArray *mCopy = [self mutableCopy];
-        [mCopy removeObjectsAtIndexes:indexSet];
-        filteredArray = [mCopy copy];
+        filteredArray = [[NSArray alloc] initWithObjects:filteredObjects count:filteredCount];
     }
     else
     {
         filteredArray = [self copy]; /* Copy doesn't do anything for immutable arrays and allows for more consistent behavior when using mutable arrays. */
     }
-    
+
+    if (filteredObjects != stackObjects)
+    {
+        free(filteredObjects);
+    }
+
     return filteredArray;
 }
 
+- (NSArray *)concurrentFilteredArrayUsingBlock:(CBPArrayFilteringBlock)block
+{
+    NSUInteger count = [self count];
+
+    if (count < CBPConcurrentArraySerialThreshold)
+    {
+        return [self filteredArrayUsingBlock:block];
+    }
+
+    NSUInteger blockCount = (count + CBPConcurrentArrayFilteringBlockSize - 1) / CBPConcurrentArrayFilteringBlockSize;
+    uint8_t *keep = malloc(count);
+    NSUInteger *offsets = calloc(blockCount, sizeof(NSUInteger));
+
+    //-------------------------------------------------------------------
+    // First pass: evaluate the block and count the survivors of each
+    // filtering block. Chunks always cover whole filtering blocks, so no
+    // two threads share a count.
+    //-------------------------------------------------------------------
+    CBPParallelApply(count, CBPConcurrentArrayFilteringBlockSize, 0, ^(NSRange range) {
+
+        __unsafe_unretained id objects[CBPConcurrentArrayBufferCount];
+
+        for (NSUInteger location = range.location; location < NSMaxRange(range); location += CBPConcurrentArrayBufferCount)
+        {
+            NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPConcurrentArrayBufferCount, NSMaxRange(range) - location));
+            [self getObjects:objects range:bufferRange];
+
+            for (NSUInteger i = 0; i < bufferRange.length; i++)
+            {
+                BOOL kept = block(objects[i]) ? YES : NO;
+                keep[bufferRange.location + i] = kept;
+                offsets[(bufferRange.location + i) / CBPConcurrentArrayFilteringBlockSize] += kept;
+            }
+        }
+
+    });
+
+    //-------------------------------------------------------------------
+    // An exclusive prefix sum turns the counts into output offsets.
+    //-------------------------------------------------------------------
+    NSUInteger filteredCount = 0;
+
+    for (NSUInteger i = 0; i < blockCount; i++)
+    {
+        NSUInteger blockSurvivors = offsets[i];
+        offsets[i] = filteredCount;
+        filteredCount += blockSurvivors;
+    }
+
+    NSArray *filteredArray = nil;
+
+    if (filteredCount == count)
+    {
+        filteredArray = [self copy];
+    }
+    else
+    {
+        //-------------------------------------------------------------------
+        // Second pass: each filtering block copies its survivors into its
+        // own stretch of the output. The receiver keeps the objects alive,
+        // so the output doesn't need to retain them.
+        //-------------------------------------------------------------------
+        __unsafe_unretained id *filteredObjects = (__unsafe_unretained id *)malloc(MAX(filteredCount, (NSUInteger)1) * sizeof(id));
+
+        CBPParallelApply(blockCount, 1, 0, ^(NSRange range) {
+
+            __unsafe_unretained id objects[CBPConcurrentArrayBufferCount];
+
+            for (NSUInteger blockIndex = range.location; blockIndex < NSMaxRange(range); blockIndex++)
+            {
+                NSUInteger offset = offsets[blockIndex];
+                NSUInteger blockEnd = MIN((blockIndex + 1) * CBPConcurrentArrayFilteringBlockSize, count);
+
+                for (NSUInteger location = blockIndex * CBPConcurrentArrayFilteringBlockSize; location < blockEnd; location += CBPConcurrentArrayBufferCount)
+                {
+                    NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPConcurrentArrayBufferCount, blockEnd - location));
+                    [self getObjects:objects range:bufferRange];
+
+                    for (NSUInteger i = 0; i < bufferRange.length; i++)
+                    {
+                        if (keep[bufferRange.location + i])
+                        {
+                            filteredObjects[offset++] = objects[i];
+                        }
+                    }
+                }
+            }
+
+        });
+
+        filteredArray = [NSArray arrayWithObjects:filteredObjects count:filteredCount];
+        free(filteredObjects);
+    }
+
+    free(keep);
+    free(offsets);
+
+    return filteredArray;
+}
+
+#pragma mark - Reducing
+
+- (id)reduceWithInitialValue:(id)initialValue block:(CBPArrayReducingBlock)block
+{
+    id accumulator = initialValue;
+
+    for (id object in self)
+    {
+        accumulator = block(accumulator, object);
+    }
+
+    return accumulator;
+}
+
+- (id)concurrentReduceWithIdentity:(id)identity combine:(CBPArrayReducingBlock)combine
+{
+    if ([self count] < CBPConcurrentArraySerialThreshold)
+    {
+        return [self reduceWithInitialValue:identity block:combine];
+    }
+
+    return [self _concurrentlyAccumulateWithBlock:^id(NSRange range) {
+
+        __unsafe_unretained id objects[CBPConcurrentArrayBufferCount];
+        id accumulator = identity;
+
+        for (NSUInteger location = range.location; location < NSMaxRange(range); location += CBPConcurrentArrayBufferCount)
+        {
+            NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPConcurrentArrayBufferCount, NSMaxRange(range) - location));
+            [self getObjects:objects range:bufferRange];
+
+            for (NSUInteger i = 0; i < bufferRange.length; i++)
+            {
+                accumulator = combine(accumulator, objects[i]);
+            }
+        }
+
+        return accumulator;
+
+    } merge:combine];
+}
+
+#pragma mark - Grouping
+
+- (NSDictionary *)groupedByKeyBlock:(CBPArrayGroupingBlock)block
+{
+    return [self _groupRange:NSMakeRange(0, [self count]) usingBlock:block];
+}
+
+- (NSDictionary *)concurrentGroupedByKeyBlock:(CBPArrayGroupingBlock)block
+{
+    if ([self count] < CBPConcurrentArraySerialThreshold)
+    {
+        return [self groupedByKeyBlock:block];
+    }
+
+    //-------------------------------------------------------------------
+    // Each part groups into its own dictionary of mutable arrays. Merging
+    // appends the later part's groups to the earlier part's, so the
+    // groups keep the original order.
+    //-------------------------------------------------------------------
+    return [self _concurrentlyAccumulateWithBlock:^id(NSRange range) {
+
+        return [self _groupRange:range usingBlock:block];
+
+    } merge:^id(NSMutableDictionary *groups, NSDictionary *laterGroups) {
+
+        [laterGroups enumerateKeysAndObjectsUsingBlock:^(id key, NSMutableArray *laterGroup, BOOL *stop) {
+
+            NSMutableArray *group = groups[key];
+
+            if (group)
+            {
+                [group addObjectsFromArray:laterGroup];
+            }
+            else
+            {
+                groups[key] = laterGroup;
+            }
+
+        }];
+
+        return groups;
+
+    }];
+}
+
+#pragma mark -
+
+- (NSMutableDictionary *)_groupRange:(NSRange)range usingBlock:(CBPArrayGroupingBlock)block
+{
+    NSMutableDictionary *groups = [NSMutableDictionary dictionary];
+    __unsafe_unretained id objects[CBPConcurrentArrayBufferCount];
+
+    for (NSUInteger location = range.location; location < NSMaxRange(range); location += CBPConcurrentArrayBufferCount)
+    {
+        NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPConcurrentArrayBufferCount, NSMaxRange(range) - location));
+        [self getObjects:objects range:bufferRange];
+
+        for (NSUInteger i = 0; i < bufferRange.length; i++)
+        {
+            id key = block(objects[i]);
+            key = key ? key : [NSNull null];
+
+            NSMutableArray *group = groups[key];
+
+            if (!group)
+            {
+                group = [NSMutableArray array];
+                groups[key] = group;
+            }
+
+            [group addObject:objects[i]];
+        }
+    }
+
+    return groups;
+}
+
+/**
+ *  Accumulates parts of the receiver concurrently, each into its own partial result, then merges the partial results pairwise in a tree. Neither step shares mutable state between threads, and the merges keep the parts in order.
+ *
+ *  @param accumulate Returns the partial result for a range of the receiver.
+ *  @param merge      Merges a partial result with the one that follows it.
+ *
+ *  @return The merged result.
+ */
+- (id)_concurrentlyAccumulateWithBlock:(id (^)(NSRange range))accumulate merge:(CBPArrayReducingBlock)merge
+{
+    NSUInteger count = [self count];
+    NSUInteger slotCount = (count + CBPConcurrentArrayGrainSize - 1) / CBPConcurrentArrayGrainSize;
+    __strong id *partials = (__strong id *)calloc(slotCount, sizeof(id));
+    __strong id *merged = (__strong id *)calloc(slotCount / 2 + 1, sizeof(id));
+    uint8_t *used = calloc(slotCount, sizeof(uint8_t));
+
+    CBPParallelApply(count, CBPConcurrentArrayGrainSize, 0, ^(NSRange range) {
+
+        NSUInteger slot = range.location / CBPConcurrentArrayGrainSize;
+        partials[slot] = accumulate(range);
+        used[slot] = YES;
+
+    });
+
+    //-------------------------------------------------------------------
+    // Only the first slot of each part was used; pack them together.
+    //-------------------------------------------------------------------
+    NSUInteger partialCount = 0;
+
+    for (NSUInteger i = 0; i < slotCount; i++)
+    {
+        if (used[i])
+        {
+            id partial = partials[i];
+            partials[i] = nil;
+            partials[partialCount++] = partial;
+        }
+    }
+
+    while (partialCount > 1)
+    {
+        NSUInteger pairCount = partialCount / 2;
+
+        CBPParallelApply(pairCount, 1, 0, ^(NSRange range) {
+
+            for (NSUInteger i = range.location; i < NSMaxRange(range); i++)
+            {
+                merged[i] = merge(partials[i * 2], partials[i * 2 + 1]);
+            }
+
+        });
+
+        //-------------------------------------------------------------------
+        // An odd one out moves up a level unmerged.
+        //-------------------------------------------------------------------
+        if (partialCount % 2)
+        {
+            merged[pairCount] = partials[partialCount - 1];
+        }
+
+        for (NSUInteger i = 0; i < partialCount; i++)
+        {
+            partials[i] = nil;
+        }
+
+        partialCount = pairCount + partialCount % 2;
+
+        for (NSUInteger i = 0; i < partialCount; i++)
+        {
+            partials[i] = merged[i];
+            merged[i] = nil;
+        }
+    }
+
+    id result = partials[0];
+    partials[0] = nil;
+
+    free(partials);
+    free(merged);
+    free(used);
+
+    return result;
+}
+
 @end
@@ -24,22 +24,48 @@
 
 #import "NSMutableArray+CBPExtensions.h"
 
+/*
+ *  Objects are copied out of the array this many at a time while filtering.
+ */
+#define CBPMutableArrayBufferCount 64
+
 @implementation NSMutableArray (CBPExtensions)
 
 - (void)filterArrayUsingBlock:(CBPArrayFilteringBlock)block
 {
-    NSMutableIndexSet *indexSet = [NSMutableIndexSet indexSet];
-    
-    [self enumerateObjectsUsingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-        
-        if (!block(obj))
+    NSUInteger count = [self count];
+    NSUInteger keptCount = 0;
+    __unsafe_unretained id objects[CBPMutableArrayBufferCount];
+
+    //-------------------------------------------------------------------
+    // Compact in a single pass: survivors slide down over the objects
+    // that were dropped, then the tail is removed in one go. Only slots
+    // that have already been visited are ever overwritten, so the
+    // unretained objects still waiting in the buffer stay alive.
+    //-------------------------------------------------------------------
+    for (NSUInteger location = 0; location < count; location += CBPMutableArrayBufferCount)
+    {
+        NSRange bufferRange = NSMakeRange(location, MIN((NSUInteger)CBPMutableArrayBufferCount, count - location));
+        [self getObjects:objects range:bufferRange];
+
+        for (NSUInteger i = 0; i < bufferRange.length; i++)
         {
-            [indexSet addIndex:idx];
+            if (block(objects[i]))
+            {
+                if (keptCount != bufferRange.location + i)
+                {
+                    [self replaceObjectAtIndex:keptCount withObject:objects[i]];
+                }
+
+                keptCount++;
+            }
         }
-        
-    }];
-    
-    [self removeObjectsAtIndexes:indexSet];
+    }
+
+    if (keptCount != count)
+    {
+        [self removeObjectsInRange:NSMakeRange(keptCount, count - keptCount)];
+    }
 }
 
 @end
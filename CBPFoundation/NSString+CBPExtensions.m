@@ -23,21 +23,87 @@
  */
 
 #import "NSString+CBPExtensions.h"
+#import "CBPStringSearch.h"
+
+#define CBPStringSearchStackBufferLength 512
+
+/*
+ *  Returns the ASCII bytes of range in string, or NULL if any character in the range is not ASCII. Strings backed by an
+ *  8-bit buffer are read in place; anything else is narrowed into buffer, or into a malloc'd block returned in
+ *  heapBuffer that the caller must free.
+ */
+static const uint8_t *CBPStringASCIIBytes(NSString *string, NSRange range, uint8_t *buffer, uint8_t **heapBuffer)
+{
+    CFStringRef cfString = (__bridge CFStringRef)string;
+    const char *bytes = CFStringGetCStringPtr(cfString, kCFStringEncodingASCII);
+
+    if (bytes)
+    {
+        const uint8_t *rangeBytes = (const uint8_t *)bytes + range.location;
+        return CBPStringSearchIsASCII(rangeBytes, range.length) ? rangeBytes : NULL;
+    }
+
+    if (range.length > CBPStringSearchStackBufferLength)
+    {
+        buffer = *heapBuffer = malloc(range.length);
+    }
+
+    //-------------------------------------------------------------------
+    // With no loss byte, conversion stops at the first non-ASCII character.
+    //-------------------------------------------------------------------
+    CFIndex converted = CFStringGetBytes(cfString, CFRangeMake((CFIndex)range.location, (CFIndex)range.length), kCFStringEncodingASCII, 0, false, buffer, (CFIndex)range.length, NULL);
+
+    return (NSUInteger)converted == range.length ? buffer : NULL;
+}
 
 @implementation NSString (CBPExtensions)
 
 - (BOOL)containsString:(NSString *)aString
 {
-    return [self rangeOfString:aString].location != NSNotFound;
+    return [self containsString:aString options:0 range:NSMakeRange(0, [self length])];
 }
 
 - (BOOL)containsString:(NSString *)aString options:(NSStringCompareOptions)mask
 {
-    return [self rangeOfString:aString options:mask].location != NSNotFound;
+    return [self containsString:aString options:mask range:NSMakeRange(0, [self length])];
 }
 
 - (BOOL)containsString:(NSString *)aString options:(NSStringCompareOptions)mask range:(NSRange)searchRange
 {
+    NSUInteger length = [self length];
+    NSUInteger needleLength = [aString length];
+
+    //-------------------------------------------------------------------
+    // For ASCII text, literal, canonical and case-insensitive matching all
+    // reduce to a byte search. Other options, out of range searches and
+    // nil needles keep the rangeOfString: behavior, exceptions included.
+    //-------------------------------------------------------------------
+    if (aString && (mask & ~(NSStringCompareOptions)(NSCaseInsensitiveSearch | NSLiteralSearch)) == 0 && searchRange.location <= length && searchRange.length <= length - searchRange.location)
+    {
+        uint8_t haystackBuffer[CBPStringSearchStackBufferLength];
+        uint8_t needleBuffer[CBPStringSearchStackBufferLength];
+        uint8_t *haystackHeapBuffer = NULL;
+        uint8_t *needleHeapBuffer = NULL;
+
+        const uint8_t *needle = CBPStringASCIIBytes(aString, NSMakeRange(0, needleLength), needleBuffer, &needleHeapBuffer);
+        const uint8_t *haystack = needle ? CBPStringASCIIBytes(self, searchRange, haystackBuffer, &haystackHeapBuffer) : NULL;
+
+        NSUInteger location = NSNotFound;
+
+        if (haystack)
+        {
+            location = CBPStringSearchFind(haystack, searchRange.length, needle, needleLength, (mask & NSCaseInsensitiveSearch) ? CBPStringSearchCaseInsensitive : 0);
+        }
+
+        free(haystackHeapBuffer);
+        free(needleHeapBuffer);
+
+        if (haystack)
+        {
+            return location != NSNotFound;
+        }
+    }
+
     return [self rangeOfString:aString options:mask range:searchRange].location != NSNotFound;
 }
 
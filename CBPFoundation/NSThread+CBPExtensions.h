@@ -24,15 +24,44 @@
 
 @import Foundation;
 
+@class CBPThreadConfiguration;
+
 @interface NSThread (CBPExtensions)
 
 /**
  *  Creates and returns a new thread that is ready for events to be scheduled on it. To correctly stop it, call -cbp_stop.
  *
+ *  Blocks performed on the returned thread are delivered through a lock-free mailbox that the thread drains in batches, rather than through -performSelector:onThread:withObject:waitUntilDone:. Other threads use the latter.
+ *
  *  @return a newly created thread
  */
 + (NSThread *)cbp_runningThread;
 
+/**
+ *  Creates and returns a new thread, configured by @p configuration, that is ready for events to be scheduled on it. To correctly stop it, call -cbp_stop.
+ *
+ *  The scheduling policy, nice level and processor set are applied on a best effort basis; a failure is logged and can be read from the returned thread's @p cbp_configurationError.
+ *
+ *  @param configuration The configuration, or nil for the defaults.
+ *
+ *  @return a newly created thread
+ */
++ (NSThread *)cbp_runningThreadWithConfiguration:(CBPThreadConfiguration *)configuration;
+
+/**
+ *  Applies @p configuration to the calling thread with -applyToCurrentThread:. A failure is logged and recorded in the thread's @p cbp_configurationError.
+ *
+ *  @param configuration The configuration, or nil to do nothing.
+ *
+ *  @return YES if everything was applied.
+ */
++ (BOOL)cbp_applyConfigurationToCurrentThread:(CBPThreadConfiguration *)configuration;
+
+/**
+ *  The error from the last configuration applied to the receiver with +cbp_applyConfigurationToCurrentThread:, or nil if it was applied in full. Threads returned by +cbp_runningThreadWithConfiguration: have applied theirs by the time it returns.
+ */
+@property (readonly) NSError *cbp_configurationError;
+
 /**
  *  Cleanly stops a thread returned by cbp_runningThread.
  */
@@ -23,24 +23,228 @@
  */
 
 #import "NSThread+CBPExtensions.h"
+#import "CBPParkingLot.h"
+#import "CBPThreadConfiguration.h"
+#import <objc/runtime.h>
+#import <stdatomic.h>
 
 #define CBPThreadKeyLock   @"lock"
 #define CBPThreadKeyThread @"thread"
+#define CBPThreadKeyConfiguration @"configuration"
+
+#pragma mark - Mailbox
+
+/*
+ *  Threads created by +cbp_runningThread receive blocks through a mailbox instead of -performSelector:onThread:. Any
+ *  number of producers push nodes onto a lock-free stack; the thread takes the whole stack in one exchange each time
+ *  its run loop source fires and runs the batch in the order it was pushed. Only the push that finds the stack empty
+ *  signals the source, so a burst of blocks costs one wakeup. Synchronous callers push a node from their own stack and
+ *  park on it until the block has run.
+ *
+ *  Outside Darwin, NSRunLoop is not built on CFRunLoop, so the wakeup is a single -performSelector:onThread: per batch
+ *  instead of a run loop source.
+ */
+#if defined(__APPLE__)
+#define CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE 1
+#else
+#define CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE 0
+#endif
+
+typedef struct CBPThreadMailboxNode
+{
+    struct CBPThreadMailboxNode *next;
+    void *block;
+    BOOL sync;
+    _Atomic(uint32_t) done;
+} CBPThreadMailboxNode;
+
+#define CBPThreadMailboxClosed ((CBPThreadMailboxNode *)1)
+
+static const void *const CBPThreadMailboxKey = &CBPThreadMailboxKey;
+static const void *const CBPThreadConfigurationErrorKey = &CBPThreadConfigurationErrorKey;
+
+static BOOL CBPThreadMailboxNodeIsPending(void *context)
+{
+    return atomic_load_explicit((_Atomic(uint32_t) *)context, memory_order_acquire) == 0;
+}
+
+@interface CBPThreadMailbox : NSObject
+{
+    _Atomic(CBPThreadMailboxNode *) _head;
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+    CFRunLoopSourceRef _source;
+    CFRunLoopRef _runLoop;
+#else
+    __unsafe_unretained NSThread *_thread;
+#endif
+}
+
+@end
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+static void CBPThreadMailboxPerform(void *info);
+#endif
+
+@implementation CBPThreadMailbox
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self)
+    {
+        atomic_init(&_head, NULL);
+
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+        CFRunLoopSourceContext context = {
+            .version = 0,
+            .info = (__bridge void *)self,
+            .perform = CBPThreadMailboxPerform,
+        };
+
+        _source = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &context);
+        _runLoop = (CFRunLoopRef)CFRetain(CFRunLoopGetCurrent());
+        CFRunLoopAddSource(_runLoop, _source, kCFRunLoopCommonModes);
+#else
+        _thread = [NSThread currentThread];
+#endif
+    }
+
+    return self;
+}
+
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+- (void)dealloc
+{
+    CFRunLoopSourceInvalidate(_source);
+    CFRelease(_source);
+    CFRelease(_runLoop);
+}
+#endif
+
+- (BOOL)postNode:(CBPThreadMailboxNode *)node
+{
+    CBPThreadMailboxNode *head = atomic_load_explicit(&_head, memory_order_relaxed);
+
+    do
+    {
+        if (head == CBPThreadMailboxClosed)
+        {
+            return NO;
+        }
+
+        node->next = head;
+    }
+    while (!atomic_compare_exchange_weak_explicit(&_head, &head, node, memory_order_release, memory_order_relaxed));
+
+    if (!head)
+    {
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+        CFRunLoopSourceSignal(_source);
+        CFRunLoopWakeUp(_runLoop);
+#else
+        [self performSelector:@selector(drain) onThread:_thread withObject:nil waitUntilDone:NO];
+#endif
+    }
+
+    return YES;
+}
+
+- (void)drainClosing:(BOOL)closing
+{
+    CBPThreadMailboxNode *node = atomic_exchange_explicit(&_head, closing ? CBPThreadMailboxClosed : NULL, memory_order_acquire);
+    CBPThreadMailboxNode *reversed = NULL;
+
+    while (node && node != CBPThreadMailboxClosed)
+    {
+        CBPThreadMailboxNode *next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+
+    @autoreleasepool
+    {
+        while (reversed)
+        {
+            //-------------------------------------------------------------------
+            // A synchronous node lives on its caller's stack and may be gone
+            // as soon as it is marked done, so read everything first.
+            //-------------------------------------------------------------------
+            CBPThreadMailboxNode *next = reversed->next;
+            dispatch_block_t block = (__bridge_transfer dispatch_block_t)reversed->block;
+
+            block();
+
+            if (reversed->sync)
+            {
+                atomic_store_explicit(&reversed->done, 1, memory_order_release);
+                CBPParkingLotUnparkAll(reversed);
+            }
+            else
+            {
+                free(reversed);
+            }
+
+            reversed = next;
+        }
+    }
+}
+
+- (void)drain
+{
+    [self drainClosing:NO];
+}
+
+- (void)close
+{
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+    CFRunLoopRemoveSource(_runLoop, _source, kCFRunLoopCommonModes);
+#endif
+    [self drainClosing:YES];
+}
+
+@end
+
+#pragma clang diagnostic pop
+
+#if CBP_THREAD_MAILBOX_RUN_LOOP_SOURCE
+static void CBPThreadMailboxPerform(void *info)
+{
+    [(__bridge CBPThreadMailbox *)info drain];
+}
+#endif
 
 @implementation NSThread (CBPExtensions)
 
 #pragma mark - Long running thread methods
 
 + (NSThread *)cbp_runningThread
+{
+    return [self cbp_runningThreadWithConfiguration:nil];
+}
+
++ (NSThread *)cbp_runningThreadWithConfiguration:(CBPThreadConfiguration *)configuration
 {
     NSConditionLock *lock = [[NSConditionLock alloc] initWithCondition:0];
     
     NSMutableDictionary *threadDict = [NSMutableDictionary dictionary];
     threadDict[CBPThreadKeyLock] = lock;
     
-    [NSThread detachNewThreadSelector:@selector(cbp_runThread:)
-                             toTarget:self
-                           withObject:threadDict];
+    NSThread *thread = [[NSThread alloc] initWithTarget:self
+                                               selector:@selector(cbp_runThread:)
+                                                 object:threadDict];
+    
+    if (configuration)
+    {
+        threadDict[CBPThreadKeyConfiguration] = [configuration copy];
+        [configuration prepareThread:thread];
+    }
+    
+    [thread start];
     
     [lock lockWhenCondition:1];
     [lock unlock];
@@ -52,7 +256,11 @@
 {
     @autoreleasepool
     {
+        [self cbp_applyConfigurationToCurrentThread:threadDict[CBPThreadKeyConfiguration]];
+        
         NSThread *currentThread = [NSThread currentThread];
+        CBPThreadMailbox *mailbox = [[CBPThreadMailbox alloc] init];
+        objc_setAssociatedObject(currentThread, CBPThreadMailboxKey, mailbox, OBJC_ASSOCIATION_RETAIN);
         
         threadDict[CBPThreadKeyThread] = currentThread;
         
@@ -68,9 +276,41 @@
         {
             [currentRunLoop runMode:NSDefaultRunLoopMode beforeDate:[NSDate distantFuture]];
         }
+        
+        //-------------------------------------------------------------------
+        // Run whatever was posted before the thread was stopped; later posts
+        // fall back to -performSelector:onThread:.
+        //-------------------------------------------------------------------
+        [mailbox close];
     }
 }
 
++ (BOOL)cbp_applyConfigurationToCurrentThread:(CBPThreadConfiguration *)configuration
+{
+    if (!configuration)
+    {
+        return YES;
+    }
+
+    NSError *error = nil;
+    BOOL applied = [configuration applyToCurrentThread:&error];
+    NSThread *currentThread = [NSThread currentThread];
+
+    if (!applied)
+    {
+        NSLog(@"CBPFoundation: couldn't apply the thread configuration to %@: %@", currentThread, error);
+    }
+
+    objc_setAssociatedObject(currentThread, CBPThreadConfigurationErrorKey, error, OBJC_ASSOCIATION_RETAIN);
+
+    return applied;
+}
+
+- (NSError *)cbp_configurationError
+{
+    return objc_getAssociatedObject(self, CBPThreadConfigurationErrorKey);
+}
+
 - (void)cbp_dummy
 {
     ;
@@ -110,14 +350,14 @@
         {
             block();
         }
-        else
+        else if (![self cbp_postBlock:block sync:NO])
         {
             [self performSelector:@selector(cbp_doPerformBlock:)
                        withObject:[block copy]
                        afterDelay:0.0];
         }
     }
-    else
+    else if (![self cbp_postBlock:block sync:sync])
     {
         [self performSelector:@selector(cbp_doPerformBlock:)
                      onThread:self
@@ -126,4 +366,47 @@
     }
 }
 
+- (BOOL)cbp_postBlock:(dispatch_block_t)block sync:(BOOL)sync
+{
+    CBPThreadMailbox *mailbox = objc_getAssociatedObject(self, CBPThreadMailboxKey);
+    
+    if (!mailbox)
+    {
+        return NO;
+    }
+    
+    void *retainedBlock = (__bridge_retained void *)[block copy];
+    
+    if (sync)
+    {
+        CBPThreadMailboxNode node = { .block = retainedBlock, .sync = YES };
+        atomic_init(&node.done, 0);
+        
+        if (![mailbox postNode:&node])
+        {
+            CFRelease(retainedBlock);
+            return NO;
+        }
+        
+        while (CBPThreadMailboxNodeIsPending(&node.done))
+        {
+            CBPParkingLotPark(&node, CBPThreadMailboxNodeIsPending, &node.done, NULL);
+        }
+    }
+    else
+    {
+        CBPThreadMailboxNode *node = calloc(1, sizeof(CBPThreadMailboxNode));
+        node->block = retainedBlock;
+        
+        if (![mailbox postNode:node])
+        {
+            CFRelease(retainedBlock);
+            free(node);
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
 @end
@@ -24,6 +24,92 @@
 
 #import <XCTest/XCTest.h>
 #import "CBPFoundation.h"
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#import <objc/runtime.h>
+#import <stdatomic.h>
+
+@interface NSThread (CBPFoundationTestsPrivate)
+
+- (void)cbp_doPerformBlock:(dispatch_block_t)block;
+
+@end
+
+#pragma mark - Allocation counting
+
+/*
+ *  Counts allocations made through the default malloc zone by swapping its entry points, which is enough to see how
+ *  many allocations a single call makes. Only meant for single threaded measurements.
+ */
+static _Atomic(NSUInteger) CBPTestAllocationCount;
+static void *(*CBPTestOriginalMalloc)(malloc_zone_t *zone, size_t size);
+static void *(*CBPTestOriginalCalloc)(malloc_zone_t *zone, size_t count, size_t size);
+static void *(*CBPTestOriginalRealloc)(malloc_zone_t *zone, void *pointer, size_t size);
+
+static void *CBPTestCountingMalloc(malloc_zone_t *zone, size_t size)
+{
+    atomic_fetch_add_explicit(&CBPTestAllocationCount, 1, memory_order_relaxed);
+    return CBPTestOriginalMalloc(zone, size);
+}
+
+static void *CBPTestCountingCalloc(malloc_zone_t *zone, size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&CBPTestAllocationCount, 1, memory_order_relaxed);
+    return CBPTestOriginalCalloc(zone, count, size);
+}
+
+static void *CBPTestCountingRealloc(malloc_zone_t *zone, void *pointer, size_t size)
+{
+    atomic_fetch_add_explicit(&CBPTestAllocationCount, 1, memory_order_relaxed);
+    return CBPTestOriginalRealloc(zone, pointer, size);
+}
+
+static NSUInteger CBPTestCountAllocations(dispatch_block_t block)
+{
+    malloc_zone_t *zone = malloc_default_zone();
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+        CBPTestOriginalMalloc = zone->malloc;
+        CBPTestOriginalCalloc = zone->calloc;
+        CBPTestOriginalRealloc = zone->realloc;
+    });
+    
+    atomic_store(&CBPTestAllocationCount, 0);
+    
+    zone->malloc = CBPTestCountingMalloc;
+    zone->calloc = CBPTestCountingCalloc;
+    zone->realloc = CBPTestCountingRealloc;
+    
+    block();
+    
+    zone->malloc = CBPTestOriginalMalloc;
+    zone->calloc = CBPTestOriginalCalloc;
+    zone->realloc = CBPTestOriginalRealloc;
+    
+    return atomic_load(&CBPTestAllocationCount);
+}
+
+#pragma mark - Test models
+
+@interface CBPTestModel : NSObject
+
+@property NSString *name;
+
+@property NSInteger age;
+
+@property (getter = isActive) BOOL active;
+
+@property CBPTestModel *parent;
+
+@end
+
+@implementation CBPTestModel
+
+@end
+
+#pragma mark -
 
 @interface CBPFoundationTests : XCTestCase
 
@@ -52,6 +138,217 @@
     XCTAssert([@"hello" containsString:@"LL" options:NSCaseInsensitiveSearch range:NSMakeRange(2, 2)], @"hello should contain LL case insensitively in the correct range");
 }
 
+- (void)testStringContainsASCIIFastPath
+{
+    NSMutableString *haystack = [NSMutableString string];
+    
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [haystack appendString:@"the quick brown fox jumps over the lazy dog. "];
+    }
+    
+    [haystack appendString:@"Needle"];
+    
+    XCTAssert([haystack containsString:@"Needle"], @"the needle at the end of the haystack should be found");
+    XCTAssert([haystack containsString:@"nEEDLE" options:NSCaseInsensitiveSearch], @"the needle should be found case insensitively");
+    XCTAssertFalse([haystack containsString:@"nEEDLE"], @"the needle should not be found case sensitively");
+    XCTAssertFalse([haystack containsString:@"Needle" options:0 range:NSMakeRange(0, [haystack length] - 1)], @"the needle should not be found outside of the search range");
+    XCTAssertFalse([haystack containsString:@""], @"an empty string should never be found");
+    XCTAssertFalse([@"a@b" containsString:@"`" options:NSCaseInsensitiveSearch], @"case folding should only apply to letters");
+}
+
+- (void)testStringContainsNonASCIIFallback
+{
+    XCTAssert([@"crème brûlée" containsString:@"BRÛLÉE" options:NSCaseInsensitiveSearch], @"non-ASCII strings should match case insensitively");
+    XCTAssert([@"crème brûlée" containsString:@"e\u0300" options:0], @"canonically equivalent strings should match");
+    XCTAssertFalse([@"creme" containsString:@"crème"], @"an ASCII haystack should not contain a non-ASCII needle");
+    XCTAssert([@"crème" containsString:@"CR" options:NSCaseInsensitiveSearch], @"a non-ASCII haystack should contain an ASCII needle");
+    XCTAssert([@"résumé" containsString:@"SUM" options:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch], @"unsupported options should fall back to rangeOfString:");
+}
+
+#pragma mark - String search performance tests
+
+static NSString *CBPTestHaystack(NSUInteger length)
+{
+    NSMutableString *haystack = [NSMutableString stringWithCapacity:length];
+    
+    while ([haystack length] < length)
+    {
+        [haystack appendString:@"Lorem ipsum dolor sit amet, consectetur adipiscing elit. "];
+    }
+    
+    [haystack deleteCharactersInRange:NSMakeRange(length - 6, [haystack length] - length + 6)];
+    [haystack appendString:@"needle"];
+    
+    return [haystack copy];
+}
+
+- (void)measureStringSearchWithLength:(NSUInteger)length options:(NSStringCompareOptions)options useRangeOfString:(BOOL)useRangeOfString
+{
+    NSString *haystack = CBPTestHaystack(length);
+    NSUInteger iterations = MAX((NSUInteger)1, (64 * 1024 * 1024) / length);
+    
+    [self measureBlock:^{
+        
+        NSUInteger found = 0;
+        
+        for (NSUInteger i = 0; i < iterations; i++)
+        {
+            if (useRangeOfString)
+            {
+                found += [haystack rangeOfString:@"NEEDLE" options:options].location != NSNotFound;
+            }
+            else
+            {
+                found += [haystack containsString:@"NEEDLE" options:options];
+            }
+        }
+        
+        XCTAssertEqual(found, iterations, @"every search should find the needle");
+    }];
+}
+
+- (void)testStringSearch64BPerformance
+{
+    [self measureStringSearchWithLength:64 options:NSCaseInsensitiveSearch useRangeOfString:NO];
+}
+
+- (void)testStringSearch4KBPerformance
+{
+    [self measureStringSearchWithLength:4 * 1024 options:NSCaseInsensitiveSearch useRangeOfString:NO];
+}
+
+- (void)testStringSearch1MBPerformance
+{
+    [self measureStringSearchWithLength:1024 * 1024 options:NSCaseInsensitiveSearch useRangeOfString:NO];
+}
+
+- (void)testRangeOfString64BPerformance
+{
+    [self measureStringSearchWithLength:64 options:NSCaseInsensitiveSearch useRangeOfString:YES];
+}
+
+- (void)testRangeOfString4KBPerformance
+{
+    [self measureStringSearchWithLength:4 * 1024 options:NSCaseInsensitiveSearch useRangeOfString:YES];
+}
+
+- (void)testRangeOfString1MBPerformance
+{
+    [self measureStringSearchWithLength:1024 * 1024 options:NSCaseInsensitiveSearch useRangeOfString:YES];
+}
+
+#pragma mark - String matcher tests
+
+- (void)testStringMatcher
+{
+    CBPStringMatcher *matcher = [[CBPStringMatcher alloc] initWithPatterns:@[@"he", @"she", @"his", @"hers"] options:0];
+    
+    XCTAssert([matcher containsAnyPatternInString:@"ushers"], @"ushers should contain a pattern");
+    XCTAssertFalse([matcher containsAnyPatternInString:@"HERS"], @"case sensitive matchers should not match HERS");
+    XCTAssertEqual([matcher rangeOfFirstMatchInString:@"ushers"].location, (NSUInteger)1, @"she should be the first match");
+    XCTAssertEqual([matcher rangeOfFirstMatchInString:@"nothing"].location, (NSUInteger)NSNotFound, @"nothing should not match");
+    
+    NSArray *expected = @[[NSValue valueWithRange:NSMakeRange(1, 3)], [NSValue valueWithRange:NSMakeRange(2, 2)], [NSValue valueWithRange:NSMakeRange(2, 4)]];
+    XCTAssertEqualObjects([matcher rangesOfMatchesInString:@"ushers"], expected, @"every overlapping match should be reported");
+    
+    NSMutableArray *patternIndexes = [NSMutableArray array];
+    
+    [matcher enumerateMatchesInString:@"his hers" usingBlock:^(NSUInteger patternIndex, NSRange range, BOOL *stop) {
+        [patternIndexes addObject:@(patternIndex)];
+    }];
+    
+    XCTAssertEqualObjects(patternIndexes, (@[@2, @0, @3]), @"matches should be reported in the order they end");
+}
+
+- (void)testCaseInsensitiveStringMatcher
+{
+    CBPStringMatcher *matcher = [[CBPStringMatcher alloc] initWithPatterns:@[@"Crème", @"NAÏVE", @"日本"] options:NSCaseInsensitiveSearch];
+    
+    XCTAssert([matcher containsAnyPatternInString:@"a CRÈME brûlée"], @"non-ASCII patterns should match case insensitively");
+    XCTAssert([matcher containsAnyPatternInString:@"a naïve question"], @"non-ASCII patterns should match case insensitively");
+    XCTAssertEqual([matcher rangeOfFirstMatchInString:@"東京, 日本"].location, (NSUInteger)4, @"patterns without case should match");
+    XCTAssertFalse([matcher containsAnyPatternInString:@"creme naive"], @"case insensitive matching should not ignore diacritics");
+    XCTAssertThrows([[CBPStringMatcher alloc] initWithPatterns:@[@"a"] options:NSDiacriticInsensitiveSearch], @"unsupported options should throw");
+}
+
+- (void)testStringMatcherAgreesWithContainsString
+{
+    NSMutableArray *patterns = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 500; i++)
+    {
+        [patterns addObject:[NSString stringWithFormat:@"k%luw", (unsigned long)(i * 7919) % 100000]];
+    }
+    
+    CBPStringMatcher *matcher = [[CBPStringMatcher alloc] initWithPatterns:patterns options:NSCaseInsensitiveSearch];
+    
+    for (NSUInteger i = 0; i < 200; i++)
+    {
+        NSUInteger other = (i % 2) ? (i * 3967) % 100000 : (i * 7919) % 100000;
+        NSString *haystack = [NSString stringWithFormat:@"K%luW and k%luw", (unsigned long)(i * 104729) % 100000, (unsigned long)other];
+        BOOL expected = NO;
+        
+        for (NSString *pattern in patterns)
+        {
+            expected = expected || [haystack containsString:pattern options:NSCaseInsensitiveSearch];
+        }
+        
+        XCTAssertEqual([matcher containsAnyPatternInString:haystack], expected, @"the matcher should agree with containsString: for %@", haystack);
+    }
+}
+
+#pragma mark - String matcher performance tests
+
+static NSArray *CBPTestKeywords(NSUInteger count)
+{
+    NSMutableArray *keywords = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [keywords addObject:[NSString stringWithFormat:@"keyword%lu", (unsigned long)i]];
+    }
+    
+    return keywords;
+}
+
+- (void)testStringMatcher5000KeywordsPerformance
+{
+    CBPStringMatcher *matcher = [[CBPStringMatcher alloc] initWithPatterns:CBPTestKeywords(5000) options:NSCaseInsensitiveSearch];
+    NSString *haystack = CBPTestHaystack(4 * 1024);
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 100; i++)
+        {
+            XCTAssertFalse([matcher containsAnyPatternInString:haystack], @"the haystack should not contain a keyword");
+        }
+        
+    }];
+}
+
+- (void)testContainsString5000KeywordsPerformance
+{
+    NSArray *keywords = CBPTestKeywords(5000);
+    NSString *haystack = CBPTestHaystack(4 * 1024);
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 100; i++)
+        {
+            BOOL found = NO;
+            
+            for (NSString *keyword in keywords)
+            {
+                found = found || [haystack containsString:keyword options:NSCaseInsensitiveSearch];
+            }
+            
+            XCTAssertFalse(found, @"the haystack should not contain a keyword");
+        }
+        
+    }];
+}
+
 #pragma mark - Mapping tests
 
 - (void)testArraySelectorMapping
@@ -82,6 +379,98 @@
     }
 }
 
+- (void)testConcurrentArrayBlockMapping
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    NSArray *result = [testArray concurrentArrayByMappingBlock:^id(NSNumber *number) {
+        
+        return @([number unsignedIntegerValue] * 2);
+        
+    }];
+    
+    XCTAssertEqualObjects(result, [testArray arrayByMappingBlock:^id(NSNumber *number) {
+        
+        return @([number unsignedIntegerValue] * 2);
+        
+    }], @"Concurrent mapping should preserve the order");
+}
+
+- (void)testArrayScalarSelectorMapping
+{
+    NSArray *testArray = @[@"1", [@"22" mutableCopy], @"333", [NSString stringWithFormat:@"%@", @4444]];
+    
+    XCTAssertEqualObjects([testArray arrayByMappingSelector:@selector(length)], (@[@1, @2, @3, @4]), @"Scalar results should be boxed");
+}
+
+- (void)testArrayKeyPathMapping
+{
+    CBPTestModel *parent = [[CBPTestModel alloc] init];
+    parent.name = @"parent";
+    
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSInteger i = 0; i < 3; i++)
+    {
+        CBPTestModel *model = [[CBPTestModel alloc] init];
+        model.name = [NSString stringWithFormat:@"%ld", (long)i];
+        model.age = i;
+        model.active = i % 2;
+        model.parent = i ? parent : nil;
+        [testArray addObject:model];
+    }
+    
+    [testArray addObject:@{@"name": @"dictionary", @"age": @3, @"active": @YES, @"parent": @{@"name": @"dictionary parent"}}];
+    
+    XCTAssertEqualObjects([testArray arrayByMappingKeyPath:@"name"], [testArray valueForKeyPath:@"name"], @"Key path mapping should match KVC");
+    XCTAssertEqualObjects([testArray arrayByMappingKeyPath:@"age"], [testArray valueForKeyPath:@"age"], @"Key path mapping should match KVC");
+    XCTAssertEqualObjects([testArray arrayByMappingKeyPath:@"active"], [testArray valueForKeyPath:@"active"], @"Key path mapping should match KVC");
+    XCTAssertEqualObjects([testArray arrayByMappingKeyPath:@"parent.name"], [testArray valueForKeyPath:@"parent.name"], @"Key path mapping should match KVC");
+}
+
+- (void)testArrayKeyPathMappingPerformance
+{
+    CBPTestModel *parent = [[CBPTestModel alloc] init];
+    parent.name = @"parent";
+    
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSInteger i = 0; i < 1000000; i++)
+    {
+        CBPTestModel *model = [[CBPTestModel alloc] init];
+        model.parent = parent;
+        [testArray addObject:model];
+    }
+    
+    [self measureBlock:^{
+        [testArray arrayByMappingKeyPath:@"parent.name"];
+    }];
+}
+
+- (void)testArrayValueForKeyPathPerformance
+{
+    CBPTestModel *parent = [[CBPTestModel alloc] init];
+    parent.name = @"parent";
+    
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSInteger i = 0; i < 1000000; i++)
+    {
+        CBPTestModel *model = [[CBPTestModel alloc] init];
+        model.parent = parent;
+        [testArray addObject:model];
+    }
+    
+    [self measureBlock:^{
+        [testArray valueForKeyPath:@"parent.name"];
+    }];
+}
+
 #pragma mark - Filtering tests
 
 - (void)testImmutableArrayFiltering
@@ -110,257 +499,2671 @@
     XCTAssert([testArray isEqualToArray:@[@"1"]], @"Filtering did not work!");
 }
 
-#pragma mark - Thread tests
-
-- (void)testBasicThreadExecution
+- (void)testConcurrentArrayFiltering
 {
-    NSThread *thread = [NSThread cbp_runningThread];
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    __block BOOL someVariable = NO;
+    for (NSUInteger i = 0; i < 100003; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    [thread cbp_performBlockSync:^{
-        someVariable = YES;
-    }];
+    CBPArrayFilteringBlock block = ^BOOL(NSNumber *number) {
+        
+        return [number unsignedIntegerValue] % 7 == 3;
+        
+    };
     
-    [thread cbp_stop];
+    XCTAssertEqualObjects([testArray concurrentFilteredArrayUsingBlock:block], [testArray filteredArrayUsingBlock:block], @"Concurrent filtering should preserve the order");
     
-    XCTAssert(someVariable, @"Thread synchronous execution did not work");
+    XCTAssertEqualObjects([testArray concurrentFilteredArrayUsingBlock:^BOOL(id object) {
+        return NO;
+    }], @[], @"Filtering everything out should return an empty array");
 }
 
-#pragma mark - CBPBackgroundTask tests
+#pragma mark - Reducing and grouping tests
 
-- (void)testBasicBackgroundTask
+- (void)testArrayReduce
 {
-    CBPBackgroundTask *task = [[CBPBackgroundTask alloc] init];
-    
-    __block BOOL someVariable = NO;
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    task.startBlock = ^{
-        
-        someVariable = YES;
-        
-    };
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        [testArray addObject:[NSString stringWithFormat:@"%lu", (unsigned long)(i % 10)]];
+    }
     
-    task.stopBlock = ^{
-        
-        someVariable = NO;
-        
+    CBPArrayReducingBlock concatenate = ^id(NSString *accumulator, NSString *string) {
+        return [accumulator stringByAppendingString:string];
     };
     
-    [task start];
+    NSArray *prefix = [testArray subarrayWithRange:NSMakeRange(0, 5000)];
     
-    XCTAssert(someVariable, @"Task did not start");
+    XCTAssertEqualObjects([prefix concurrentReduceWithIdentity:@"" combine:concatenate], [prefix reduceWithInitialValue:@"" block:concatenate], @"Concurrent reduction should keep the order");
     
-    [task stop];
+    NSNumber *sum = [testArray concurrentReduceWithIdentity:@0 combine:^id(NSNumber *accumulator, id object) {
+        return @([accumulator unsignedIntegerValue] + [object unsignedIntegerValue]);
+    }];
     
-    XCTAssert(!someVariable, @"Task did not finish");
+    XCTAssertEqualObjects(sum, @(100000 * 45 / 10), @"Concurrent reduction should visit every object once");
 }
 
-#pragma mark - Promise tests
-
-- (void)testPromiseBasics
+- (void)testArrayGrouping
 {
-    CBPPromise *promise = [[CBPPromise alloc] init];
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    NSString *deliveryValue = @"hello";
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    XCTAssert(![promise isRealized], @"Promise should not be considered resolved");
+    CBPArrayGroupingBlock block = ^id<NSCopying>(NSNumber *number) {
+        return @([number unsignedIntegerValue] % 7);
+    };
     
-    XCTAssert([promise deliver:deliveryValue], @"Promise should have been able to be delivered");
+    NSDictionary *groups = [testArray groupedByKeyBlock:block];
     
-    XCTAssert([promise isRealized], @"Promise should be considered resolved");
+    XCTAssertEqual([groups count], (NSUInteger)7, @"There should be a group for each key");
+    XCTAssertEqualObjects([groups[@3] subarrayWithRange:NSMakeRange(0, 3)], (@[@3, @10, @17]), @"Groups should keep the original order");
+    XCTAssertEqualObjects([testArray concurrentGroupedByKeyBlock:block], groups, @"Concurrent grouping should match serial grouping");
+}
 
-    XCTAssert([promise isValid], @"Promise should have been valid");
+#pragma mark - Concurrent collection performance tests
+
+- (void)testConcurrentReducePerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    XCTAssert(![promise deliver:@"hello 1"], @"Promise is already delivered and should not have been able to be delivered again");
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    XCTAssert([[promise deref] isEqualToString:deliveryValue], @"Deref'd value was not equal to the delivered value!");
-
-    XCTAssert(![promise invalidateWithError:nil], @"Shouldn't have been able to invalidate promise");
+    [self measureBlock:^{
+        
+        [testArray concurrentReduceWithIdentity:@0 combine:^id(NSNumber *accumulator, NSNumber *number) {
+            return @([accumulator unsignedIntegerValue] + CBPTestHash([number unsignedIntegerValue], 100) % 10);
+        }];
+        
+    }];
 }
 
-- (void)testPromiseBackgroundResolve
+- (void)testLockedReducePerformance
 {
-    NSString *promiseValue = @"hello";
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    CBPPromise *promise = [[CBPPromise alloc] init];
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    [self measureBlock:^{
         
-        sleep(2);
-        [promise deliver:promiseValue];
+        __block NSNumber *sum = @0;
+        NSObject *lock = [[NSObject alloc] init];
         
-    });
-    
-    XCTAssert([[promise deref] isEqualToString:promiseValue], @"Promise value should have been equal to: 'hello");
+        dispatch_apply([testArray count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            
+            NSUInteger value = CBPTestHash([testArray[i] unsignedIntegerValue], 100) % 10;
+            
+            @synchronized(lock)
+            {
+                sum = @([sum unsignedIntegerValue] + value);
+            }
+            
+        });
+        
+    }];
 }
 
-- (void)testPromiseBlockResolve
+- (void)testConcurrentGroupingPerformance
 {
-    NSString *promiseValue = @"hello";
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    CBPPromise *promise = [[CBPPromise alloc] init];
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    promise.successBlock = ^(id value) {
+    [self measureBlock:^{
+        
+        [testArray concurrentGroupedByKeyBlock:^id<NSCopying>(NSNumber *number) {
+            return @(CBPTestHash([number unsignedIntegerValue], 100) % 1000);
+        }];
+        
+    }];
+}
+
+- (void)testLockedGroupingPerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    [self measureBlock:^{
+        
+        NSMutableDictionary *groups = [NSMutableDictionary dictionary];
+        
+        dispatch_apply([testArray count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            
+            NSNumber *key = @(CBPTestHash([testArray[i] unsignedIntegerValue], 100) % 1000);
+            
+            @synchronized(groups)
+            {
+                NSMutableArray *group = groups[key];
+                
+                if (!group)
+                {
+                    group = [NSMutableArray array];
+                    groups[key] = group;
+                }
+                
+                [group addObject:testArray[i]];
+            }
+            
+        });
+        
+    }];
+}
+
+/*
+ *  Burns roughly @p iterations worth of arithmetic so the scaling test can model blocks of different cost.
+ */
+static NSUInteger CBPTestHash(NSUInteger value, NSUInteger iterations)
+{
+    for (NSUInteger i = 0; i < iterations; i++)
+    {
+        value = (value ^ (value >> 7)) * 0x9E3779B1u + i;
+    }
+    
+    return value;
+}
+
+- (void)testConcurrentMappingScaling
+{
+    //-------------------------------------------------------------------
+    // Logs the time to map arrays of different sizes with blocks of
+    // different cost at different thread counts; the serial threshold in
+    // NSArray+CBPExtensions.m is the smallest size at which the parallel
+    // runs beat the single thread for cheap blocks.
+    //-------------------------------------------------------------------
+    NSArray *costs = @[@0, @100, @1000];
+    NSArray *counts = @[@256, @1024, @2048, @8192, @100000];
+    NSUInteger processorCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    
+    for (NSNumber *cost in costs)
+    {
+        for (NSNumber *count in counts)
+        {
+            NSMutableArray *testArray = [NSMutableArray array];
+            
+            for (NSUInteger i = 0; i < [count unsignedIntegerValue]; i++)
+            {
+                [testArray addObject:@(i)];
+            }
+            
+            NSMutableString *line = [NSMutableString stringWithFormat:@"cost %@, count %@:", cost, count];
+            
+            for (NSUInteger threads = 1; threads <= processorCount; threads *= 2)
+            {
+                __strong id *results = (__strong id *)calloc([testArray count], sizeof(id));
+                NSUInteger iterations = [cost unsignedIntegerValue];
+                
+                CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+                
+                for (NSUInteger run = 0; run < 10; run++)
+                {
+                    CBPParallelApply([testArray count], 64, threads, ^(NSRange range) {
+                        
+                        for (NSUInteger i = range.location; i < NSMaxRange(range); i++)
+                        {
+                            results[i] = @(CBPTestHash([testArray[i] unsignedIntegerValue], iterations));
+                        }
+                        
+                    });
+                }
+                
+                [line appendFormat:@" %lu threads %.3fms", (unsigned long)threads, (CFAbsoluteTimeGetCurrent() - start) * 100.0];
+                
+                for (NSUInteger i = 0; i < [testArray count]; i++)
+                {
+                    results[i] = nil;
+                }
+                
+                free(results);
+            }
+            
+            NSLog(@"%@", line);
+        }
+    }
+}
+
+- (void)testConcurrentMappingPerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    [self measureBlock:^{
+        
+        [testArray concurrentArrayByMappingBlock:^id(NSNumber *number) {
+            return @(CBPTestHash([number unsignedIntegerValue], 100));
+        }];
+        
+    }];
+}
+
+- (void)testSerialMappingPerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    [self measureBlock:^{
+        
+        [testArray arrayByMappingBlock:^id(NSNumber *number) {
+            return @(CBPTestHash([number unsignedIntegerValue], 100));
+        }];
+        
+    }];
+}
+
+- (void)testConcurrentFilteringPerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    [self measureBlock:^{
+        
+        [testArray concurrentFilteredArrayUsingBlock:^BOOL(NSNumber *number) {
+            return CBPTestHash([number unsignedIntegerValue], 100) & 1;
+        }];
+        
+    }];
+}
+
+#pragma mark - Collection allocation tests
+
+- (void)measureCollectionOperation:(NSString *)name count:(NSUInteger)count maximumAllocations:(NSUInteger)maximumAllocations operation:(void (^)(NSArray *array))operation
+{
+    NSMutableArray *testArray = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    NSArray *array = [testArray copy];
+    NSUInteger calls = MAX(1000000 / count, (NSUInteger)10);
+    
+    //-------------------------------------------------------------------
+    // Warm up once so lazily created runtime state isn't counted.
+    //-------------------------------------------------------------------
+    @autoreleasepool
+    {
+        operation(array);
+    }
+    
+    __block CFAbsoluteTime elapsed = 0;
+    
+    NSUInteger allocations = CBPTestCountAllocations(^{
+        
+        for (NSUInteger call = 0; call < calls; call++)
+        {
+            @autoreleasepool
+            {
+                CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+                operation(array);
+                elapsed += CFAbsoluteTimeGetCurrent() - start;
+            }
+        }
+        
+    });
+    
+    double allocationsPerCall = (double)allocations / calls;
+    
+    NSLog(@"%@ (%lu elements): %.2f allocations per call, %.2f ns per element", name, (unsigned long)count, allocationsPerCall, elapsed * 1e9 / (calls * count));
+    
+    XCTAssert(allocationsPerCall <= maximumAllocations, @"%@ made %.2f allocations per call", name, allocationsPerCall);
+}
+
+- (void)measureCollectionOperationsWithCount:(NSUInteger)count
+{
+    //-------------------------------------------------------------------
+    // Mapping returns the existing objects and filtering keeps half of
+    // them, so the only allocations are the collection's own.
+    //-------------------------------------------------------------------
+    [self measureCollectionOperation:@"arrayByMappingBlock:" count:count maximumAllocations:3 operation:^(NSArray *array) {
+        
+        [array arrayByMappingBlock:^id(id object) {
+            return object;
+        }];
+        
+    }];
+    
+    [self measureCollectionOperation:@"filteredArrayUsingBlock:" count:count maximumAllocations:3 operation:^(NSArray *array) {
+        
+        [array filteredArrayUsingBlock:^BOOL(NSNumber *number) {
+            return [number unsignedIntegerValue] & 1;
+        }];
+        
+    }];
+    
+    //-------------------------------------------------------------------
+    // The mutable copy is part of every call here.
+    //-------------------------------------------------------------------
+    [self measureCollectionOperation:@"filterArrayUsingBlock:" count:count maximumAllocations:4 operation:^(NSArray *array) {
+        
+        NSMutableArray *mutableArray = [array mutableCopy];
+        
+        [mutableArray filterArrayUsingBlock:^BOOL(NSNumber *number) {
+            return [number unsignedIntegerValue] & 1;
+        }];
+        
+    }];
+}
+
+- (void)testCollectionOperations10Performance
+{
+    [self measureCollectionOperationsWithCount:10];
+}
+
+- (void)testCollectionOperations1000Performance
+{
+    [self measureCollectionOperationsWithCount:1000];
+}
+
+- (void)testCollectionOperations1000000Performance
+{
+    [self measureCollectionOperationsWithCount:1000000];
+}
+
+#pragma mark - Thread tests
+
+- (void)testBasicThreadExecution
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    
+    __block BOOL someVariable = NO;
+    
+    [thread cbp_performBlockSync:^{
+        someVariable = YES;
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssert(someVariable, @"Thread synchronous execution did not work");
+}
+
+- (void)testThreadMailboxOrdering
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    NSUInteger producerCount = 4;
+    NSUInteger blockCount = 10000;
+    NSMutableArray *results = [NSMutableArray array];
+    
+    for (NSUInteger producer = 0; producer < producerCount; producer++)
+    {
+        [results addObject:[NSMutableArray array]];
+    }
+    
+    dispatch_apply(producerCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+        
+        for (NSUInteger i = 0; i < blockCount; i++)
+        {
+            [thread cbp_performBlockAsync:^{
+                [results[producer] addObject:@(i)];
+            }];
+        }
+        
+    });
+    
+    __block BOOL onThread = NO;
+    
+    [thread cbp_performBlockSync:^{
+        onThread = [NSThread currentThread] == thread;
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssert(onThread, @"blocks should be performed on the target thread");
+    
+    for (NSArray *result in results)
+    {
+        XCTAssertEqual([result count], blockCount, @"every block should be performed before a later synchronous block returns");
+        
+        [result enumerateObjectsUsingBlock:^(NSNumber *number, NSUInteger index, BOOL *stop) {
+            XCTAssertEqual([number unsignedIntegerValue], index, @"blocks from one producer should be performed in order");
+            *stop = [number unsignedIntegerValue] != index;
+        }];
+    }
+}
+
+- (void)testThreadMailboxAsyncFromSameThread
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    NSMutableArray *order = [NSMutableArray array];
+    
+    [thread cbp_performBlockSync:^{
+        
+        [thread cbp_performBlockAsync:^{
+            [order addObject:@2];
+        }];
+        
+        [order addObject:@1];
+        
+    }];
+    
+    [thread cbp_performBlockSync:^{}];
+    [thread cbp_stop];
+    
+    XCTAssertEqualObjects(order, (@[@1, @2]), @"async blocks posted from the thread itself should be performed on a later pass");
+}
+
+- (void)testThreadConfiguration
+{
+    CBPThreadConfiguration *configuration = [[CBPThreadConfiguration alloc] init];
+    configuration.name = @"com.cbpfoundation.tests.configured";
+    configuration.stackSize = 1024 * 1024 + 1;
+    
+    NSThread *thread = [NSThread cbp_runningThreadWithConfiguration:configuration];
+    __block NSString *name = nil;
+    __block NSUInteger stackSize = 0;
+    
+    [thread cbp_performBlockSync:^{
+        name = [NSThread currentThread].name;
+        stackSize = [NSThread currentThread].stackSize;
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssertEqualObjects(name, configuration.name, @"the thread should be named by its configuration");
+    XCTAssertEqual(stackSize, (NSUInteger)(1024 * 1024 + 4096), @"the stack size should be rounded up to a multiple of 4 KB");
+    
+    CBPBackgroundTask *task = [[CBPBackgroundTask alloc] initWithThreadConfiguration:configuration];
+    __block NSString *taskThreadName = nil;
+    
+    task.startBlock = ^{
+        taskThreadName = [NSThread currentThread].name;
+    };
+    
+    task.stopBlock = ^{};
+    
+    [task start];
+    [task stop];
+    
+    XCTAssertEqualObjects(taskThreadName, configuration.name, @"background tasks should start their threads with their configuration");
+}
+
+- (void)testThreadConfigurationNiceLevel
+{
+    CBPThreadConfiguration *configuration = [[CBPThreadConfiguration alloc] init];
+    configuration.niceLevel = 5;
+    
+    XCTAssertEqual([[configuration copy] niceLevel], 5, @"the nice level should be copied");
+    
+    NSThread *thread = [NSThread cbp_runningThreadWithConfiguration:configuration];
+    __block BOOL applied = NO;
+    
+    [thread cbp_performBlockSync:^{
+        applied = [configuration applyToCurrentThread:NULL];
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssert(applied, @"raising the nice level should not need privileges, and it is ignored where unsupported");
+}
+
+- (void)testThreadConfigurationError
+{
+    NSThread *unconfigured = [NSThread cbp_runningThread];
+    
+    XCTAssertNil(unconfigured.cbp_configurationError, @"threads without a configuration should have no error");
+    
+    [unconfigured cbp_stop];
+    
+    CBPThreadConfiguration *configuration = [[CBPThreadConfiguration alloc] init];
+    configuration.schedulingPolicy = CBPThreadSchedulingPolicyFIFO;
+    configuration.schedulingPriority = 47;
+    
+    NSThread *thread = [NSThread cbp_runningThreadWithConfiguration:configuration];
+    NSError *error = thread.cbp_configurationError;
+    __block BOOL applied = NO;
+    __block NSError *reappliedError = nil;
+    
+    [thread cbp_performBlockSync:^{
+        applied = [NSThread cbp_applyConfigurationToCurrentThread:configuration];
+        reappliedError = [NSThread currentThread].cbp_configurationError;
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssertEqual(applied, reappliedError == nil, @"the recorded error should match the result");
+    XCTAssertEqual(error == nil, reappliedError == nil, @"the error should be recorded when the thread starts");
+}
+
+/*
+ *  Sleeps for @p interval over and over on a thread started with @p configuration and logs how late each wakeup was.
+ */
+- (void)logWakeupLatencyWithConfiguration:(CBPThreadConfiguration *)configuration label:(NSString *)label
+{
+    NSUInteger sampleCount = 2000;
+    NSTimeInterval interval = 0.0005;
+    NSMutableData *samples = [NSMutableData dataWithLength:sampleCount * sizeof(uint64_t)];
+    uint64_t *lateness = [samples mutableBytes];
+    NSThread *thread = [NSThread cbp_runningThreadWithConfiguration:configuration];
+    NSError *error = thread.cbp_configurationError;
+    
+    [thread cbp_performBlockSync:^{
+        
+        for (NSUInteger i = 0; i < sampleCount; i++)
+        {
+            struct timespec start;
+            struct timespec end;
+            struct timespec sleep = { .tv_sec = 0, .tv_nsec = (long)(interval * NSEC_PER_SEC) };
+            
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            nanosleep(&sleep, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            
+            uint64_t elapsed = (uint64_t)(end.tv_sec - start.tv_sec) * NSEC_PER_SEC + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+            lateness[i] = elapsed - MIN(elapsed, (uint64_t)sleep.tv_nsec);
+        }
+        
+    }];
+    
+    [thread cbp_stop];
+    
+    qsort_b(lateness, sampleCount, sizeof(uint64_t), ^int(const void *a, const void *b) {
+        uint64_t left = *(const uint64_t *)a;
+        uint64_t right = *(const uint64_t *)b;
+        return left < right ? -1 : left > right;
+    });
+    
+    NSLog(@"%@ wakeup latency: p50 %.1f us, p99 %.1f us, p999 %.1f us%@", label, lateness[sampleCount / 2] / 1e3, lateness[sampleCount * 99 / 100] / 1e3, lateness[sampleCount * 999 / 1000] / 1e3, error ? [NSString stringWithFormat:@" (configuration not applied: %@)", error] : @"");
+}
+
+- (void)testThreadWakeupJitter
+{
+    [self logWakeupLatencyWithConfiguration:nil label:@"Unpinned"];
+    
+    CBPThreadConfiguration *pinned = [[CBPThreadConfiguration alloc] init];
+    pinned.processors = [NSIndexSet indexSetWithIndex:0];
+    [self logWakeupLatencyWithConfiguration:pinned label:@"Pinned"];
+    
+    CBPThreadConfiguration *realtime = [pinned copy];
+    realtime.schedulingPolicy = CBPThreadSchedulingPolicyFIFO;
+    realtime.schedulingPriority = 47;
+    [self logWakeupLatencyWithConfiguration:realtime label:@"Pinned FIFO"];
+}
+
+#pragma mark - Thread messaging performance tests
+
+- (void)measureThreadPingPongUsingMailbox:(BOOL)useMailbox
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    dispatch_block_t block = ^{};
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            if (useMailbox)
+            {
+                [thread cbp_performBlockSync:block];
+            }
+            else
+            {
+                [thread performSelector:@selector(cbp_doPerformBlock:) onThread:thread withObject:block waitUntilDone:YES];
+            }
+        }
+        
+    }];
+    
+    [thread cbp_stop];
+}
+
+- (void)measureThreadThroughputUsingMailbox:(BOOL)useMailbox
+{
+    NSThread *thread = [NSThread cbp_runningThread];
+    NSUInteger producerCount = 4;
+    NSUInteger blockCount = 25000;
+    __block NSUInteger performed = 0;
+    
+    dispatch_block_t block = ^{
+        performed++;
+    };
+    
+    [self measureBlock:^{
+        
+        dispatch_apply(producerCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+            
+            for (NSUInteger i = 0; i < blockCount; i++)
+            {
+                if (useMailbox)
+                {
+                    [thread cbp_performBlockAsync:block];
+                }
+                else
+                {
+                    [thread performSelector:@selector(cbp_doPerformBlock:) onThread:thread withObject:block waitUntilDone:NO];
+                }
+            }
+            
+        });
+        
+        [thread cbp_performBlockSync:^{}];
+        
+    }];
+    
+    [thread cbp_stop];
+    
+    XCTAssertEqual(performed % (producerCount * blockCount), (NSUInteger)0, @"every block should be performed");
+}
+
+- (void)testThreadMailboxPingPongPerformance
+{
+    [self measureThreadPingPongUsingMailbox:YES];
+}
+
+- (void)testThreadPerformSelectorPingPongPerformance
+{
+    [self measureThreadPingPongUsingMailbox:NO];
+}
+
+- (void)testThreadMailboxThroughputPerformance
+{
+    [self measureThreadThroughputUsingMailbox:YES];
+}
+
+- (void)testThreadPerformSelectorThroughputPerformance
+{
+    [self measureThreadThroughputUsingMailbox:NO];
+}
+
+#pragma mark - CBPBackgroundTask tests
+
+- (void)testBasicBackgroundTask
+{
+    CBPBackgroundTask *task = [[CBPBackgroundTask alloc] init];
+    
+    __block BOOL someVariable = NO;
+    
+    task.startBlock = ^{
+        
+        someVariable = YES;
+        
+    };
+    
+    task.stopBlock = ^{
+        
+        someVariable = NO;
+        
+    };
+    
+    [task start];
+    
+    XCTAssert(someVariable, @"Task did not start");
+    
+    [task stop];
+    
+    XCTAssert(!someVariable, @"Task did not finish");
+}
+
+- (void)testPooledBackgroundTasks
+{
+    CBPRunLoopThreadPool *pool = [[CBPRunLoopThreadPool alloc] initWithNumberOfThreads:4];
+    NSArray *threads = pool.threads;
+    NSMutableArray *tasks = [NSMutableArray array];
+    NSMutableArray *startThreads = [NSMutableArray array];
+    NSMutableArray *stopThreads = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        CBPBackgroundTask *task = [[CBPBackgroundTask alloc] initWithThreadPool:pool];
+        
+        task.startBlock = ^{
+            
+            @synchronized (startThreads)
+            {
+                [startThreads addObject:[NSThread currentThread]];
+            }
+            
+        };
+        
+        task.stopBlock = ^{
+            
+            @synchronized (stopThreads)
+            {
+                [stopThreads addObject:[NSThread currentThread]];
+            }
+            
+        };
+        
+        [task start];
+        [tasks addObject:task];
+    }
+    
+    for (NSThread *thread in threads)
+    {
+        XCTAssertEqual([pool numberOfClientsForThread:thread], (NSUInteger)25, @"tasks should be spread evenly over the pool");
+    }
+    
+    NSArray *runningThreads = [tasks valueForKey:@"thread"];
+    
+    for (CBPBackgroundTask *task in tasks)
+    {
+        [task stop];
+    }
+    
+    XCTAssertEqualObjects(startThreads, runningThreads, @"tasks should start on their pool thread");
+    XCTAssertEqualObjects(stopThreads, runningThreads, @"tasks should stop on the thread they started on");
+    XCTAssertEqualObjects(pool.threads, threads, @"starting and stopping tasks should not create threads");
+    
+    for (NSThread *thread in threads)
+    {
+        XCTAssertEqual([pool numberOfClientsForThread:thread], (NSUInteger)0, @"stopped tasks should relinquish their threads");
+        XCTAssertFalse(thread.isCancelled, @"stopped tasks should not stop pool threads");
+    }
+    
+    [pool invalidate];
+}
+
+- (void)testBackgroundTaskStartStopPerformance
+{
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 100; i++)
+        {
+            CBPBackgroundTask *task = [[CBPBackgroundTask alloc] init];
+            task.startBlock = ^{};
+            task.stopBlock = ^{};
+            [task start];
+            [task stop];
+        }
+        
+    }];
+}
+
+- (void)testPooledBackgroundTaskStartStopPerformance
+{
+    CBPRunLoopThreadPool *pool = [CBPRunLoopThreadPool sharedPool];
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 100; i++)
+        {
+            CBPBackgroundTask *task = [[CBPBackgroundTask alloc] initWithThreadPool:pool];
+            task.startBlock = ^{};
+            task.stopBlock = ^{};
+            [task start];
+            [task stop];
+        }
+        
+    }];
+}
+
+#pragma mark - Fiber tests
+
+- (void)testFiberDerefSuspends
+{
+    if (![CBPFiberScheduler isSupported])
+    {
+        XCTAssertThrows([[CBPFiberScheduler alloc] init], @"unsupported platforms should throw");
+        return;
+    }
+    
+    CBPFiberScheduler *scheduler = [[CBPFiberScheduler alloc] initWithNumberOfThreads:1 stackSize:64 * 1024];
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    CBPPromise *waiterThread = [[CBPPromise alloc] init];
+    CBPPromise *result = [[CBPPromise alloc] init];
+    CBPPromise *otherRan = [[CBPPromise alloc] init];
+    
+    [scheduler spawnFiber:^{
+        
+        NSThread *thread = [NSThread currentThread];
+        [waiterThread deliver:thread];
+        [result deliver:@[[promise deref], @([CBPFiberScheduler isRunningInFiber]), @([NSThread currentThread] == thread)]];
+        
+    }];
+    
+    [waiterThread deref];
+    
+    //-------------------------------------------------------------------
+    // The scheduler has a single thread, so this fiber can only run if the
+    // first one suspended instead of blocking.
+    //-------------------------------------------------------------------
+    [scheduler spawnFiber:^{
+        
+        [otherRan deliver:@YES];
+        
+    }];
+    
+    XCTAssertEqualObjects([otherRan derefWithTimeoutInterval:5 timeoutValue:@NO], @YES, @"a suspended fiber should not block its thread");
+    XCTAssert(![result isRealized], @"the fiber should still be waiting");
+    
+    [promise deliver:@1];
+    
+    XCTAssertEqualObjects([result derefWithTimeoutInterval:5 timeoutValue:nil], (@[@1, @YES, @YES]), @"the fiber should resume on its own thread with the value");
+    XCTAssertFalse([CBPFiberScheduler isRunningInFiber], @"the test thread is not a fiber");
+    
+    [scheduler invalidate];
+}
+
+- (void)testFiberDerefNestedFuture
+{
+    if (![CBPFiberScheduler isSupported])
+    {
+        return;
+    }
+    
+    CBPFiberScheduler *scheduler = [[CBPFiberScheduler alloc] initWithNumberOfThreads:1 stackSize:64 * 1024];
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    CBPPromise *waiting = [[CBPPromise alloc] init];
+    CBPPromise *result = [[CBPPromise alloc] init];
+    CBPPromise *otherRan = [[CBPPromise alloc] init];
+    
+    [scheduler spawnFiber:^{
+        
+        CBPFuture *future = [[CBPFuture alloc] initWithExecutor:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+            
+            @autoreleasepool
+            {
+                return @([[promise deref] integerValue] + 1);
+            }
+            
+        }];
+        
+        [waiting deliver:@YES];
+        [result deliver:[future deref]];
+        
+    }];
+    
+    [waiting deref];
+    
+    [scheduler spawnFiber:^{
+        
+        [otherRan deliver:@YES];
+        
+    }];
+    
+    XCTAssertEqualObjects([otherRan derefWithTimeoutInterval:5 timeoutValue:@NO], @YES, @"a fiber waiting on a future should suspend instead of running its work");
+    
+    [promise deliver:@1];
+    
+    XCTAssertEqualObjects([result derefWithTimeoutInterval:5 timeoutValue:nil], @2, @"the fiber should resume with the future's value");
+    
+    [scheduler invalidate];
+}
+
+- (void)testManyFibersOnFewThreads
+{
+    if (![CBPFiberScheduler isSupported])
+    {
+        return;
+    }
+    
+    CBPFiberScheduler *scheduler = [[CBPFiberScheduler alloc] initWithNumberOfThreads:2 stackSize:32 * 1024];
+    NSUInteger count = 5000;
+    NSMutableArray *promises = [NSMutableArray array];
+    _Atomic(NSUInteger) sum;
+    atomic_init(&sum, 0);
+    _Atomic(NSUInteger) *sumPointer = &sum;
+    
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        CBPPromise *promise = [[CBPPromise alloc] init];
+        [promises addObject:promise];
+        
+        [scheduler spawnFiber:^{
+            
+            atomic_fetch_add_explicit(sumPointer, [[promise deref] unsignedIntegerValue], memory_order_relaxed);
+            
+        }];
+    }
+    
+    XCTAssertEqual(scheduler.numberOfFibers, count, @"every fiber should be suspended");
+    
+    [promises enumerateObjectsUsingBlock:^(CBPPromise *promise, NSUInteger idx, BOOL *stop) {
+        
+        [promise deliver:@(idx)];
+        
+    }];
+    
+    [scheduler invalidate];
+    
+    XCTAssertEqual(scheduler.numberOfFibers, (NSUInteger)0, @"-invalidate should wait for every fiber");
+    XCTAssertEqual(atomic_load(&sum), (count - 1) * count / 2, @"every fiber should see its value");
+    XCTAssertThrows([scheduler spawnFiber:^{}], @"an invalidated scheduler should not spawn fibers");
+}
+
+- (void)testFiberTimedDerefBlocks
+{
+    if (![CBPFiberScheduler isSupported])
+    {
+        return;
+    }
+    
+    CBPFiberScheduler *scheduler = [[CBPFiberScheduler alloc] initWithNumberOfThreads:1 stackSize:64 * 1024];
+    CBPPromise *result = [[CBPPromise alloc] init];
+    
+    [scheduler spawnFiber:^{
+        
+        CBPPromise *promise = [[CBPPromise alloc] init];
+        [result deliver:[promise derefWithTimeoutInterval:0.01 timeoutValue:@"timeout"]];
+        
+    }];
+    
+    XCTAssertEqualObjects([result derefWithTimeoutInterval:5 timeoutValue:nil], @"timeout", @"timed derefs should time out in a fiber");
+    
+    [scheduler invalidate];
+}
+
+#pragma mark - Fiber performance tests
+
+- (void)testFiberDerefPerformance
+{
+    if (![CBPFiberScheduler isSupported])
+    {
+        return;
+    }
+    
+    CBPFiberScheduler *scheduler = [[CBPFiberScheduler alloc] init];
+    
+    [self measureBlock:^{
+        
+        NSMutableArray *promises = [NSMutableArray array];
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            CBPPromise *promise = [[CBPPromise alloc] init];
+            [promises addObject:promise];
+            
+            [scheduler spawnFiber:^{
+                
+                [promise deref];
+                
+            }];
+        }
+        
+        for (CBPPromise *promise in promises)
+        {
+            [promise deliver:@YES];
+        }
+        
+        while (scheduler.numberOfFibers)
+        {
+            usleep(100);
+        }
+        
+    }];
+    
+    [scheduler invalidate];
+}
+
+#pragma mark - Promise tests
+
+- (void)testPromiseBasics
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    
+    NSString *deliveryValue = @"hello";
+    
+    XCTAssert(![promise isRealized], @"Promise should not be considered resolved");
+    
+    XCTAssert([promise deliver:deliveryValue], @"Promise should have been able to be delivered");
+    
+    XCTAssert([promise isRealized], @"Promise should be considered resolved");
+
+    XCTAssert([promise isValid], @"Promise should have been valid");
+    
+    XCTAssert(![promise deliver:@"hello 1"], @"Promise is already delivered and should not have been able to be delivered again");
+    
+    XCTAssert([[promise deref] isEqualToString:deliveryValue], @"Deref'd value was not equal to the delivered value!");
+
+    XCTAssert(![promise invalidateWithError:nil], @"Shouldn't have been able to invalidate promise");
+}
+
+- (void)testPromiseBackgroundResolve
+{
+    NSString *promiseValue = @"hello";
+    
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        sleep(2);
+        [promise deliver:promiseValue];
+        
+    });
+    
+    XCTAssert([[promise deref] isEqualToString:promiseValue], @"Promise value should have been equal to: 'hello");
+}
+
+- (void)testPromiseBlockResolve
+{
+    NSString *promiseValue = @"hello";
+    
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    
+    promise.successBlock = ^(id value) {
+
+        XCTAssert([value isEqualToString:promiseValue], @"Promise value should have been equal to: 'hello");
+        XCTAssert(![value isEqualToString:@""], @"Promise value should not have been equal to: '");
+        
+    };
+
+    sleep(1);
+    
+    [promise deliver:promiseValue];
+
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate distantFuture]];
+}
+
+- (void)testPromiseBackgroundResolveTimeout
+{
+    NSString *promiseValue = @"hello";
+    
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        sleep(2);
+        [promise deliver:promiseValue];
+        
+    });
+    
+    XCTAssert([[promise derefWithTimeoutInterval:0.2 timeoutValue:@""] isEqualToString:@""], @"Promise should have timedout and equaled been equal to the empty string");
+    
+    XCTAssert([[promise derefWithTimeoutInterval:5.0 timeoutValue:@""] isEqualToString:promiseValue], @"Promise shouldn't have timedout and show have been equal to: '%@'", promiseValue);
+}
+
+- (void)testPromiseTimeoutTimeout
+{
+    CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:2.0];
+
+    sleep(3);
+
+    XCTAssert(![promise deliver:@""], @"Shouldn't have been able to deliver because of timeout");
+
+    XCTAssert([promise deref] == CBPPromiseTimeoutValue, @"Promise should have equaled timeout value");
+}
+
+- (void)testPromiseTimeoutSucceed
+{
+    CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:2.0];
+
+    sleep(1);
+
+    NSString *deliveryValue = @"";
+
+    XCTAssert([promise deliver:deliveryValue], @"Should have been able to deliver");
+
+    XCTAssert([promise deref] == deliveryValue, @"Promise should have equaled ''");
+}
+
+- (void)testPromiseInvalidateImmediate
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    XCTAssert([promise invalidateWithError:nil], @"Should have been able to invalidate promise");
+    XCTAssertEqualObjects(CBPDerefInvalidValue, [promise deref], @"Deref value should have been the invalid value");
+    XCTAssert(![promise deliver:nil], @"Shouldn't have been able to deliver promise");
+}
+
+- (void)testPromiseInvalidateDelay
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        sleep(2);
+        [promise invalidateWithError:nil];
+
+    });
+
+    XCTAssertEqualObjects([promise deref], CBPDerefInvalidValue, @"Deref should have returned the invalid value");
+}
+
+#pragma mark - Callback delivery tests
+
+- (void)testInlineCallbackDelivery
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    promise.callbackDelivery = CBPDerefCallbackDeliveryInline;
+    
+    __block NSThread *callbackThread = nil;
+    __block NSError *callbackError = nil;
+    
+    promise.invalidBlock = ^(NSError *error) {
+        callbackThread = [NSThread currentThread];
+        callbackError = error;
+    };
+    
+    NSError *error = [NSError errorWithDomain:@"CBPFoundationTests" code:1 userInfo:nil];
+    [promise invalidateWithError:error];
+    
+    XCTAssertEqual(callbackThread, [NSThread currentThread], @"the callback should have run on the invalidating thread");
+    XCTAssertEqualObjects(callbackError, error, @"the callback should have received the error");
+}
+
+- (void)testBatchedCallbackDelivery
+{
+    dispatch_queue_t queue = dispatch_queue_create("com.cbpfoundation.tests.callbacks", DISPATCH_QUEUE_SERIAL);
+    NSMutableArray *values = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        CBPPromise *promise = [[CBPPromise alloc] init];
+        promise.callbackDelivery = CBPDerefCallbackDeliveryBatched;
+        promise.callbackQueue = queue;
+        promise.successBlock = ^(id value) {
+            [values addObject:value];
+        };
+        
+        [promise deliver:@(i)];
+    }
+    
+    dispatch_sync(queue, ^{});
+    
+    XCTAssertEqual([values count], (NSUInteger)1000, @"every callback should have run");
+    
+    [values enumerateObjectsUsingBlock:^(NSNumber *value, NSUInteger idx, BOOL *stop) {
+        XCTAssertEqual([value unsignedIntegerValue], idx, @"callbacks should run in the order their derefs were realized");
+    }];
+}
+
+#pragma mark - Callback delivery performance tests
+
+- (void)measureCallbackLatencyWithDelivery:(CBPDerefCallbackDelivery)callbackDelivery
+{
+    dispatch_queue_t queue = dispatch_queue_create("com.cbpfoundation.tests.callbacks", DISPATCH_QUEUE_SERIAL);
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            CBPPromise *promise = [[CBPPromise alloc] init];
+            promise.callbackDelivery = callbackDelivery;
+            promise.callbackQueue = queue;
+            promise.successBlock = ^(id value) {
+                dispatch_semaphore_signal(semaphore);
+            };
+            
+            [promise deliver:@(i)];
+            dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        }
+        
+    }];
+}
+
+- (void)measureCallbackThroughputWithDelivery:(CBPDerefCallbackDelivery)callbackDelivery
+{
+    dispatch_queue_t queue = dispatch_queue_create("com.cbpfoundation.tests.callbacks", DISPATCH_QUEUE_SERIAL);
+    
+    [self measureBlock:^{
+        
+        dispatch_group_t group = dispatch_group_create();
+        
+        dispatch_apply(4, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+            
+            for (NSUInteger i = 0; i < 25000; i++)
+            {
+                CBPPromise *promise = [[CBPPromise alloc] init];
+                promise.callbackDelivery = callbackDelivery;
+                promise.callbackQueue = queue;
+                
+                dispatch_group_enter(group);
+                promise.successBlock = ^(id value) {
+                    dispatch_group_leave(group);
+                };
+                
+                [promise deliver:@(i)];
+            }
+            
+        });
+        
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        
+    }];
+}
+
+- (void)testQueueCallbackLatencyPerformance
+{
+    [self measureCallbackLatencyWithDelivery:CBPDerefCallbackDeliveryQueue];
+}
+
+- (void)testInlineCallbackLatencyPerformance
+{
+    [self measureCallbackLatencyWithDelivery:CBPDerefCallbackDeliveryInline];
+}
+
+- (void)testBatchedCallbackLatencyPerformance
+{
+    [self measureCallbackLatencyWithDelivery:CBPDerefCallbackDeliveryBatched];
+}
+
+- (void)testQueueCallbackThroughputPerformance
+{
+    [self measureCallbackThroughputWithDelivery:CBPDerefCallbackDeliveryQueue];
+}
+
+- (void)testInlineCallbackThroughputPerformance
+{
+    [self measureCallbackThroughputWithDelivery:CBPDerefCallbackDeliveryInline];
+}
+
+- (void)testBatchedCallbackThroughputPerformance
+{
+    [self measureCallbackThroughputWithDelivery:CBPDerefCallbackDeliveryBatched];
+}
+
+#pragma mark - Future tests
+
+- (void)testFutureDerefSameThread
+{
+    NSString *value = @"";
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+        
+        sleep(5.0);
+        
+        return value;
+        
+    }];
+    
+    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
+    });
+    
+    XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
+}
+
+- (void)testFutureDerefDifferentThread
+{
+    NSString *value = @"";
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+        
+        sleep(5.0);
+        
+        return value;
+        
+    }];
+    
+    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
+    });
+}
+
+- (void)testFutureDerefTimeout
+{
+    NSString *value = @"";
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+        
+        sleep(5.0);
+        
+        return value;
+        
+    }];
+    
+    XCTAssert([[future derefWithTimeoutInterval:1.0 timeoutValue:@"hello"] isEqualToString:@"hello"], @"Future deref did not work");
+    
+    XCTAssert(![future isRealized], @"Future shouldn't be realized");
+    
+    XCTAssert([[future derefWithTimeoutInterval:10.0 timeoutValue:@"hello"] isEqualToString:value], @"Future deref did not work");
+    
+    XCTAssert([future isRealized], @"Future should be realized");
+}
+
+- (void)testFutureDerefCancel
+{
+    NSString *value = @"";
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+        
+        sleep(5.0);
+        
+        return value;
+        
+    }];
+    
+    sleep(1);
+    
+    XCTAssert(![future isRealized], @"Should not have been realized");
+    
+    XCTAssert([future invalidateWithError:nil], @"Should have been able to cancel future");
+    
+    XCTAssert([future isRealized], @"Should have been realized");
+    
+    XCTAssert(![future invalidateWithError:nil], @"Should not have been able to cancel future");
+    
+    XCTAssert([[future derefWithTimeoutInterval:10.0 timeoutValue:@"hello"] isEqualToString:CBPDerefInvalidValue], @"Future deref did not work");
+}
+
+#pragma mark - Typed future tests
+
+- (void)testInt64Future
+{
+    CBPInt64Future *future = [[CBPInt64Future alloc] initWithExecutor:nil int64WorkBlock:^int64_t(CBPFutureCanceledBlock isCanceled) {
+        return INT64_MAX;
+    }];
+    
+    XCTAssertEqual([future derefInt64], INT64_MAX, @"the typed result should be stored inline");
+    XCTAssertEqualObjects([future deref], @(INT64_MAX), @"-deref should box the result");
+    
+    CBPDeref *mapped = [future map:^id(NSNumber *value) {
+        return @([value longLongValue] - 1);
+    }];
+    
+    XCTAssertEqualObjects([mapped deref], @(INT64_MAX - 1), @"continuations should receive the boxed result");
+}
+
+- (void)testDoubleFutureInvalid
+{
+    CBPDoubleFuture *future = [[CBPDoubleFuture alloc] initWithExecutor:[CBPExecutor executorWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)] doubleWorkBlock:^double(CBPFutureCanceledBlock isCanceled) {
+        usleep(100000);
+        return 1.5;
+    }];
+    
+    XCTAssertEqual([future derefDoubleWithTimeoutInterval:0.01 timeoutValue:-1], -1.0, @"the timeout value should be returned");
+    
+    [future invalidateWithError:nil];
+    
+    XCTAssert(isnan([future derefDouble]), @"an invalidated future should return NAN");
+    XCTAssertEqualObjects([future deref], CBPDerefInvalidValue, @"-deref should return the invalid value");
+}
+
+- (void)testStructFuture
+{
+    CBPStructFuture *future = [[CBPStructFuture alloc] initWithObjCType:@encode(NSRange) executor:nil cancellationToken:nil workBlock:^(void *result, CBPFutureCanceledBlock isCanceled) {
+        *(NSRange *)result = NSMakeRange(3, 4);
+    }];
+    
+    NSRange range = NSMakeRange(0, 0);
+    
+    XCTAssert([future derefValue:&range], @"the result should be copied");
+    XCTAssertEqual(range.location, (NSUInteger)3, @"the location should be stored inline");
+    XCTAssertEqual(range.length, (NSUInteger)4, @"the length should be stored inline");
+    XCTAssertEqual([[future deref] rangeValue].length, (NSUInteger)4, @"-deref should box the result in an NSValue");
+    XCTAssertThrows([[CBPStructFuture alloc] initWithObjCType:"[128c]" executor:nil cancellationToken:nil workBlock:^(void *result, CBPFutureCanceledBlock isCanceled) {}], @"oversized types should be rejected");
+}
+
+- (void)testTypedFutureAllocations
+{
+    //-------------------------------------------------------------------
+    // The queue never runs the work, so each deref claims it and assigns
+    // the result on this thread, inside the counted block.
+    //-------------------------------------------------------------------
+    dispatch_queue_t queue = dispatch_queue_create("com.cbpfoundation.tests.suspended", DISPATCH_QUEUE_CONCURRENT);
+    dispatch_suspend(queue);
+    CBPExecutor *executor = [[CBPQueueExecutor alloc] initWithQueue:queue allowsInlineExecution:YES];
+    
+    CBPInt64Future *warmup = [[CBPInt64Future alloc] initWithExecutor:executor int64WorkBlock:^int64_t(CBPFutureCanceledBlock isCanceled) { return 0; }];
+    [warmup derefInt64];
+    
+    CBPInt64Future *int64Future = [[CBPInt64Future alloc] initWithExecutor:executor int64WorkBlock:^int64_t(CBPFutureCanceledBlock isCanceled) { return 7; }];
+    CBPDoubleFuture *doubleFuture = [[CBPDoubleFuture alloc] initWithExecutor:executor doubleWorkBlock:^double(CBPFutureCanceledBlock isCanceled) { return 0.5; }];
+    CBPStructFuture *structFuture = [[CBPStructFuture alloc] initWithObjCType:@encode(NSRange) executor:executor cancellationToken:nil workBlock:^(void *result, CBPFutureCanceledBlock isCanceled) {
+        *(NSRange *)result = NSMakeRange(1, 2);
+    }];
+    
+    __block int64_t int64Value = 0;
+    __block double doubleValue = 0;
+    __block NSRange range = NSMakeRange(0, 0);
+    
+    NSUInteger allocations = CBPTestCountAllocations(^{
+        int64Value = [int64Future derefInt64];
+        doubleValue = [doubleFuture derefDouble];
+        [structFuture derefValue:&range];
+    });
+    
+    dispatch_resume(queue);
+    
+    XCTAssertEqual(int64Value, (int64_t)7, @"the int64 result should be read");
+    XCTAssertEqual(doubleValue, 0.5, @"the double result should be read");
+    XCTAssertEqual(range.length, (NSUInteger)2, @"the struct result should be read");
+    XCTAssertEqual(allocations, (NSUInteger)0, @"assigning and reading typed results should not allocate");
+}
+
+- (void)testTypedFutureRejectsObjectWorkBlock
+{
+    XCTAssertThrows([[CBPInt64Future alloc] initWithExecutor:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) { return nil; }], @"the object initializers should throw");
+}
+
+#pragma mark - Typed future performance tests
+
+- (void)testInt64FuturePerformance
+{
+    [self measureBlock:^{
+        
+        int64_t sum = 0;
+        
+        for (NSUInteger i = 0; i < 100000; i++)
+        {
+            sum += [[[CBPInt64Future alloc] initWithExecutor:nil int64WorkBlock:^int64_t(CBPFutureCanceledBlock isCanceled) { return (int64_t)i; }] derefInt64];
+        }
+        
+        XCTAssertEqual(sum, (int64_t)(99999 * 100000 / 2), @"every result should be summed");
+        
+    }];
+}
+
+- (void)testBoxedFuturePerformance
+{
+    [self measureBlock:^{
+        
+        int64_t sum = 0;
+        
+        for (NSUInteger i = 0; i < 100000; i++)
+        {
+            sum += [[[[CBPFuture alloc] initWithExecutor:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) { return @((int64_t)i); }] deref] longLongValue];
+        }
+        
+        XCTAssertEqual(sum, (int64_t)(99999 * 100000 / 2), @"every result should be summed");
+        
+    }];
+}
+
+#pragma mark - Future cache tests
+
+- (void)testFutureCacheSingleFlight
+{
+    CBPFutureCache *cache = [[CBPFutureCache alloc] init];
+    __block _Atomic(NSUInteger) workCount = 0;
+    NSMutableSet *derefs = [NSMutableSet set];
+    
+    dispatch_apply(100, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        
+        CBPDeref *deref = [cache derefForKey:@"key" workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+            atomic_fetch_add(&workCount, 1);
+            usleep(50000);
+            return @"value";
+        }];
+        
+        @synchronized(derefs)
+        {
+            [derefs addObject:[NSValue valueWithNonretainedObject:deref]];
+        }
+        
+        XCTAssertEqualObjects([deref deref], @"value", @"every caller should see the value");
+        
+    });
+    
+    XCTAssertEqual(atomic_load(&workCount), (NSUInteger)1, @"the work should only have run once");
+    XCTAssertEqual([derefs count], (NSUInteger)1, @"every caller should have received the same deref");
+    XCTAssertEqual(cache.missCount, (uint64_t)1, @"only the first lookup should miss");
+    XCTAssertEqual(cache.hitCount + cache.coalescedCount, (uint64_t)99, @"every other lookup should hit or coalesce");
+}
+
+- (void)testFutureCacheDropsInvalidatedFutures
+{
+    CBPFutureCache *cache = [[CBPFutureCache alloc] init];
+    CBPFutureWorkBlock workBlock = ^id(CBPFutureCanceledBlock isCanceled) {
+        usleep(50000);
+        return @"value";
+    };
+    
+    CBPDeref *deref = [cache derefForKey:@"key" workBlock:workBlock];
+    [deref invalidateWithError:nil];
+    
+    XCTAssertNil([cache cachedDerefForKey:@"key"], @"an invalidated future should not be cached");
+    XCTAssertEqual(cache.count, (NSUInteger)0, @"an invalidated future should be removed");
+    
+    CBPDeref *retriedDeref = [cache derefForKey:@"key" workBlock:workBlock];
+    
+    XCTAssertNotEqual(retriedDeref, deref, @"the next caller should start over");
+    XCTAssertEqualObjects([retriedDeref deref], @"value", @"the retried work should complete");
+    XCTAssertEqual(cache.missCount, (uint64_t)2, @"both lookups should miss");
+}
+
+- (void)testFutureCacheEviction
+{
+    CBPFutureCache *cache = [[CBPFutureCache alloc] initWithCountLimit:2 timeToLive:0 executor:nil];
+    
+    for (NSUInteger i = 0; i < 10; i++)
+    {
+        [[cache derefForKey:@(i) workBlock:^id(CBPFutureCanceledBlock isCanceled) { return @(i); }] deref];
+    }
+    
+    XCTAssertLessThanOrEqual(cache.count, (NSUInteger)2, @"the cache should stay under its count limit");
+    XCTAssertEqual(cache.evictionCount, (uint64_t)(10 - cache.count), @"every entry beyond the limit should have been evicted");
+    XCTAssertNotNil([cache cachedDerefForKey:@9], @"the newest entry should be cached");
+}
+
+- (void)testFutureCacheTimeToLive
+{
+    CBPFutureCache *cache = [[CBPFutureCache alloc] initWithCountLimit:0 timeToLive:0.05 executor:nil];
+    
+    [[cache derefForKey:@"key" workBlock:^id(CBPFutureCanceledBlock isCanceled) { return @"value"; }] deref];
+    
+    XCTAssertNotNil([cache cachedDerefForKey:@"key"], @"the entry should be cached until it expires");
+    
+    usleep(100000);
+    
+    XCTAssertNil([cache cachedDerefForKey:@"key"], @"the entry should have expired");
+}
+
+#pragma mark - Future cache performance tests
+
+- (void)testFutureCacheHitPerformance
+{
+    CBPFutureCache *cache = [[CBPFutureCache alloc] initWithCountLimit:1000 timeToLive:0 executor:nil];
+    CBPFutureWorkBlock workBlock = ^id(CBPFutureCanceledBlock isCanceled) {
+        return @"value";
+    };
+    
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [[cache derefForKey:@(i) workBlock:workBlock] deref];
+    }
+    
+    [self measureBlock:^{
+        
+        dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+            
+            for (NSUInteger i = 0; i < 100000; i++)
+            {
+                [cache derefForKey:@(i % 1000) workBlock:workBlock];
+            }
+            
+        });
+        
+    }];
+}
+
+#pragma mark - Batcher tests
+
+- (void)testBatcherCoalescesKeys
+{
+    NSMutableArray *batches = [NSMutableArray array];
+    
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:100 maximumDelay:0.05 maximumConcurrentBatches:0 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        
+        @synchronized(batches)
+        {
+            [batches addObject:keys];
+        }
+        
+        NSMutableDictionary *results = [NSMutableDictionary dictionary];
+        
+        for (NSNumber *key in keys)
+        {
+            results[key] = @([key integerValue] * 2);
+        }
+        
+        return results;
+        
+    }];
+    
+    NSMutableArray *promises = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [promises addObject:[batcher promiseForKey:@(i % 10)]];
+    }
+    
+    XCTAssertEqual(promises[0], promises[10], @"duplicate keys should share a promise");
+    
+    [promises enumerateObjectsUsingBlock:^(CBPPromise *promise, NSUInteger idx, BOOL *stop) {
+        XCTAssertEqualObjects([promise deref], @((idx % 10) * 2), @"each promise should be delivered with its result");
+    }];
+    
+    XCTAssertEqual([batches count], (NSUInteger)1, @"every key should have gone in one batch");
+    XCTAssertEqual([[batches firstObject] count], (NSUInteger)10, @"the batch should hold each distinct key once");
+}
+
+- (void)testBatcherReleasedWhileBatchFills
+{
+    CBPPromise *promise = nil;
+    
+    @autoreleasepool
+    {
+        CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:100 maximumDelay:0.05 maximumConcurrentBatches:1 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+            return @{ [keys firstObject] : @YES };
+        }];
+        
+        promise = [batcher promiseForKey:@0];
+    }
+    
+    XCTAssertEqualObjects([promise derefWithTimeoutInterval:5 timeoutValue:nil], @YES, @"a filling batch should still be sent after its batcher is released");
+}
+
+- (void)testBatcherBlockThrows
+{
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:1 maximumDelay:60 maximumConcurrentBatches:1 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        
+        if ([[keys firstObject] isEqual:@0])
+        {
+            [NSException raise:NSInternalInconsistencyException format:@"test"];
+        }
+        
+        return @{ [keys firstObject] : @YES };
+        
+    }];
+    
+    CBPPromise *failed = [batcher promiseForKey:@0];
+    CBPPromise *next = [batcher promiseForKey:@1];
+    
+    XCTAssertEqualObjects([failed derefWithTimeoutInterval:5 timeoutValue:nil], CBPDerefInvalidValue, @"a throwing batch should invalidate its promises");
+    XCTAssertEqualObjects([next derefWithTimeoutInterval:5 timeoutValue:nil], @YES, @"a throwing batch should release its concurrency slot");
+}
+
+- (void)testBatcherMaximumBatchSize
+{
+    NSMutableArray *batchSizes = [NSMutableArray array];
+    
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:10 maximumDelay:60 maximumConcurrentBatches:1 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        
+        [batchSizes addObject:@([keys count])];
+        
+        return @{};
+        
+    }];
+    
+    NSMutableArray *promises = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 25; i++)
+    {
+        [promises addObject:[batcher promiseForKey:@(i)]];
+    }
+    
+    [batcher flush];
+    
+    for (CBPPromise *promise in promises)
+    {
+        XCTAssertEqualObjects([promise deref], CBPDerefInvalidValue, @"keys without results should be invalidated");
+    }
+    
+    XCTAssertEqualObjects(batchSizes, (@[@10, @10, @5]), @"full batches should be sent as soon as they fill");
+}
+
+- (void)testBatcherErrorResults
+{
+    NSError *error = [NSError errorWithDomain:@"CBPFoundationTests" code:1 userInfo:nil];
+    
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:2 maximumDelay:60 maximumConcurrentBatches:0 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        return @{@"good": @"value", @"bad": error};
+    }];
+    
+    CBPPromise *good = [batcher promiseForKey:@"good"];
+    CBPPromise *bad = [batcher promiseForKey:@"bad"];
+    
+    XCTAssertEqualObjects([good deref], @"value", @"the good key should be delivered");
+    XCTAssertEqualObjects([bad deref], CBPDerefInvalidValue, @"the bad key should be invalidated");
+    XCTAssertEqualObjects(bad.error, error, @"the bad key should be invalidated with its error");
+}
+
+- (void)testBatcherConcurrencyLimit
+{
+    __block _Atomic(NSInteger) running = 0;
+    __block _Atomic(NSInteger) maximumRunning = 0;
+    
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:1 maximumDelay:60 maximumConcurrentBatches:2 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        
+        NSInteger nowRunning = atomic_fetch_add(&running, 1) + 1;
+        NSInteger previousMaximum = atomic_load(&maximumRunning);
+        
+        while (nowRunning > previousMaximum && !atomic_compare_exchange_weak(&maximumRunning, &previousMaximum, nowRunning))
+        {
+            ;
+        }
+        
+        usleep(10000);
+        atomic_fetch_sub(&running, 1);
+        
+        return @{[keys firstObject]: @YES};
+        
+    }];
+    
+    NSMutableArray *promises = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [promises addObject:[batcher promiseForKey:@(i)]];
+    }
+    
+    for (CBPPromise *promise in promises)
+    {
+        XCTAssertEqualObjects([promise deref], @YES, @"every key should be loaded");
+    }
+    
+    XCTAssertLessThanOrEqual(atomic_load(&maximumRunning), (NSInteger)2, @"no more than two batches should run at once");
+}
+
+#pragma mark - Batcher performance tests
+
+- (void)testBatcherPerformance
+{
+    CBPBatcher *batcher = [[CBPBatcher alloc] initWithMaximumBatchSize:1000 maximumDelay:0.01 maximumConcurrentBatches:4 executor:nil batchBlock:^NSDictionary *(NSArray *keys) {
+        
+        NSMutableDictionary *results = [NSMutableDictionary dictionaryWithCapacity:[keys count]];
+        
+        for (id key in keys)
+        {
+            results[key] = key;
+        }
+        
+        return results;
+        
+    }];
+    
+    [self measureBlock:^{
+        
+        NSMutableArray *promises = [NSMutableArray arrayWithCapacity:100000];
+        
+        for (NSUInteger i = 0; i < 100000; i++)
+        {
+            [promises addObject:[batcher promiseForKey:@(i)]];
+        }
+        
+        [batcher flush];
+        
+        for (CBPPromise *promise in promises)
+        {
+            [promise deref];
+        }
+        
+    }];
+}
+
+#pragma mark - Metrics tests
+
+- (void)testMetricsRecording
+{
+    CBPMetricsSetEnabled(YES);
+    
+    CBPMetricsSnapshot *before = [CBPMetricsSnapshot snapshot];
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0) workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        usleep(20000);
+        return @1;
+    }];
+    
+    XCTestExpectation *callbackExpectation = [self expectationWithDescription:@"callback"];
+    future.callbackQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    future.successBlock = ^(id value) {
+        [callbackExpectation fulfill];
+    };
+    
+    XCTAssertEqualObjects([future deref], @1, @"the future should be realized");
+    
+    CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:0.05];
+    XCTAssertEqualObjects([promise deref], CBPPromiseTimeoutValue, @"the promise should time out");
+    
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    
+    CBPMetricsSetEnabled(NO);
+    
+    CBPMetricsSnapshot *metrics = [[CBPMetricsSnapshot snapshot] snapshotBySubtractingSnapshot:before];
+    
+    XCTAssertGreaterThanOrEqual([metrics countForMetric:CBPMetricFutureQueueTime], (uint64_t)1, @"the future's queue time should be recorded");
+    XCTAssertGreaterThanOrEqual([metrics countForMetric:CBPMetricFutureRunTime], (uint64_t)1, @"the future's run time should be recorded");
+    XCTAssertGreaterThanOrEqual([metrics valueAtPercentile:50 forMetric:CBPMetricFutureRunTime], (uint64_t)(20 * NSEC_PER_MSEC * 15 / 16), @"the run time should include the sleep");
+    XCTAssertGreaterThanOrEqual([metrics countForMetric:CBPMetricDerefBlockTime], (uint64_t)1, @"blocking derefs should be recorded");
+    XCTAssertGreaterThanOrEqual([metrics countForMetric:CBPMetricPromiseTimeout], (uint64_t)1, @"the promise timeout should be recorded");
+    XCTAssertGreaterThanOrEqual([metrics countForMetric:CBPMetricCallbackDelay], (uint64_t)1, @"the callback delay should be recorded");
+    
+    CBPMetricsSnapshot *after = [CBPMetricsSnapshot snapshot];
+    [[[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) { return nil; }] deref];
+    
+    XCTAssertEqual([[[CBPMetricsSnapshot snapshot] snapshotBySubtractingSnapshot:after] countForMetric:CBPMetricFutureRunTime], (uint64_t)0, @"nothing should be recorded while metrics are disabled");
+}
+
+- (void)testMetricsPercentiles
+{
+    CBPMetricsSetEnabled(YES);
+    
+    CBPMetricsSnapshot *before = [CBPMetricsSnapshot snapshot];
+    
+    dispatch_apply(4, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        
+        for (NSUInteger i = 1; i <= 1000; i++)
+        {
+            CBPPromise *promise = [[CBPPromise alloc] init];
+            [promise deliver:@(i)];
+            [promise deref];
+        }
+        
+    });
+    
+    CBPMetricsSetEnabled(NO);
+    
+    CBPMetricsSnapshot *metrics = [[CBPMetricsSnapshot snapshot] snapshotBySubtractingSnapshot:before];
+    
+    XCTAssertEqual([metrics countForMetric:CBPMetricDerefBlockTime], (uint64_t)0, @"derefs of realized promises should not be recorded");
+    XCTAssertEqual([metrics valueAtPercentile:99 forMetric:CBPMetricDerefBlockTime], (uint64_t)0, @"empty metrics should report 0");
+}
+
+- (void)testFutureMetricsDisabledPerformance
+{
+    CBPMetricsSetEnabled(NO);
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            [[[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) { return nil; }] deref];
+        }
+        
+    }];
+}
+
+- (void)testFutureMetricsEnabledPerformance
+{
+    CBPMetricsSetEnabled(YES);
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            [[[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) { return nil; }] deref];
+        }
+        
+    }];
+    
+    CBPMetricsSetEnabled(NO);
+}
+
+#pragma mark - Deref performance tests
+
+- (void)testRealizedDerefPerformance
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    [promise deliver:@"hello"];
+    
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 1000000; i++)
+        {
+            [promise deref];
+        }
+        
+    }];
+}
+
+- (void)testContendedRealizedDerefPerformance
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    [promise deliver:@"hello"];
+    
+    [self measureBlock:^{
+        
+        dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+            
+            for (NSUInteger i = 0; i < 250000; i++)
+            {
+                [promise deref];
+            }
+            
+        });
+        
+    }];
+}
+
+- (void)testBlockingDerefHandoffPerformance
+{
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 10000; i++)
+        {
+            CBPPromise *promise = [[CBPPromise alloc] init];
+            
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [promise deliver:@"hello"];
+            });
+            
+            [promise deref];
+        }
+        
+    }];
+}
+
+#pragma mark - Deref memory tests
+
+- (void)testPromiseMemoryFootprint
+{
+    NSUInteger count = 100000;
+    NSMutableArray *promises = [NSMutableArray arrayWithCapacity:count];
+    
+    malloc_statistics_t before;
+    malloc_zone_statistics(NULL, &before);
+    
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [promises addObject:[[CBPPromise alloc] init]];
+    }
+    
+    malloc_statistics_t after;
+    malloc_zone_statistics(NULL, &after);
+    
+    double bytesPerPromise = (double)(after.size_in_use - before.size_in_use) / count;
+    double allocationsPerPromise = (double)(after.blocks_in_use - before.blocks_in_use) / count;
+    
+    NSLog(@"CBPPromise: %.1f bytes and %.2f allocations per live instance (instance size %zu)", bytesPerPromise, allocationsPerPromise, class_getInstanceSize([CBPPromise class]));
+    
+    XCTAssert(allocationsPerPromise < 1.5, @"A promise should be a single allocation, found %.2f", allocationsPerPromise);
+}
+
+#pragma mark - Continuation tests
+
+- (void)testDerefMap
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    
+    CBPDeref *mapped = [[promise map:^id(id value) {
+        
+        return [value stringByAppendingString:@" world"];
+        
+    }] map:^id(id value) {
+        
+        return [value uppercaseString];
+        
+    }];
+    
+    [promise deliver:@"hello"];
+    
+    XCTAssertEqualObjects([mapped derefWithTimeoutInterval:5.0 timeoutValue:nil], @"HELLO WORLD", @"Mapping did not work");
+}
+
+- (void)testDerefMapInvalid
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    NSError *error = [NSError errorWithDomain:@"CBPFoundationTests" code:1 userInfo:nil];
+    
+    __block BOOL mapped = NO;
+    
+    CBPDeref *deref = [promise map:^id(id value) {
+        
+        mapped = YES;
+        return value;
+        
+    }];
+    
+    [promise invalidateWithError:error];
+    
+    XCTAssertEqualObjects([deref derefWithTimeoutInterval:5.0 timeoutValue:nil], CBPDerefInvalidValue, @"Invalidation should have propagated");
+    XCTAssertEqualObjects(deref.error, error, @"The error should have propagated");
+    XCTAssert(!mapped, @"The map block should not have been performed");
+}
+
+- (void)testDerefFlatMap
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    CBPPromise *otherPromise = [[CBPPromise alloc] init];
+    
+    CBPDeref *deref = [promise flatMap:^CBPDeref *(id value) {
+        
+        return [otherPromise map:^id(id otherValue) {
+            
+            return [value stringByAppendingString:otherValue];
+            
+        }];
+        
+    }];
+    
+    [promise deliver:@"hello"];
+    
+    XCTAssertEqualObjects([deref derefWithTimeoutInterval:0.5 timeoutValue:@"timeout"], @"timeout", @"The deref should not be realized yet");
+    
+    [otherPromise deliver:@" world"];
+    
+    XCTAssertEqualObjects([deref derefWithTimeoutInterval:5.0 timeoutValue:nil], @"hello world", @"Flat mapping did not work");
+}
+
+- (void)testDerefMultipleContinuations
+{
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    NSMutableArray *derefs = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        [derefs addObject:[promise then:^id(id value, NSError *error) {
+            
+            return @([value integerValue] + i);
+            
+        } onQueue:nil]];
+    }
+    
+    [promise deliver:@1];
+    
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        [derefs addObject:[promise then:^id(id value, NSError *error) {
+            
+            return @([value integerValue] + i);
+            
+        } onQueue:nil]];
+    }
+    
+    [derefs enumerateObjectsUsingBlock:^(CBPDeref *deref, NSUInteger idx, BOOL *stop) {
+        
+        XCTAssertEqualObjects([deref derefWithTimeoutInterval:5.0 timeoutValue:nil], @(1 + idx % 100), @"Every continuation should have been performed");
+        
+    }];
+}
+
+#pragma mark - Combinator tests
+
+- (void)testWhenAll
+{
+    NSMutableArray *promises = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 10; i++)
+    {
+        [promises addObject:[[CBPPromise alloc] init]];
+    }
+    
+    CBPDeref *all = [CBPDeref whenAll:promises];
+    
+    [promises enumerateObjectsWithOptions:NSEnumerationReverse usingBlock:^(CBPPromise *promise, NSUInteger idx, BOOL *stop) {
+        
+        XCTAssert(![all isRealized], @"whenAll should not be realized until every input is");
+        [promise deliver:@(idx)];
+        
+    }];
+    
+    XCTAssertEqualObjects([all derefWithTimeoutInterval:5.0 timeoutValue:nil], (@[@0, @1, @2, @3, @4, @5, @6, @7, @8, @9]), @"whenAll should preserve input order");
+}
+
+- (void)testWhenAllInvalid
+{
+    CBPPromise *first = [[CBPPromise alloc] init];
+    CBPPromise *second = [[CBPPromise alloc] init];
+    
+    CBPDeref *all = [CBPDeref whenAll:@[first, second]];
+    
+    [second invalidateWithError:nil];
+    
+    XCTAssert(![all isValid], @"whenAll should short circuit on invalidation");
+    XCTAssertEqualObjects([all deref], CBPDerefInvalidValue, @"whenAll should have been invalidated");
+}
+
+- (void)testWhenAny
+{
+    CBPPromise *first = [[CBPPromise alloc] init];
+    CBPPromise *second = [[CBPPromise alloc] init];
+    
+    CBPDeref *any = [CBPDeref whenAny:@[first, second]];
+    
+    [second deliver:@"second"];
+    
+    XCTAssertEqualObjects([any deref], @"second", @"whenAny should have the first value");
+    XCTAssert(![first isValid], @"The losing input should have been cancelled");
+}
+
+- (void)testFirstSuccessful
+{
+    CBPPromise *first = [[CBPPromise alloc] init];
+    CBPPromise *second = [[CBPPromise alloc] init];
+    CBPPromise *third = [[CBPPromise alloc] init];
+    
+    CBPDeref *firstSuccessful = [CBPDeref firstSuccessful:@[first, second, third]];
+    
+    [first invalidateWithError:nil];
+    
+    XCTAssert(![firstSuccessful isRealized], @"An invalid input should not realize firstSuccessful");
+    
+    [third deliver:@"third"];
+    
+    XCTAssertEqualObjects([firstSuccessful deref], @"third", @"firstSuccessful should have the first valid value");
+    XCTAssert(![second isValid], @"The losing input should have been cancelled");
+}
 
-        XCTAssert([value isEqualToString:promiseValue], @"Promise value should have been equal to: 'hello");
-        XCTAssert(![value isEqualToString:@""], @"Promise value should not have been equal to: '");
+#pragma mark - Combinator performance tests
+
+- (void)measureWhenAllWithCount:(NSUInteger)count
+{
+    [self measureBlock:^{
         
-    };
+        NSMutableArray *promises = [NSMutableArray arrayWithCapacity:count];
+        
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            [promises addObject:[[CBPPromise alloc] init]];
+        }
+        
+        CBPDeref *all = [CBPDeref whenAll:promises];
+        
+        dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+            [promises[iteration] deliver:@(iteration)];
+        });
+        
+        XCTAssertEqual([[all deref] count], count, @"whenAll should have a value for every input");
+        
+    }];
+}
+
+- (void)testWhenAll10Performance
+{
+    [self measureWhenAllWithCount:10];
+}
+
+- (void)testWhenAll1000Performance
+{
+    [self measureWhenAllWithCount:1000];
+}
+
+- (void)testWhenAll100000Performance
+{
+    [self measureWhenAllWithCount:100000];
+}
+
+#pragma mark - Timer wheel tests
+
+- (void)testTimerWheelFires
+{
+    CBPTimerWheel *timerWheel = [[CBPTimerWheel alloc] initWithTickInterval:0.001];
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    NSDate *start = [NSDate date];
+    
+    CBPTimerWheelTimeout timeout = [timerWheel scheduleTimeout:0.5 block:^{
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    XCTAssert(dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(5 * NSEC_PER_SEC))) == 0, @"The timeout should have fired");
+    XCTAssert([[NSDate date] timeIntervalSinceDate:start] >= 0.5, @"The timeout fired early");
+    XCTAssert(![timerWheel cancelTimeout:timeout], @"A fired timeout should not be cancellable");
+    
+    [timerWheel invalidate];
+}
 
+- (void)testTimerWheelCancel
+{
+    CBPTimerWheel *timerWheel = [[CBPTimerWheel alloc] initWithTickInterval:0.001];
+    
+    __block BOOL fired = NO;
+    
+    CBPTimerWheelTimeout timeout = [timerWheel scheduleTimeout:0.2 block:^{
+        fired = YES;
+    }];
+    
+    XCTAssert([timerWheel cancelTimeout:timeout], @"The timeout should have been cancelled");
+    
     sleep(1);
     
-    [promise deliver:promiseValue];
+    XCTAssert(!fired, @"A cancelled timeout should not fire");
+    
+    [timerWheel invalidate];
+}
 
-    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate distantFuture]];
+- (void)testPromiseTimeoutPerformance
+{
+    [self measureBlock:^{
+        
+        for (NSUInteger i = 0; i < 1000000; i++)
+        {
+            @autoreleasepool
+            {
+                CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:30.0];
+                [promise deliver:@"hello"];
+            }
+        }
+        
+    }];
 }
 
-- (void)testPromiseBackgroundResolveTimeout
+#pragma mark - Executor tests
+
+- (void)testWorkStealingExecutor
 {
-    NSString *promiseValue = @"hello";
+    CBPWorkStealingExecutor *executor = [[CBPWorkStealingExecutor alloc] initWithNumberOfWorkers:4];
+    dispatch_group_t group = dispatch_group_create();
     
-    CBPPromise *promise = [[CBPPromise alloc] init];
+    __block NSUInteger count = 0;
     
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        
-        sleep(2);
-        [promise deliver:promiseValue];
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        dispatch_group_enter(group);
         
-    });
+        [executor execute:^{
+            
+            //-------------------------------------------------------------------
+            // Blocks submitted from a worker land on that worker's deque, so
+            // the other workers have to steal them.
+            //-------------------------------------------------------------------
+            for (NSUInteger j = 0; j < 100; j++)
+            {
+                dispatch_group_enter(group);
+                
+                [executor execute:^{
+                    usleep(10);
+                    
+                    @synchronized(group)
+                    {
+                        count++;
+                    }
+                    
+                    dispatch_group_leave(group);
+                }];
+            }
+            
+            dispatch_group_leave(group);
+            
+        }];
+    }
     
-    XCTAssert([[promise derefWithTimeoutInterval:0.2 timeoutValue:@""] isEqualToString:@""], @"Promise should have timedout and equaled been equal to the empty string");
+    XCTAssert(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_SEC))) == 0, @"Every block should have been performed");
+    XCTAssertEqual(count, (NSUInteger)10000, @"Every block should have been performed once");
+    XCTAssertEqual([executor queueDepth], (NSUInteger)0, @"The executor should be drained");
+    XCTAssert([executor stealCount] > 0, @"Idle workers should have stolen work");
     
-    XCTAssert([[promise derefWithTimeoutInterval:5.0 timeoutValue:@""] isEqualToString:promiseValue], @"Promise shouldn't have timedout and show have been equal to: '%@'", promiseValue);
+    [executor invalidate];
 }
 
-- (void)testPromiseTimeoutTimeout
+- (void)testFutureWithQueueExecutor
 {
-    CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:2.0];
-
-    sleep(3);
-
-    XCTAssert(![promise deliver:@""], @"Shouldn't have been able to deliver because of timeout");
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:dispatch_get_main_queue() workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        return @([NSThread isMainThread]);
+    }];
+    
+    while (![future isRealized])
+    {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    
+    XCTAssertEqualObjects([future deref], @YES, @"The future should have been performed on its queue");
+}
 
-    XCTAssert([promise deref] == CBPPromiseTimeoutValue, @"Promise should have equaled timeout value");
+- (void)testFutureDerefRunsPendingWorkInline
+{
+    CBPWorkStealingExecutor *executor = [[CBPWorkStealingExecutor alloc] initWithNumberOfWorkers:1];
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    [executor execute:^{
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    }];
+    
+    NSThread *thread = [NSThread currentThread];
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        return @([NSThread currentThread] == thread);
+    }];
+    
+    XCTAssertEqualObjects([future deref], @YES, @"Work that hasn't started should run on the dereferencing thread");
+    
+    dispatch_semaphore_signal(semaphore);
+    [executor invalidate];
 }
 
-- (void)testPromiseTimeoutSucceed
+- (void)testFutureDerefKeepsSerialQueueWork
 {
-    CBPPromise *promise = [[CBPPromise alloc] initWithTimeout:2.0];
+    dispatch_queue_t queue = dispatch_queue_create("com.cbpfoundation.tests.serial", DISPATCH_QUEUE_SERIAL);
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    static const void *const queueKey = &queueKey;
+    dispatch_queue_set_specific(queue, queueKey, (void *)queueKey, NULL);
+    
+    dispatch_async(queue, ^{
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    });
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithQueue:queue workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        return @(dispatch_get_specific(queueKey) == queueKey);
+    }];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        dispatch_semaphore_signal(semaphore);
+    });
+    
+    XCTAssertEqualObjects([future deref], @YES, @"Work on a serial queue should never run on the dereferencing thread");
+    XCTAssertFalse([CBPExecutor executorWithQueue:queue].allowsInlineExecution, @"Serial queues should not allow inline execution");
+    XCTAssert([CBPExecutor executorWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)].allowsInlineExecution, @"Global queues should allow inline execution");
+    XCTAssert([CBPExecutor defaultExecutor].allowsInlineExecution, @"The default executor should allow inline execution");
+}
 
-    sleep(1);
+- (void)testNestedFutureDerefOnSingleWorker
+{
+    CBPWorkStealingExecutor *executor = [[CBPWorkStealingExecutor alloc] initWithNumberOfWorkers:1];
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        
+        CBPFuture *first = [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock innerIsCanceled) {
+            return @1;
+        }];
+        
+        CBPFuture *second = [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock innerIsCanceled) {
+            return @2;
+        }];
+        
+        return @([[second deref] integerValue] + [[first deref] integerValue]);
+        
+    }];
+    
+    XCTAssertEqualObjects([future derefWithTimeoutInterval:5.0 timeoutValue:nil], @3, @"A blocked worker should have run the nested futures");
+    
+    [executor invalidate];
+}
 
-    NSString *deliveryValue = @"";
+#pragma mark - Executor performance tests
 
-    XCTAssert([promise deliver:deliveryValue], @"Should have been able to deliver");
+- (CBPDeref *)sumTreeWithDepth:(NSUInteger)depth executor:(CBPExecutor *)executor
+{
+    if (!depth)
+    {
+        return [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+            
+            NSUInteger sum = 0;
+            
+            for (NSUInteger i = 0; i < 1000; i++)
+            {
+                sum += i & 1;
+            }
+            
+            return @(sum);
+            
+        }];
+    }
+    
+    //-------------------------------------------------------------------
+    // The children are joined with a continuation rather than a blocking
+    // deref so that a bounded executor can never run out of workers.
+    //-------------------------------------------------------------------
+    CBPFuture *node = [[CBPFuture alloc] initWithExecutor:executor workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        
+        NSArray *children = @[[self sumTreeWithDepth:depth - 1 executor:executor], [self sumTreeWithDepth:depth - 1 executor:executor]];
+        
+        return [[CBPDeref whenAll:children] map:^id(NSArray *sums) {
+            return @([sums[0] unsignedIntegerValue] + [sums[1] unsignedIntegerValue]);
+        }];
+        
+    }];
+    
+    return [node flatMap:^CBPDeref *(CBPDeref *sum) {
+        return sum;
+    }];
+}
 
-    XCTAssert([promise deref] == deliveryValue, @"Promise should have equaled ''");
+- (CBPFuture *)blockingSumTreeWithDepth:(NSUInteger)depth
+{
+    return [[CBPFuture alloc] initWithExecutor:nil workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        
+        if (!depth)
+        {
+            NSUInteger sum = 0;
+            
+            for (NSUInteger i = 0; i < 1000; i++)
+            {
+                sum += i & 1;
+            }
+            
+            return @(sum);
+        }
+        
+        CBPFuture *left = [self blockingSumTreeWithDepth:depth - 1];
+        CBPFuture *right = [self blockingSumTreeWithDepth:depth - 1];
+        
+        return @([[right deref] unsignedIntegerValue] + [[left deref] unsignedIntegerValue]);
+        
+    }];
 }
 
-- (void)testPromiseInvalidateImmediate
+- (void)measureSumTreeWithExecutor:(CBPExecutor *)executor
 {
-    CBPPromise *promise = [[CBPPromise alloc] init];
-    XCTAssert([promise invalidateWithError:nil], @"Should have been able to invalidate promise");
-    XCTAssertEqualObjects(CBPDerefInvalidValue, [promise deref], @"Deref value should have been the invalid value");
-    XCTAssert(![promise deliver:nil], @"Shouldn't have been able to deliver promise");
+    [self measureBlock:^{
+        
+        CBPDeref *sum = [self sumTreeWithDepth:14 executor:executor];
+        
+        XCTAssertEqualObjects([sum derefWithTimeoutInterval:60.0 timeoutValue:nil], @((1 << 14) * 500), @"The tree should sum every leaf");
+        
+    }];
 }
 
-- (void)testPromiseInvalidateDelay
+- (void)testForkJoinWorkStealingPerformance
 {
-    CBPPromise *promise = [[CBPPromise alloc] init];
+    [self measureSumTreeWithExecutor:[CBPExecutor defaultExecutor]];
+}
 
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+- (void)testForkJoinBlockingPerformance
+{
+    [self measureBlock:^{
+        
+        CBPFuture *sum = [self blockingSumTreeWithDepth:14];
+        
+        XCTAssertEqualObjects([sum derefWithTimeoutInterval:60.0 timeoutValue:nil], @((1 << 14) * 500), @"The tree should sum every leaf");
+        
+    }];
+}
 
-        sleep(2);
-        [promise invalidateWithError:nil];
+- (void)testForkJoinDispatchQueuePerformance
+{
+    [self measureSumTreeWithExecutor:[CBPExecutor executorWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)]];
+}
 
-    });
+#pragma mark - Cancellation tests
 
-    XCTAssertEqualObjects([promise deref], CBPDerefInvalidValue, @"Deref should have returned the invalid value");
+- (void)testCancellationTokenDropsUnstartedWork
+{
+    CBPWorkStealingExecutor *executor = [[CBPWorkStealingExecutor alloc] initWithNumberOfWorkers:1];
+    CBPCancellationToken *token = [[CBPCancellationToken alloc] init];
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    [executor execute:^{
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    }];
+    
+    __block BOOL performed = NO;
+    
+    CBPFuture *future = [[CBPFuture alloc] initWithExecutor:executor cancellationToken:token workBlock:^id(CBPFutureCanceledBlock isCanceled) {
+        performed = YES;
+        return @"hello";
+    }];
+    
+    CBPDeref *mapped = [future map:^id(id value) {
+        return value;
+    }];
+    
+    XCTAssert([token cancel], @"The token should have been cancelled");
+    XCTAssert(![token cancel], @"A token can only be cancelled once");
+    
+    XCTAssertEqualObjects([future deref], CBPDerefInvalidValue, @"The future should have been invalidated");
+    XCTAssertEqual([[future error] code], (NSInteger)NSUserCancelledError, @"The future should have a cancellation error");
+    XCTAssertEqualObjects([mapped deref], CBPDerefInvalidValue, @"Dependent derefs should have been invalidated");
+    
+    dispatch_semaphore_signal(semaphore);
+    [executor invalidate];
+    
+    while ([executor queueDepth])
+    {
+        usleep(1000);
+    }
+    
+    XCTAssert(!performed, @"Cancelled work should never be performed");
 }
 
-#pragma mark - Future tests
-
-- (void)testFutureDerefSameThread
+- (void)testCancellationTokenStopsRunningWork
 {
-    NSString *value = @"";
+    CBPCancellationToken *parentToken = [[CBPCancellationToken alloc] init];
+    CBPCancellationToken *token = [[CBPCancellationToken alloc] initWithParentToken:parentToken];
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
     
-    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+    CBPFuture *future = [[CBPFuture alloc] initWithExecutor:nil cancellationToken:token workBlock:^id(CBPFutureCanceledBlock isCanceled) {
         
-        sleep(5.0);
+        dispatch_semaphore_signal(semaphore);
         
-        return value;
+        while (!isCanceled())
+        {
+            usleep(100);
+        }
+        
+        return @"finished";
         
     }];
     
-    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
-    });
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
     
-    XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
+    [parentToken cancel];
+    
+    XCTAssert([token isCancelled], @"Child tokens should be cancelled with their parent");
+    XCTAssert([future isCanceled], @"The future should have been cancelled");
+    XCTAssertEqualObjects([future derefWithTimeoutInterval:5.0 timeoutValue:nil], CBPDerefInvalidValue, @"The future should have been invalidated");
 }
 
-- (void)testFutureDerefDifferentThread
+- (void)testCancelledTokenInvalidatesNewDerefs
 {
-    NSString *value = @"";
+    CBPCancellationToken *token = [[CBPCancellationToken alloc] init];
+    [token cancel];
     
-    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+    CBPPromise *promise = [[CBPPromise alloc] init];
+    [token registerDeref:promise];
+    
+    XCTAssert(![promise isValid], @"Registering with a cancelled token should invalidate the deref");
+}
+
+#pragma mark - Sequence tests
+
+- (void)testSequencePipeline
+{
+    NSMutableArray *testArray = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    __block NSUInteger mapped = 0;
+    
+    NSArray *result = [[[[[testArray sequence] map:^id(NSNumber *number) {
         
-        sleep(5.0);
+        mapped++;
+        return @([number unsignedIntegerValue] * 3);
         
-        return value;
+    }] filter:^BOOL(NSNumber *number) {
         
-    }];
+        return [number unsignedIntegerValue] % 2 == 0;
+        
+    }] map:^id(NSNumber *number) {
+        
+        return [number stringValue];
+        
+    }] take:3] array];
     
-    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        XCTAssert([[future deref] isEqualToString:value], @"Future deref did not work");
-    });
+    XCTAssertEqualObjects(result, (@[@"0", @"6", @"12"]), @"The pipeline did not produce the right elements");
+    XCTAssertEqual(mapped, (NSUInteger)5, @"take: should stop the source as soon as it has enough elements");
 }
 
-- (void)testFutureDerefTimeout
+- (void)testSequenceSkipChunkFlatMap
 {
-    NSString *value = @"";
-    
-    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+    CBPSequence *sequence = [[[[@[@1, @2, @3, @4] sequence] skip:1] flatMap:^CBPSequence *(NSNumber *number) {
         
-        sleep(5.0);
+        return [@[number, number] sequence];
         
-        return value;
+    }] chunk:4];
+    
+    XCTAssertEqualObjects([sequence array], (@[@[@2, @2, @3, @3], @[@4, @4]]), @"Chunks should be flushed at the end of the sequence");
+    XCTAssertEqualObjects([[sequence take:1] array], (@[@[@2, @2, @3, @3]]), @"Array backed sequences should be reusable");
+}
+
+- (void)testSequenceFlatMapInnerTake
+{
+    CBPSequence *sequence = [[@[@1, @2, @3] sequence] flatMap:^CBPSequence *(NSNumber *number) {
+        
+        return [[@[number, number, number] sequence] take:2];
         
     }];
     
-    XCTAssert([[future derefWithTimeoutInterval:1.0 timeoutValue:@"hello"] isEqualToString:@"hello"], @"Future deref did not work");
+    XCTAssertEqualObjects([sequence array], (@[@1, @1, @2, @2, @3, @3]), @"An inner sequence stopping itself should not stop the outer sequence");
+    XCTAssertEqualObjects([[sequence chunk:4] array], (@[@[@1, @1, @2, @2], @[@3, @3]]), @"The last chunk should be flushed");
+}
+
+- (void)testSequenceSources
+{
+    __block NSUInteger next = 0;
     
-    XCTAssert(![future isRealized], @"Future shouldn't be realized");
+    CBPSequence *generated = [CBPSequence sequenceWithGenerator:^id {
+        return next < 5 ? @(next++) : nil;
+    }];
     
-    XCTAssert([[future derefWithTimeoutInterval:10.0 timeoutValue:@"hello"] isEqualToString:value], @"Future deref did not work");
+    XCTAssertEqualObjects([generated reduceWithInitialValue:@0 block:^id(NSNumber *accumulator, NSNumber *number) {
+        return @([accumulator unsignedIntegerValue] + [number unsignedIntegerValue]);
+    }], @10, @"The generator should have produced 0 through 4");
     
-    XCTAssert([future isRealized], @"Future should be realized");
+    CBPSequence *enumerated = [CBPSequence sequenceWithEnumerator:[@[@"a", @"b", @"c"] reverseObjectEnumerator]];
+    
+    XCTAssertEqualObjects([enumerated array], (@[@"c", @"b", @"a"]), @"The enumerator's objects should be in order");
 }
 
-- (void)testFutureDerefCancel
+- (void)testSequenceConcurrentArray
 {
-    NSString *value = @"";
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    CBPFuture *future = [[CBPFuture alloc] initWithQueue:nil workBlock:^id(CBPFutureCanceledBlock isValid) {
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
+    
+    CBPSequence *sequence = [[[testArray sequence] filter:^BOOL(NSNumber *number) {
         
-        sleep(5.0);
+        return [number unsignedIntegerValue] % 3 == 0;
         
-        return value;
+    }] map:^id(NSNumber *number) {
+        
+        return [number stringValue];
         
     }];
     
-    sleep(1);
-    
-    XCTAssert(![future isRealized], @"Should not have been realized");
+    XCTAssertEqualObjects([sequence concurrentArray], [sequence array], @"Concurrent runs should keep the order");
+}
+
+#pragma mark - Sequence performance tests
+
+- (void)testSequencePipelinePerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    XCTAssert([future invalidateWithError:nil], @"Should have been able to cancel future");
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    XCTAssert([future isRealized], @"Should have been realized");
+    [self measureBlock:^{
+        
+        [[[[[testArray sequence] map:^id(NSNumber *number) {
+            return @([number unsignedIntegerValue] + 1);
+        }] filter:^BOOL(NSNumber *number) {
+            return [number unsignedIntegerValue] % 1000 == 0;
+        }] map:^id(NSNumber *number) {
+            return [number stringValue];
+        }] take:100] array];
+        
+    }];
+}
+
+- (void)testArrayPipelinePerformance
+{
+    NSMutableArray *testArray = [NSMutableArray array];
     
-    XCTAssert(![future invalidateWithError:nil], @"Should not have been able to cancel future");
+    for (NSUInteger i = 0; i < 1000000; i++)
+    {
+        [testArray addObject:@(i)];
+    }
     
-    XCTAssert([[future derefWithTimeoutInterval:10.0 timeoutValue:@"hello"] isEqualToString:CBPDerefInvalidValue], @"Future deref did not work");
+    [self measureBlock:^{
+        
+        NSArray *result = [[[testArray arrayByMappingBlock:^id(NSNumber *number) {
+            return @([number unsignedIntegerValue] + 1);
+        }] filteredArrayUsingBlock:^BOOL(NSNumber *number) {
+            return [number unsignedIntegerValue] % 1000 == 0;
+        }] arrayByMappingBlock:^id(NSNumber *number) {
+            return [number stringValue];
+        }];
+        
+        [result subarrayWithRange:NSMakeRange(0, 100)];
+        
+    }];
 }
 
 @end